@@ -29,6 +29,7 @@
 
 #include <ctype.h>
 #include <stdio.h>
+#include <stdint.h>
 #include <stdlib.h>
 #include <string.h>
 #include <unistd.h>
@@ -46,6 +47,8 @@
 #include "calc.h"
 #include "func.h"
 #include "safe_mem.h"
+#include "cpool.h"
+#include "fold.h"
 
 ast_t
 ast_new(optype_t type, ast_t l, ast_t r)
@@ -128,7 +131,7 @@ ast_newassign(char *s, ast_t v)
 
 
 ast_t
-ast_newnum(numtype_t type, char *str)
+ast_newnum(numtype_t type, const char *str)
 {
 	astnum_t a;
 
@@ -137,7 +140,7 @@ ast_newnum(numtype_t type, char *str)
 		exit(1);
 	}
 
-	a->num = num_new_from_str(0, type, str);
+	a->num = cpool_get(type, str);
 	a->op_type = OP_NUM;
 
 	return (ast_t) a;
@@ -165,6 +168,42 @@ ast_newpsel(pseltype_t type, ast_t l, ast_t hi, ast_t lo)
 }
 
 
+/*
+ * Turns a part select of a variable, x[hi:lo], into the lvalue of an
+ * assignment of v to those bits.
+ */
+ast_t
+ast_newpselassign(ast_t psel, ast_t v)
+{
+	astpselassign_t a;
+	astpsel_t ap = (astpsel_t)psel;
+
+	if (ap->l->op_type != OP_VARREF) {
+		yyxerror("Only variables can be assigned to with a part select");
+		ast_delete(psel);
+		ast_delete(v);
+		return NULL;
+	}
+
+	if ((a = alloc_safe_mem(BUCKET_AST, sizeof(*a))) == NULL) {
+		yyxerror("ENOMEM");
+		exit(1);
+	}
+
+	a->op_type = OP_PSELASSIGN;
+	a->name = ((astref_t)ap->l)->name;
+	a->psel_type = ap->psel_type;
+	a->hi = ap->hi;
+	a->lo = ap->lo;
+	a->v = v;
+
+	free_safe_mem(BUCKET_AST, ap->l);
+	free_safe_mem(BUCKET_AST, ap);
+
+	return (ast_t) a;
+}
+
+
 ast_t
 ast_newcmp(cmptype_t ct, ast_t l, ast_t r)
 {
@@ -204,6 +243,28 @@ ast_newflow(flowtype_t ft, ast_t c, ast_t t, ast_t f)
 }
 
 
+/*
+ * The logical operators are conditionals, so that their right operand
+ * is only evaluated when it decides the result: l && r is
+ * if l then r != 0; else 0; fi, and l || r is if l then 1; else r != 0; fi.
+ */
+ast_t
+ast_newland(ast_t l, ast_t r)
+{
+	return ast_newflow(FLOW_IF, l,
+	    ast_newcmp(CMP_NE, r, ast_newnum(NUM_INT, "0")),
+	    ast_newnum(NUM_INT, "0"));
+}
+
+
+ast_t
+ast_newlor(ast_t l, ast_t r)
+{
+	return ast_newflow(FLOW_IF, l, ast_newnum(NUM_INT, "1"),
+	    ast_newcmp(CMP_NE, r, ast_newnum(NUM_INT, "0")));
+}
+
+
 explist_t
 ast_newexplist(ast_t exp, explist_t next)
 {
@@ -268,14 +329,116 @@ namelist_delete(namelist_t e)
 
 
 
+num_t
+eval_ref(const char *name, hashtable_t vartbl)
+{
+	var_t var;
+
+	var = NULL;
+	if (vartbl != NULL)
+		var = ext_varlookup(vartbl, name, 0);
+
+	if (var == NULL) {
+		var = varlookup(name, 0);
+		if (var == NULL) {
+			yyxerror("Variable '%s' not defined", name);
+			return NULL;
+		}
+	}
+
+	return var->v;
+}
+
+
+/*
+ * Assigns l to var.  A variable that does not own its value (an
+ * argument) takes ownership of the new one.
+ */
+num_t
+var_assign(var_t var, num_t l)
+{
+	/* dispose of old var first, unless it's the same as is being returned */
+	if (var->v != NULL && !var->no_numfree && (l != var->v))
+		num_delete(var->v);
+
+	/* trees that folded the constant need folding again */
+	if (var->constant) {
+		var->constant = 0;
+		fold_invalidate();
+	}
+
+	var->no_numfree = 0;
+	return (var->v = num_new_z_or_fp(0, l));
+}
+
+
+num_t
+var_pselassign(var_t var, pseltype_t type, num_t l, num_t hi, num_t lo)
+{
+	num_t r;
+
+	if (var->constant) {
+		var->constant = 0;
+		fold_invalidate();
+	}
+
+	/*
+	 * The bits are written in place, so the variable needs a
+	 * private integer of its own: a newly created variable starts
+	 * out as 0, and a shared (argument) or non-integer value is
+	 * replaced by an integer copy first.
+	 */
+	if (var->v == NULL) {
+		var->v = num_new_z(0, NULL);
+	} else if (var->no_numfree || var->v->num_type != NUM_INT) {
+		r = num_new_z(0, var->v);
+		if (!var->no_numfree)
+			num_delete(var->v);
+		var->no_numfree = 0;
+		var->v = r;
+	}
+
+	return num_int_part_set(type, hi, lo, var->v, l);
+}
+
+
+num_t
+eval_assign(const char *name, num_t l, hashtable_t vartbl)
+{
+	var_t var;
+
+	if (vartbl != NULL)
+		var = ext_varlookup(vartbl, name, 1);
+	else
+		var = varlookup(name, 1);
+
+	return var_assign(var, l);
+}
+
+
+num_t
+eval_pselassign(astpselassign_t apa, num_t l, num_t hi, num_t lo,
+    hashtable_t vartbl)
+{
+	var_t var;
+
+	if (vartbl != NULL)
+		var = ext_varlookup(vartbl, apa->name, 1);
+	else
+		var = varlookup(apa->name, 1);
+
+	return var_pselassign(var, apa->psel_type, l, hi, lo);
+}
+
+
 num_t
 eval(ast_t a, hashtable_t vartbl)
 {
 	astcmp_t acmp;
 	astflow_t af;
 	astpsel_t ap;
+	astpselassign_t apa;
 	num_t n, c, l, r, hi, lo;
-	var_t var;
 
 	assert(a != NULL);
 
@@ -388,19 +551,7 @@ eval(ast_t a, hashtable_t vartbl)
 		break;
 
 	case OP_VARREF:
-		var = NULL;
-		if (vartbl != NULL)
-			var = ext_varlookup(vartbl, ((astref_t) a)->name, 0);
-
-		if (var == NULL) {
-			var = varlookup(((astref_t) a)->name, 0);
-			if (var == NULL) {
-				yyxerror("Variable '%s' not defined",
-					((astref_t) a)->name);
-				return NULL;
-			}
-		}
-		n = var->v;
+		n = eval_ref(((astref_t) a)->name, vartbl);
 		break;
 
 	case OP_VARASSIGN:
@@ -408,28 +559,30 @@ eval(ast_t a, hashtable_t vartbl)
 		if (l == NULL)
 			return NULL;
 
-		var = NULL;
-		if (vartbl != NULL)
-			var = ext_varlookup(vartbl, ((astassign_t) a)->name, 0);
-		else
-			var = varlookup(((astassign_t) a)->name, 0);
+		n = eval_assign(((astassign_t) a)->name, l, vartbl);
+		break;
 
-		if (var != NULL) {
-			/* dispose of old var first, unless it's the same as is being returned */
-			if (!var->no_numfree && (l != var->v))
-				num_delete(var->v);
+	case OP_PSELASSIGN:
+		apa = (astpselassign_t)a;
+		l = eval(apa->v, vartbl);
+		if (l == NULL)
+			return NULL;
+		hi = eval(apa->hi, vartbl);
+		if (hi == NULL)
+			return NULL;
+		if (apa->lo != NULL) {
+			lo = eval(apa->lo, vartbl);
+			if (lo == NULL)
+				return NULL;
 		} else {
-			if (vartbl != NULL)
-				var = ext_varlookup(vartbl, ((astassign_t) a)->name, 1);
-			else
-				var = varlookup(((astassign_t) a)->name, 1);
+			lo = NULL;
 		}
 
-		n = var->v = num_new_z_or_fp(0, l);
+		n = eval_pselassign(apa, l, hi, lo, vartbl);
 		break;
 
 	case OP_CALL:
-		n = call_fun(((astcall_t) a)->name, ((astcall_t) a)->l, vartbl);
+		n = call_ast((astcall_t) a, vartbl);
 		break;
 
 	default:
@@ -450,6 +603,7 @@ ast_delete(ast_t a)
 	astcmp_t acmp;
 	astflow_t af;
 	astpsel_t ap;
+	astpselassign_t apa;
 
 
 	switch (a->op_type) {
@@ -496,7 +650,7 @@ ast_delete(ast_t a)
 
 	case OP_NUM:
 		an = (astnum_t)a;
-		num_delete(an->num);
+		cpool_put(an->num);
 		break;
 
 
@@ -525,9 +679,184 @@ ast_delete(ast_t a)
 			ast_delete(ap->lo);
 		break;
 
+	case OP_PSELASSIGN:
+		apa = (astpselassign_t)a;
+		ast_delete(apa->v);
+		ast_delete(apa->hi);
+		if (apa->lo != NULL)
+			ast_delete(apa->lo);
+		free(apa->name);
+		break;
+
 	default:
 		yyxerror("Unknown type in ast_delete: %d", a->op_type);
 	}
 
 	free_safe_mem(BUCKET_AST, a);
 }
+
+
+/*
+ * Returns an OP_NUM node for the computed value n, which is copied into
+ * the constant pool.
+ */
+ast_t
+ast_newnumval(num_t n)
+{
+	astnum_t a;
+
+	if ((a = alloc_safe_mem(BUCKET_AST, sizeof(*a))) == NULL) {
+		yyxerror("ENOMEM");
+		exit(1);
+	}
+
+	a->num = cpool_intern(n);
+	a->num_type = a->num->num_type;
+	a->op_type = OP_NUM;
+
+	return (ast_t) a;
+}
+
+
+static
+char *
+ast_strdup(const char *s)
+{
+	char *r;
+
+	if ((r = strdup(s)) == NULL) {
+		yyxerror("ENOMEM");
+		exit(1);
+	}
+
+	return r;
+}
+
+
+static
+explist_t
+explist_copy(explist_t l)
+{
+	if (l == NULL)
+		return NULL;
+
+	return ast_newexplist(ast_copy(l->ast), explist_copy(l->next));
+}
+
+
+/* Returns a deep copy of a, which may be NULL. */
+ast_t
+ast_copy(ast_t a)
+{
+	astpsel_t ap;
+	astpselassign_t apa;
+	astflow_t af;
+	ast_t r;
+
+	if (a == NULL)
+		return NULL;
+
+	switch (a->op_type) {
+	case OP_CMP:
+		return ast_newcmp(((astcmp_t)a)->cmp_type,
+		    ast_copy(((astcmp_t)a)->l), ast_copy(((astcmp_t)a)->r));
+
+	case OP_FLOW:
+		af = (astflow_t)a;
+		return ast_newflow(af->flow_type, ast_copy(af->cond),
+		    ast_copy(af->t), ast_copy(af->f));
+
+	case OP_NUM:
+		return ast_newnumval(((astnum_t)a)->num);
+
+	case OP_CALL:
+		return ast_newcall(ast_strdup(((astcall_t)a)->name),
+		    explist_copy(((astcall_t)a)->l));
+
+	case OP_VARREF:
+		return ast_newref(ast_strdup(((astref_t)a)->name));
+
+	case OP_VARASSIGN:
+		return ast_newassign(ast_strdup(((astassign_t)a)->name),
+		    ast_copy(((astassign_t)a)->v));
+
+	case OP_PSEL:
+		ap = (astpsel_t)a;
+		return ast_newpsel(ap->psel_type, ast_copy(ap->l),
+		    ast_copy(ap->hi), ast_copy(ap->lo));
+
+	case OP_PSELASSIGN:
+		apa = (astpselassign_t)a;
+		r = ast_newpsel(apa->psel_type,
+		    ast_newref(ast_strdup(apa->name)), ast_copy(apa->hi),
+		    ast_copy(apa->lo));
+		return ast_newpselassign(r, ast_copy(apa->v));
+
+	default:
+		return ast_new(a->op_type, ast_copy(a->l), ast_copy(a->r));
+	}
+}
+
+
+/*
+ * Adds the names a assigns to, which are local to a function body, to
+ * the names table.
+ */
+void
+ast_assigned(ast_t a, hashtable_t names)
+{
+	astpsel_t ap;
+	astpselassign_t apa;
+	astflow_t af;
+	explist_t p;
+
+	if (a == NULL)
+		return;
+
+	switch (a->op_type) {
+	case OP_NUM:
+	case OP_VARREF:
+		break;
+
+	case OP_CMP:
+		ast_assigned(((astcmp_t)a)->l, names);
+		ast_assigned(((astcmp_t)a)->r, names);
+		break;
+
+	case OP_FLOW:
+		af = (astflow_t)a;
+		ast_assigned(af->cond, names);
+		ast_assigned(af->t, names);
+		ast_assigned(af->f, names);
+		break;
+
+	case OP_CALL:
+		for (p = ((astcall_t)a)->l; p != NULL; p = p->next)
+			ast_assigned(p->ast, names);
+		break;
+
+	case OP_VARASSIGN:
+		hashtable_lookup(names, ((astassign_t)a)->name, 1);
+		ast_assigned(((astassign_t)a)->v, names);
+		break;
+
+	case OP_PSEL:
+		ap = (astpsel_t)a;
+		ast_assigned(ap->l, names);
+		ast_assigned(ap->hi, names);
+		ast_assigned(ap->lo, names);
+		break;
+
+	case OP_PSELASSIGN:
+		apa = (astpselassign_t)a;
+		hashtable_lookup(names, apa->name, 1);
+		ast_assigned(apa->hi, names);
+		ast_assigned(apa->lo, names);
+		ast_assigned(apa->v, names);
+		break;
+
+	default:
+		ast_assigned(a->l, names);
+		ast_assigned(a->r, names);
+	}
+}
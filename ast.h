@@ -74,6 +74,19 @@ typedef struct astassign
 } *astassign_t;
 
 
+typedef struct astpselassign
+{
+	optype_t op_type;
+
+	char *name;
+	pseltype_t psel_type;
+
+	ast_t hi;
+	ast_t lo;
+	ast_t v;
+} *astpselassign_t;
+
+
 typedef struct astcmp
 {
 	optype_t op_type;
@@ -104,6 +117,11 @@ typedef struct astcall
 
 	char *name;
 	explist_t l;
+
+	/* resolved by fun_resolve(), valid while gen == fun_gen */
+	struct func *fn;
+	int nargs;
+	unsigned long gen;
 } *astcall_t;
 
 
@@ -125,12 +143,24 @@ ast_t ast_new(optype_t type, ast_t l, ast_t r);
 ast_t ast_newcall(char *s, explist_t l);
 ast_t ast_newref(char *s);
 ast_t ast_newassign(char *s, ast_t v);
-ast_t ast_newnum(numtype_t type, char *str);
+ast_t ast_newnum(numtype_t type, const char *str);
+ast_t ast_newnumval(num_t n);
 ast_t ast_newpsel(pseltype_t type, ast_t l, ast_t hi, ast_t lo);
+ast_t ast_newpselassign(ast_t psel, ast_t v);
 ast_t ast_newcmp(cmptype_t ct, ast_t l, ast_t r);
 ast_t ast_newflow(flowtype_t ft, ast_t c, ast_t t, ast_t f);
+ast_t ast_newland(ast_t l, ast_t r);
+ast_t ast_newlor(ast_t l, ast_t r);
 explist_t ast_newexplist(ast_t exp, explist_t next);
 namelist_t ast_newnamelist(char *s, namelist_t next);
 void namelist_delete(namelist_t e);
 num_t eval(ast_t a, hashtable_t vartbl);
+num_t eval_ref(const char *name, hashtable_t vartbl);
+num_t var_assign(var_t var, num_t l);
+num_t var_pselassign(var_t var, pseltype_t type, num_t l, num_t hi, num_t lo);
+num_t eval_assign(const char *name, num_t l, hashtable_t vartbl);
+num_t eval_pselassign(astpselassign_t apa, num_t l, num_t hi, num_t lo,
+    hashtable_t vartbl);
 void ast_delete(ast_t a);
+ast_t ast_copy(ast_t a);
+void ast_assigned(ast_t a, hashtable_t names);
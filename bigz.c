@@ -0,0 +1,557 @@
+/*
+ * Copyright (c) 2026 Alex Hornung <alex@alexhornung.com>.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in
+ *    the documentation and/or other materials provided with the
+ *    distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE
+ * COPYRIGHT HOLDERS OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ * BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED
+ * AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT
+ * OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <limits.h>
+
+#include <gmp.h>
+#include <mpfr.h>
+
+#include "hashtable.h"
+
+#include "optype.h"
+#include "num.h"
+#include "var.h"
+#include "ast.h"
+#include "calc.h"
+#include "par.h"
+#include "bigz.h"
+#include "prime.h"
+
+/* leaves of the product tree multiply this many terms sequentially */
+#define BIGZ_LEAF_TERMS		16
+/* work items handed out per thread, to even out unequal chunk costs */
+#define BIGZ_CHUNKS_PER_THREAD	4
+/* fewer terms than this are not worth spreading over threads */
+#define BIGZ_PAR_MIN_TERMS	4096UL
+/* GMP's own (single-threaded) algorithms win below these */
+#define BIGZ_FAC_THRESHOLD	50000UL
+#define BIGZ_PRIMORIAL_THRESHOLD	200000UL
+/* both operands need at least this many bits for a parallel multiply */
+#define BIGZ_PAR_MUL_BITS	(1UL << 20)
+/* larger integer powers are left to MPFR */
+#define BIGZ_POW_MAX_BITS	(1UL << 30)
+
+
+/*
+ * The terms of a product: either list[0..n), or lo, lo+1, ... with
+ * their factors of two removed if odd is set.
+ */
+struct bigz_terms
+{
+	const unsigned long *list;
+	unsigned long lo;
+	int odd;
+};
+
+struct bigz_chunk_job
+{
+	const struct bigz_terms *t;
+	unsigned long n;
+	size_t nparts;
+	mpz_t *parts;
+};
+
+struct bigz_pair_job
+{
+	mpz_t *parts;
+};
+
+struct bigz_mul_job
+{
+	mpz_ptr r[3];
+	mpz_srcptr a[3];
+	mpz_srcptr b[3];
+	int depth;
+};
+
+struct bigz_chunk_mul_job
+{
+	mpz_t *parts;
+	mpz_srcptr b;
+};
+
+static void bigz_mul_rec(mpz_t r, const mpz_t a, const mpz_t b, int depth);
+
+
+static
+unsigned long
+bigz_term(const struct bigz_terms *t, unsigned long k)
+{
+	unsigned long x;
+
+	if (t->list != NULL)
+		return t->list[k];
+
+	x = t->lo + k;
+	if (t->odd)
+		while (x != 0 && (x & 1) == 0)
+			x >>= 1;
+
+	return x;
+}
+
+
+/*
+ * r = product of terms [from, to), as a balanced binary tree so that
+ * the multiplications near the root have operands of similar size.
+ */
+static
+void
+bigz_prod_seq(mpz_t r, const struct bigz_terms *t, unsigned long from,
+    unsigned long to)
+{
+	unsigned long acc, x, k, mid;
+	mpz_t tmp;
+
+	if (to - from <= BIGZ_LEAF_TERMS) {
+		mpz_set_ui(r, 1);
+		acc = 1;
+		for (k = from; k < to; k++) {
+			x = bigz_term(t, k);
+			if (x != 0 && acc > ULONG_MAX / x) {
+				mpz_mul_ui(r, r, acc);
+				acc = x;
+			} else {
+				acc *= x;
+			}
+		}
+		mpz_mul_ui(r, r, acc);
+		return;
+	}
+
+	mid = from + (to - from) / 2;
+
+	mpz_init(tmp);
+	bigz_prod_seq(r, t, from, mid);
+	bigz_prod_seq(tmp, t, mid, to);
+	mpz_mul(r, r, tmp);
+	mpz_clear(tmp);
+}
+
+
+static
+void
+bigz_chunk_worker(void *arg, size_t i)
+{
+	struct bigz_chunk_job *job = arg;
+	unsigned long q, rem, from, to;
+
+	/* the first n % nparts chunks get one extra term */
+	q = job->n / job->nparts;
+	rem = job->n % job->nparts;
+	from = q * i + ((i < rem) ? i : rem);
+	to = from + q + ((i < rem) ? 1 : 0);
+
+	bigz_prod_seq(job->parts[i], job->t, from, to);
+}
+
+
+static
+void
+bigz_pair_worker(void *arg, size_t i)
+{
+	struct bigz_pair_job *job = arg;
+
+	mpz_mul(job->parts[2 * i], job->parts[2 * i], job->parts[2 * i + 1]);
+}
+
+
+/*
+ * Multiplies parts[0..n) together pairwise, one tree level at a time,
+ * leaving the product in parts[0].
+ */
+static
+void
+bigz_combine(mpz_t *parts, size_t n)
+{
+	struct bigz_pair_job job;
+	size_t i;
+
+	job.parts = parts;
+
+	while (n > 1) {
+		if (n == 2) {
+			/* the root multiply may parallelize internally */
+			bigz_mul(parts[0], parts[0], parts[1]);
+			break;
+		}
+
+		par_run(n / 2, bigz_pair_worker, &job);
+
+		for (i = 1; i < n / 2; i++)
+			mpz_swap(parts[i], parts[2 * i]);
+		if (n & 1)
+			mpz_swap(parts[n / 2], parts[n - 1]);
+		n = (n + 1) / 2;
+	}
+}
+
+
+static
+void
+bigz_prod_terms(mpz_t r, const struct bigz_terms *t, unsigned long n)
+{
+	struct bigz_chunk_job job;
+	size_t i, nparts;
+
+	nparts = (size_t)par_threads * BIGZ_CHUNKS_PER_THREAD;
+
+	if (par_threads <= 1 || n < BIGZ_PAR_MIN_TERMS || n < nparts) {
+		bigz_prod_seq(r, t, 0, n);
+		return;
+	}
+
+	if ((job.parts = malloc(nparts * sizeof(mpz_t))) == NULL) {
+		yyxerror("ENOMEM");
+		exit(1);
+	}
+
+	for (i = 0; i < nparts; i++)
+		mpz_init(job.parts[i]);
+
+	job.t = t;
+	job.n = n;
+	job.nparts = nparts;
+
+	par_run(nparts, bigz_chunk_worker, &job);
+	bigz_combine(job.parts, nparts);
+
+	mpz_swap(r, job.parts[0]);
+
+	for (i = 0; i < nparts; i++)
+		mpz_clear(job.parts[i]);
+	free(job.parts);
+}
+
+
+static
+void
+bigz_mul_worker(void *arg, size_t i)
+{
+	struct bigz_mul_job *job = arg;
+
+	bigz_mul_rec(job->r[i], job->a[i], job->b[i], job->depth);
+}
+
+
+/*
+ * One Karatsuba step on non-negative operands of similar size, with the
+ * three half-size products computed concurrently:
+ *
+ *   a * b = z2 * 2^2h + (z1 - z2 - z0) * 2^h + z0
+ *   z0 = a0 * b0, z2 = a1 * b1, z1 = (a0 + a1) * (b0 + b1)
+ */
+static
+void
+bigz_mul_kara(mpz_t r, const mpz_t a, const mpz_t b, int depth)
+{
+	struct bigz_mul_job job;
+	size_t na = mpz_size(a), nb = mpz_size(b);
+	mp_bitcnt_t h;
+	mpz_t a0, a1, b0, b1, sa, sb, z0, z1, z2;
+
+	h = (mp_bitcnt_t)(((na > nb) ? na : nb) + 1) / 2 * GMP_NUMB_BITS;
+
+	mpz_init(a0); mpz_init(a1); mpz_init(b0); mpz_init(b1);
+	mpz_init(sa); mpz_init(sb);
+	mpz_init(z0); mpz_init(z1); mpz_init(z2);
+
+	mpz_tdiv_r_2exp(a0, a, h);
+	mpz_tdiv_q_2exp(a1, a, h);
+	mpz_tdiv_r_2exp(b0, b, h);
+	mpz_tdiv_q_2exp(b1, b, h);
+	mpz_add(sa, a0, a1);
+	mpz_add(sb, b0, b1);
+
+	job.r[0] = z0; job.a[0] = a0; job.b[0] = b0;
+	job.r[1] = z2; job.a[1] = a1; job.b[1] = b1;
+	job.r[2] = z1; job.a[2] = sa; job.b[2] = sb;
+	job.depth = depth - 1;
+
+	par_run(3, bigz_mul_worker, &job);
+
+	mpz_sub(z1, z1, z0);
+	mpz_sub(z1, z1, z2);
+
+	mpz_mul_2exp(r, z2, h);
+	mpz_add(r, r, z1);
+	mpz_mul_2exp(r, r, h);
+	mpz_add(r, r, z0);
+
+	mpz_clear(a0); mpz_clear(a1); mpz_clear(b0); mpz_clear(b1);
+	mpz_clear(sa); mpz_clear(sb);
+	mpz_clear(z0); mpz_clear(z1); mpz_clear(z2);
+}
+
+
+static
+void
+bigz_mul_rec(mpz_t r, const mpz_t a, const mpz_t b, int depth)
+{
+	size_t na = mpz_size(a), nb = mpz_size(b);
+
+	if (depth <= 0 || ((na < nb) ? na : nb) * GMP_NUMB_BITS < BIGZ_PAR_MUL_BITS)
+		mpz_mul(r, a, b);
+	else
+		bigz_mul_kara(r, a, b, depth);
+}
+
+
+static
+void
+bigz_chunk_mul_worker(void *arg, size_t i)
+{
+	struct bigz_chunk_mul_job *job = arg;
+
+	mpz_mul(job->parts[i], job->parts[i], job->b);
+}
+
+
+/*
+ * a much longer than b: cut a into chunks no shorter than b, multiply
+ * each chunk by b concurrently and add up the shifted partial products.
+ */
+static
+void
+bigz_mul_chunked(mpz_t r, const mpz_t a, const mpz_t b)
+{
+	struct bigz_chunk_mul_job job;
+	size_t na = mpz_size(a), nb = mpz_size(b);
+	size_t i, k, chunk;
+	mp_bitcnt_t cb;
+	mpz_t t;
+
+	k = na / nb;
+	if (k > (size_t)par_threads)
+		k = (size_t)par_threads;
+	chunk = (na + k - 1) / k;
+	cb = (mp_bitcnt_t)chunk * GMP_NUMB_BITS;
+	k = (na + chunk - 1) / chunk;
+
+	if ((job.parts = malloc(k * sizeof(mpz_t))) == NULL) {
+		yyxerror("ENOMEM");
+		exit(1);
+	}
+
+	mpz_init(t);
+	mpz_set(t, a);
+	for (i = 0; i < k; i++) {
+		mpz_init(job.parts[i]);
+		mpz_tdiv_r_2exp(job.parts[i], t, cb);
+		mpz_tdiv_q_2exp(t, t, cb);
+	}
+	mpz_set(t, b);
+	job.b = t;
+
+	par_run(k, bigz_chunk_mul_worker, &job);
+
+	mpz_swap(r, job.parts[k - 1]);
+	for (i = k - 1; i-- > 0; ) {
+		mpz_mul_2exp(r, r, cb);
+		mpz_add(r, r, job.parts[i]);
+	}
+
+	for (i = 0; i < k; i++)
+		mpz_clear(job.parts[i]);
+	free(job.parts);
+	mpz_clear(t);
+}
+
+
+/*
+ * r = a * b.  Multiplies of two multi-megabit operands are spread over
+ * the worker threads; anything smaller goes straight to mpz_mul.  r may
+ * alias a or b.
+ */
+void
+bigz_mul(mpz_t r, const mpz_t a, const mpz_t b)
+{
+	size_t na = mpz_size(a), nb = mpz_size(b);
+	int depth, n, neg;
+	mpz_t aa, bb;
+
+	if (par_threads <= 1 ||
+	    ((na < nb) ? na : nb) * GMP_NUMB_BITS < BIGZ_PAR_MUL_BITS) {
+		mpz_mul(r, a, b);
+		return;
+	}
+
+	neg = (mpz_sgn(a) != mpz_sgn(b));
+
+	mpz_init(aa);
+	mpz_init(bb);
+	mpz_abs(aa, a);
+	mpz_abs(bb, b);
+
+	if (na >= 2 * nb) {
+		bigz_mul_chunked(r, aa, bb);
+	} else if (nb >= 2 * na) {
+		bigz_mul_chunked(r, bb, aa);
+	} else {
+		/* 3^depth concurrent products, at least one level deep */
+		for (depth = 1, n = 9; n <= par_threads; n *= 3)
+			++depth;
+		bigz_mul_kara(r, aa, bb, depth);
+	}
+
+	if (neg)
+		mpz_neg(r, r);
+
+	mpz_clear(aa);
+	mpz_clear(bb);
+}
+
+
+/*
+ * r = a^e by left-to-right binary powering on top of bigz_mul, so that
+ * the large final squarings run in parallel.  Returns -1, leaving r
+ * untouched, if the result would be unreasonably large.
+ */
+int
+bigz_pow_ui(mpz_t r, const mpz_t a, unsigned long e)
+{
+	unsigned long bit;
+	size_t bits;
+	mpz_t base;
+
+	bits = mpz_sizeinbase(a, 2);
+	if (mpz_cmpabs_ui(a, 1) > 0 && e > BIGZ_POW_MAX_BITS / (bits - 1))
+		return -1;
+
+	if (par_threads <= 1 || e < 2 ||
+	    (bits - 1) * e < 2 * BIGZ_PAR_MUL_BITS) {
+		mpz_pow_ui(r, a, e);
+		return 0;
+	}
+
+	mpz_init(base);
+	mpz_set(base, a);
+	mpz_set(r, base);
+
+	for (bit = 1; bit <= e / 2; bit <<= 1)
+		;
+	for (bit >>= 1; bit != 0; bit >>= 1) {
+		bigz_mul(r, r, r);
+		if (e & bit)
+			bigz_mul(r, r, base);
+	}
+
+	mpz_clear(base);
+	return 0;
+}
+
+
+/*
+ * r = lo * (lo + 1) * ... * hi; the empty product (lo > hi) is 1.
+ */
+void
+bigz_prod_range(mpz_t r, unsigned long lo, unsigned long hi)
+{
+	struct bigz_terms t;
+
+	if (lo > hi) {
+		mpz_set_ui(r, 1);
+		return;
+	}
+
+	if (lo == 0) {
+		mpz_set_ui(r, 0);
+		return;
+	}
+
+	t.list = NULL;
+	t.lo = lo;
+	t.odd = 0;
+
+	/* hi - lo + 1 can't wrap since lo >= 1 */
+	bigz_prod_terms(r, &t, hi - lo + 1);
+}
+
+
+void
+bigz_prod_list(mpz_t r, const unsigned long *v, size_t n)
+{
+	struct bigz_terms t;
+
+	t.list = v;
+	t.lo = 0;
+	t.odd = 0;
+
+	bigz_prod_terms(r, &t, (unsigned long)n);
+}
+
+
+/*
+ * n! as the product of the odd parts of 1..n, shifted left by the
+ * number of factors of two in n!, which is n - popcount(n).
+ */
+void
+bigz_fac(mpz_t r, unsigned long n)
+{
+	struct bigz_terms t;
+	unsigned long bits, x;
+
+	if (n < BIGZ_FAC_THRESHOLD || par_threads <= 1) {
+		mpz_fac_ui(r, n);
+		return;
+	}
+
+	t.list = NULL;
+	t.lo = 1;
+	t.odd = 1;
+	bigz_prod_terms(r, &t, n);
+
+	for (bits = 0, x = n; x != 0; x &= x - 1)
+		++bits;
+	mpz_mul_2exp(r, r, n - bits);
+}
+
+
+/*
+ * Product of all primes <= n.
+ */
+void
+bigz_primorial(mpz_t r, unsigned long n)
+{
+	unsigned long *primes;
+	size_t np;
+
+	if (n < BIGZ_PRIMORIAL_THRESHOLD || par_threads <= 1) {
+		mpz_primorial_ui(r, n);
+		return;
+	}
+
+	primes = prime_list(2, n, &np);
+	bigz_prod_list(r, primes, np);
+	free(primes);
+}
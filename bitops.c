@@ -0,0 +1,343 @@
+/*
+ * Copyright (c) 2026 Alex Hornung <alex@alexhornung.com>.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in
+ *    the documentation and/or other materials provided with the
+ *    distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE
+ * COPYRIGHT HOLDERS OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ * BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED
+ * AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT
+ * OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <gmp.h>
+
+#include "bitops.h"
+
+#if defined(__GNUC__) && defined(__x86_64__)
+#define BITOPS_X86
+#include <immintrin.h>
+#endif
+
+/*
+ * Word-sized bit manipulation kernels. The portable versions below are
+ * always available; bitops_init() swaps in BMI2/POPCNT/LZCNT versions
+ * when the CPU we are running on supports them.
+ */
+
+static
+uint64_t
+pdep_generic(uint64_t x, uint64_t m)
+{
+	uint64_t r = 0, bb;
+
+	for (bb = 1; m != 0; bb += bb) {
+		if (x & bb)
+			r |= m & -m;
+		m &= m - 1;
+	}
+
+	return r;
+}
+
+
+static
+uint64_t
+pext_generic(uint64_t x, uint64_t m)
+{
+	uint64_t r = 0, bb;
+
+	for (bb = 1; m != 0; bb += bb) {
+		if (x & m & -m)
+			r |= bb;
+		m &= m - 1;
+	}
+
+	return r;
+}
+
+
+static
+int
+popcount_generic(uint64_t x)
+{
+	x = x - ((x >> 1) & 0x5555555555555555ULL);
+	x = (x & 0x3333333333333333ULL) + ((x >> 2) & 0x3333333333333333ULL);
+	x = (x + (x >> 4)) & 0x0F0F0F0F0F0F0F0FULL;
+
+	return (int)((x * 0x0101010101010101ULL) >> 56);
+}
+
+
+static
+int
+clz_generic(uint64_t x)
+{
+	int n = 0;
+
+	if (x == 0)
+		return 64;
+#ifdef __GNUC__
+	n = __builtin_clzll(x);
+#else
+	while (!(x & (1ULL << 63))) {
+		x <<= 1;
+		++n;
+	}
+#endif
+
+	return n;
+}
+
+
+#ifdef BITOPS_X86
+__attribute__((target("bmi2")))
+static
+uint64_t
+pdep_bmi2(uint64_t x, uint64_t m)
+{
+	return _pdep_u64(x, m);
+}
+
+
+__attribute__((target("bmi2")))
+static
+uint64_t
+pext_bmi2(uint64_t x, uint64_t m)
+{
+	return _pext_u64(x, m);
+}
+
+
+__attribute__((target("popcnt")))
+static
+int
+popcount_popcnt(uint64_t x)
+{
+	return __builtin_popcountll(x);
+}
+
+
+__attribute__((target("lzcnt")))
+static
+int
+clz_lzcnt(uint64_t x)
+{
+	return (int)_lzcnt_u64(x);
+}
+#endif
+
+
+uint64_t (*bitops_pdep)(uint64_t x, uint64_t m) = pdep_generic;
+uint64_t (*bitops_pext)(uint64_t x, uint64_t m) = pext_generic;
+int (*bitops_popcount)(uint64_t x) = popcount_generic;
+int (*bitops_clz)(uint64_t x) = clz_generic;
+
+
+int
+bitops_ctz(uint64_t x)
+{
+	int n = 0;
+
+	if (x == 0)
+		return 64;
+#ifdef __GNUC__
+	n = __builtin_ctzll(x);
+#else
+	while (!(x & 1)) {
+		x >>= 1;
+		++n;
+	}
+#endif
+
+	return n;
+}
+
+
+uint64_t
+bitops_bswap(uint64_t x)
+{
+#ifdef __GNUC__
+	return __builtin_bswap64(x);
+#else
+	x = ((x & 0x00FF00FF00FF00FFULL) << 8) | ((x >> 8) & 0x00FF00FF00FF00FFULL);
+	x = ((x & 0x0000FFFF0000FFFFULL) << 16) | ((x >> 16) & 0x0000FFFF0000FFFFULL);
+	return (x << 32) | (x >> 32);
+#endif
+}
+
+
+uint64_t
+bitops_bitrev(uint64_t x)
+{
+	x = ((x & 0x5555555555555555ULL) << 1) | ((x >> 1) & 0x5555555555555555ULL);
+	x = ((x & 0x3333333333333333ULL) << 2) | ((x >> 2) & 0x3333333333333333ULL);
+	x = ((x & 0x0F0F0F0F0F0F0F0FULL) << 4) | ((x >> 4) & 0x0F0F0F0F0F0F0F0FULL);
+
+	return bitops_bswap(x);
+}
+
+
+/*
+ * Helpers to move 64-bit words in and out of GMP integers without
+ * going through unsigned long, which may be narrower.
+ */
+int
+bitops_fits_u64(const mpz_t z)
+{
+	return (mpz_sgn(z) >= 0 && mpz_sizeinbase(z, 2) <= 64);
+}
+
+
+/* The low 64 bits of z, in two's complement for negative values. */
+uint64_t
+bitops_get_u64(const mpz_t z)
+{
+	uint64_t v = 0;
+	int i;
+
+	for (i = 0; i * GMP_NUMB_BITS < 64; i++)
+		v |= (uint64_t)mpz_getlimbn(z, i) << (i * GMP_NUMB_BITS);
+
+	return (mpz_sgn(z) < 0) ? -v : v;
+}
+
+
+void
+bitops_set_u64(mpz_t r, uint64_t v)
+{
+	mp_limb_t *rp;
+	int i, n;
+
+	n = (64 + GMP_NUMB_BITS - 1) / GMP_NUMB_BITS;
+	rp = mpz_limbs_write(r, n);
+	for (i = 0; i < n; i++, v >>= GMP_NUMB_BITS - 1, v >>= 1)
+		rp[i] = (mp_limb_t)v;
+	mpz_limbs_finish(r, n);
+}
+
+
+/*
+ * Arbitrary-width deposit/extract for non-negative x and m, one mask limb
+ * at a time through the word kernels.
+ */
+void
+bitops_pdep_z(mpz_t r, const mpz_t x, const mpz_t m)
+{
+	const mp_limb_t *mp;
+	mp_limb_t *rp, v;
+	size_t mn, i, pos, li;
+	unsigned int sh, c;
+	mpz_t t;
+
+	mpz_init(t);
+	mn = mpz_size(m);
+	mp = mpz_limbs_read(m);
+	rp = mpz_limbs_write(t, mn > 0 ? mn : 1);
+
+	for (i = 0, pos = 0; i < mn; i++) {
+		c = bitops_popcount(mp[i]);
+		li = pos / GMP_NUMB_BITS;
+		sh = pos % GMP_NUMB_BITS;
+
+		v = mpz_getlimbn(x, li) >> sh;
+		if (sh != 0 && li + 1 < mpz_size(x))
+			v |= mpz_getlimbn(x, li + 1) << (GMP_NUMB_BITS - sh);
+
+		rp[i] = (mp_limb_t)bitops_pdep(v, mp[i]);
+		pos += c;
+	}
+
+	mpz_limbs_finish(t, mn);
+	mpz_swap(r, t);
+	mpz_clear(t);
+}
+
+
+void
+bitops_pext_z(mpz_t r, const mpz_t x, const mpz_t m)
+{
+	const mp_limb_t *mp;
+	mp_limb_t *rp, v;
+	size_t mn, rn, i, pos, li;
+	unsigned int sh, c;
+	mpz_t t;
+
+	mpz_init(t);
+	mn = mpz_size(m);
+	mp = mpz_limbs_read(m);
+
+	for (i = 0, pos = 0; i < mn; i++)
+		pos += bitops_popcount(mp[i]);
+	rn = pos / GMP_NUMB_BITS + 1;
+
+	rp = mpz_limbs_write(t, rn);
+	memset(rp, 0, rn * sizeof(*rp));
+
+	for (i = 0, pos = 0; i < mn; i++) {
+		if (mp[i] == 0)
+			continue;
+
+		c = bitops_popcount(mp[i]);
+		li = pos / GMP_NUMB_BITS;
+		sh = pos % GMP_NUMB_BITS;
+
+		v = (mp_limb_t)bitops_pext(mpz_getlimbn(x, i), mp[i]);
+		rp[li] |= v << sh;
+		if (sh != 0 && sh + c > GMP_NUMB_BITS)
+			rp[li + 1] |= v >> (GMP_NUMB_BITS - sh);
+
+		pos += c;
+	}
+
+	mpz_limbs_finish(t, rn);
+	mpz_swap(r, t);
+	mpz_clear(t);
+}
+
+
+void
+bitops_init(void)
+{
+#ifdef BITOPS_X86
+	__builtin_cpu_init();
+
+	/*
+	 * PDEP/PEXT are microcoded on AMD before Zen 3 and much slower
+	 * than the portable loops there.
+	 */
+	if (__builtin_cpu_supports("bmi2") &&
+	    !__builtin_cpu_is("znver1") && !__builtin_cpu_is("znver2")) {
+		bitops_pdep = pdep_bmi2;
+		bitops_pext = pext_bmi2;
+	}
+
+	if (__builtin_cpu_supports("popcnt"))
+		bitops_popcount = popcount_popcnt;
+
+	if (__builtin_cpu_supports("lzcnt"))
+		bitops_clz = clz_lzcnt;
+#endif
+}
@@ -0,0 +1,46 @@
+/*
+ * Copyright (c) 2026 Alex Hornung <alex@alexhornung.com>.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in
+ *    the documentation and/or other materials provided with the
+ *    distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE
+ * COPYRIGHT HOLDERS OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ * BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED
+ * AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT
+ * OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+
+extern uint64_t (*bitops_pdep)(uint64_t x, uint64_t m);
+extern uint64_t (*bitops_pext)(uint64_t x, uint64_t m);
+extern int (*bitops_popcount)(uint64_t x);
+extern int (*bitops_clz)(uint64_t x);
+
+int bitops_ctz(uint64_t x);
+uint64_t bitops_bitrev(uint64_t x);
+uint64_t bitops_bswap(uint64_t x);
+
+int bitops_fits_u64(const mpz_t z);
+uint64_t bitops_get_u64(const mpz_t z);
+void bitops_set_u64(mpz_t r, uint64_t v);
+
+void bitops_pdep_z(mpz_t r, const mpz_t x, const mpz_t m);
+void bitops_pext_z(mpz_t r, const mpz_t x, const mpz_t m);
+
+void bitops_init(void);
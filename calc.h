@@ -36,6 +36,7 @@
 #define HISTORY_FILE	filename_in_home(".asccalc.history")
 #define RC_DIRECTORY	filename_in_home(".asccalc.rc.d")
 #define RC_FILE		filename_in_home(".asccalc.rc")
+#define ABBREV_DEFAULT	1000	/* digits; interactive sessions only */
 
 #define BUCKET_MANUAL 0
 #define BUCKET_AST 1
@@ -43,13 +44,17 @@
 #define BUCKET_NUM_TEMP 3
 #define BUCKET_VAR 4
 #define BUCKET_FUN 5
+#define BUCKET_DUAL 6
 
 extern mpfr_rnd_t round_mode;
+extern unsigned long abbrev_digits;
 
 void go(struct parse_ctx *ctx, ast_t a);
 void num_print(num_t n);
 int num_snprint(char *s, size_t sz, int w, num_t n);
 void yyxerror(const char *s, ...);
+extern int nerrors;
+extern int errors_muted;
 void free_temp_bucket(void);
 void help(void);
 int yy_input_helper(char *buf, size_t max_size);
@@ -11,6 +11,7 @@
 #include <ctype.h>
 #include <stdio.h>
 #include <stdarg.h>
+#include <stdint.h>
 
 #include <gmp.h>
 #include <mpfr.h>
@@ -58,9 +59,13 @@ yyerror(YYLTYPE *locp, struct parse_ctx *ctx, const char *s, ...)
 
 %token EOL
 
-%token IF THEN ELSE ELSIF FI WHILE DO DONE FUNCTION ENDFUNCTION
+%token IF THEN ELSE ELSIF FI WHILE DO DONE FUNCTION ENDFUNCTION MEMO
+%token LAND LOR
 
 %right '='
+%right '?'
+%left LOR
+%left LAND
 %nonassoc <ct> CMP
 %left OR XOR
 %left '-' '+'
@@ -113,7 +118,8 @@ clist: /* nothing */
         | clist stmt EOL { go(ctx, $2); }
         | clist exp EOL { go(ctx, $2); }
         | clist exp ';' EOL { go(ctx, $2); }
-        | clist FUNCTION NAME '(' namelist ')' '=' list ENDFUNCTION EOL { user_newfun($3, $5, $8); }
+        | clist FUNCTION NAME '(' namelist ')' '=' list ENDFUNCTION EOL { user_newfun($3, $5, $8, 0); }
+        | clist MEMO FUNCTION NAME '(' namelist ')' '=' list ENDFUNCTION EOL { user_newfun($4, $6, $9, FUNC_MEMO); }
         | error EOL  { yyerrok;  }/* on error, skip until end of line */
 ;
 
@@ -125,6 +131,9 @@ partsel:   exp '[' exp ']'              { $$ = ast_newpsel(PSEL_SINGLE, $1, $3,
 
 
 exp: exp CMP exp          { $$ = ast_newcmp($2, $1, $3); }
+   | exp LAND exp         { $$ = ast_newland($1, $3); }
+   | exp LOR exp          { $$ = ast_newlor($1, $3);  }
+   | exp '?' exp ':' exp %prec '?' { $$ = ast_newflow(FLOW_IF, $1, $3, $5); }
    | exp '+' exp          { $$ = ast_new(OP_ADD, $1,$3); }
    | exp '-' exp          { $$ = ast_new(OP_SUB, $1,$3); }
    | exp '*' exp          { $$ = ast_new(OP_MUL, $1,$3); }
@@ -143,9 +152,12 @@ exp: exp CMP exp          { $$ = ast_newcmp($2, $1, $3); }
    | partsel              { $$ = $1; }
    | NUM                  { $$ = $1; }
    | NAME '(' explist ')' { $$ = ast_newcall($1, $3); }
+   | NAME '(' ')'         { $$ = ast_newcall($1, NULL); }
    | NAME                 { $$ = ast_newref($1); }
    | NAME '=' exp         { $$ = ast_newassign($1, $3); }
    | NAME '=' stmt        { $$ = ast_newassign($1, $3); }
+   | partsel '=' exp      { if (($$ = ast_newpselassign($1, $3)) == NULL) YYERROR; }
+   | partsel '=' stmt     { if (($$ = ast_newpselassign($1, $3)) == NULL) YYERROR; }
 ;
 
 
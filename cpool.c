@@ -0,0 +1,289 @@
+/*
+ * Copyright (c) 2026 Alex Hornung <alex@alexhornung.com>.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in
+ *    the documentation and/or other materials provided with the
+ *    distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE
+ * COPYRIGHT HOLDERS OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ * BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED
+ * AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT
+ * OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <assert.h>
+
+#include <gmp.h>
+#include <mpfr.h>
+
+#include "hashtable.h"
+
+#include "optype.h"
+#include "num.h"
+#include "var.h"
+#include "ast.h"
+#include "calc.h"
+#include "ival.h"
+#include "cpool.h"
+
+/*
+ * Constant pool for literals. Identical literal values share one num_t,
+ * which is reference counted by the ASTs holding it and must never be
+ * modified. Entries are keyed by their exact value, so 1000, 1_000 and
+ * 0x3E8 all end up in the same entry.
+ */
+#define CPOOL_SIZE	4099
+#define CPOOL_KEYSZ	128
+
+struct cpool_ent
+{
+	num_t n;
+	unsigned long refs;
+};
+
+static hashtable_t cpool;
+
+
+static
+void
+cpool_dtor(hashobj_t obj)
+{
+	struct cpool_ent *ent;
+
+	if ((ent = obj->data) != NULL) {
+		num_delete(ent->n);
+		free(ent);
+	}
+}
+
+
+/*
+ * The key is the type and the value in a power-of-two base, which is
+ * exact for floating point values too; intervals [f, hi] have both bounds
+ * in it. It is written to buf if it fits, and to a malloc'ed string
+ * otherwise.
+ */
+static
+char *
+cpool_key(numtype_t type, mpz_t z, mpfr_t f, mpfr_t hi, char *buf)
+{
+	char *key = buf;
+	size_t len;
+	int n;
+
+	if (type == NUM_INT) {
+		len = mpz_sizeinbase(z, 32) + 3;
+		if (len > CPOOL_KEYSZ && (key = malloc(len)) == NULL) {
+			yyxerror("ENOMEM");
+			exit(1);
+		}
+		key[0] = 'z';
+		mpz_get_str(key + 1, 32, z);
+	} else if (type == NUM_IVAL) {
+		n = mpfr_snprintf(buf, CPOOL_KEYSZ, "i%ld:%Ra:%Ra",
+		    (long)mpfr_get_prec(f), f, hi);
+		if (n >= CPOOL_KEYSZ) {
+			if ((key = malloc((size_t)n + 1)) == NULL) {
+				yyxerror("ENOMEM");
+				exit(1);
+			}
+			mpfr_snprintf(key, (size_t)n + 1, "i%ld:%Ra:%Ra",
+			    (long)mpfr_get_prec(f), f, hi);
+		}
+	} else {
+		n = mpfr_snprintf(buf, CPOOL_KEYSZ, "f%ld:%Ra",
+		    (long)mpfr_get_prec(f), f);
+		if (n >= CPOOL_KEYSZ) {
+			if ((key = malloc((size_t)n + 1)) == NULL) {
+				yyxerror("ENOMEM");
+				exit(1);
+			}
+			mpfr_snprintf(key, (size_t)n + 1, "f%ld:%Ra",
+			    (long)mpfr_get_prec(f), f);
+		}
+	}
+
+	return key;
+}
+
+
+void
+cpool_init(void)
+{
+	cpool = hashtable_new(CPOOL_SIZE, NULL, cpool_dtor);
+}
+
+
+/*
+ * Returns the pooled num_t for literal str, taking a reference to it.
+ * The literal is parsed into stack temporaries, so a hit allocates
+ * nothing but the key of very long literals.
+ */
+num_t
+cpool_get(numtype_t typehint, const char *str)
+{
+	struct cpool_ent *ent;
+	char buf[CPOOL_KEYSZ], *key;
+	numtype_t type;
+	hashobj_t obj;
+	mpz_t z;
+	mpfr_t f, hi;
+
+	if (ival_mode)
+		type = num_parse_literal_ival(typehint, str, z, f, hi);
+	else
+		type = num_parse_literal(typehint, str, z, f);
+	key = cpool_key(type, z, f, hi, buf);
+
+	if ((obj = hashtable_lookup(cpool, key, 1)) == NULL) {
+		yyxerror("ENOMEM");
+		exit(1);
+	}
+
+	if ((ent = obj->data) != NULL) {
+		ent->refs++;
+		if (type == NUM_INT) {
+			mpz_clear(z);
+		} else if (type == NUM_IVAL) {
+			mpfr_clear(f);
+			mpfr_clear(hi);
+		} else {
+			mpfr_clear(f);
+		}
+	} else {
+		if ((ent = malloc(sizeof(*ent))) == NULL) {
+			yyxerror("ENOMEM");
+			exit(1);
+		}
+
+		ent->n = num_new(0);
+		ent->n->num_type = type;
+		if (type == NUM_INT) {
+			mpz_init(Z(ent->n));
+			mpz_swap(Z(ent->n), z);
+			mpz_clear(z);
+		} else if (type == NUM_IVAL) {
+			mpfr_init2(I(ent->n).lo, MPFR_PREC_MIN);
+			mpfr_init2(I(ent->n).hi, MPFR_PREC_MIN);
+			mpfr_swap(I(ent->n).lo, f);
+			mpfr_swap(I(ent->n).hi, hi);
+			mpfr_clear(f);
+			mpfr_clear(hi);
+		} else {
+			mpfr_init2(F(ent->n), MPFR_PREC_MIN);
+			mpfr_swap(F(ent->n), f);
+			mpfr_clear(f);
+		}
+		ent->refs = 1;
+		obj->data = ent;
+	}
+
+	if (key != buf)
+		free(key);
+
+	return ent->n;
+}
+
+
+/* Drops a reference taken by cpool_get. */
+void
+cpool_put(num_t n)
+{
+	struct cpool_ent *ent;
+	char buf[CPOOL_KEYSZ], *key;
+	hashobj_t obj;
+
+	if (n->num_type == NUM_IVAL)
+		key = cpool_key(n->num_type, Z(n), I(n).lo, I(n).hi, buf);
+	else
+		key = cpool_key(n->num_type, Z(n), F(n), NULL, buf);
+
+	obj = hashtable_lookup(cpool, key, 0);
+	assert(obj != NULL && obj->data != NULL);
+
+	ent = obj->data;
+	assert(ent->n == n);
+
+	if (--ent->refs == 0)
+		hashtable_remove(cpool, key);
+
+	if (key != buf)
+		free(key);
+}
+
+
+/*
+ * Returns the pooled num_t equal to the computed value n, taking a
+ * reference to it; n itself is left alone. Only integers, floating point
+ * values and intervals can be pooled.
+ */
+num_t
+cpool_intern(num_t n)
+{
+	struct cpool_ent *ent;
+	char buf[CPOOL_KEYSZ], *key;
+	hashobj_t obj;
+
+	assert(n->num_type != NUM_FIXED);
+
+	if (n->num_type == NUM_IVAL)
+		key = cpool_key(n->num_type, Z(n), I(n).lo, I(n).hi, buf);
+	else
+		key = cpool_key(n->num_type, Z(n), F(n), NULL, buf);
+
+	if ((obj = hashtable_lookup(cpool, key, 1)) == NULL) {
+		yyxerror("ENOMEM");
+		exit(1);
+	}
+
+	if ((ent = obj->data) != NULL) {
+		ent->refs++;
+	} else {
+		if ((ent = malloc(sizeof(*ent))) == NULL) {
+			yyxerror("ENOMEM");
+			exit(1);
+		}
+
+		/* the copy keeps the precision, and with it the key */
+		ent->n = num_new(0);
+		ent->n->num_type = n->num_type;
+		if (n->num_type == NUM_INT) {
+			mpz_init_set(Z(ent->n), Z(n));
+		} else if (n->num_type == NUM_IVAL) {
+			mpfr_init2(I(ent->n).lo, mpfr_get_prec(I(n).lo));
+			mpfr_init2(I(ent->n).hi, mpfr_get_prec(I(n).hi));
+			mpfr_set(I(ent->n).lo, I(n).lo, MPFR_RNDN);
+			mpfr_set(I(ent->n).hi, I(n).hi, MPFR_RNDN);
+		} else {
+			mpfr_init2(F(ent->n), mpfr_get_prec(F(n)));
+			mpfr_set(F(ent->n), F(n), MPFR_RNDN);
+		}
+		ent->refs = 1;
+		obj->data = ent;
+	}
+
+	if (key != buf)
+		free(key);
+
+	return ent->n;
+}
@@ -0,0 +1,1028 @@
+/*
+ * Copyright (c) 2026 Alex Hornung <alex@alexhornung.com>.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in
+ *    the documentation and/or other materials provided with the
+ *    distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE
+ * COPYRIGHT HOLDERS OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ * BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED
+ * AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT
+ * OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <assert.h>
+
+#include <gmp.h>
+#include <mpfr.h>
+
+#include "hashtable.h"
+
+#include "optype.h"
+#include "num.h"
+#include "var.h"
+#include "ast.h"
+#include "calc.h"
+#include "safe_mem.h"
+#include "func.h"
+#include "ival.h"
+#include "dual.h"
+
+/*
+ * Forward-mode automatic differentiation. A function's AST is evaluated
+ * once on dual numbers, each of which carries its value together with
+ * its derivatives along ndir seed directions, so a single pass yields
+ * the value and the exact derivatives. The values are computed exactly
+ * as eval() would compute them; a NULL tangent stands for a constant.
+ * Duals live in BUCKET_DUAL until the end of dual_diff(); their numbers
+ * are ordinary temporaries.
+ */
+typedef struct dual
+{
+	num_t v;
+	num_t *d;
+} *dual_t;
+
+typedef void (*dual_rule_t)(int, num_t *, num_t, num_t *);
+
+static int ndir;
+
+
+static
+dual_t
+dual_new(num_t v, num_t *d)
+{
+	dual_t r;
+
+	if ((r = alloc_safe_mem(BUCKET_DUAL, sizeof(*r))) == NULL) {
+		yyxerror("ENOMEM");
+		exit(1);
+	}
+
+	r->v = v;
+	r->d = d;
+
+	return r;
+}
+
+
+static
+num_t *
+dual_tangent(void)
+{
+	num_t *d;
+
+	if ((d = alloc_safe_mem(BUCKET_DUAL, sizeof(num_t) * ndir)) == NULL) {
+		yyxerror("ENOMEM");
+		exit(1);
+	}
+
+	return d;
+}
+
+
+static
+num_t
+dual_int(long i)
+{
+	num_t r;
+
+	r = num_new_z(N_TEMP, NULL);
+	mpz_set_si(Z(r), i);
+
+	return r;
+}
+
+
+static
+num_t
+dual_op(optype_t op, num_t a, num_t b)
+{
+	if (a == NULL || b == NULL)
+		return NULL;
+
+	return num_float_two_op(op, a, b);
+}
+
+
+static
+num_t
+dual_neg(num_t a)
+{
+	if (a == NULL)
+		return NULL;
+
+	return num_float_one_op(OP_UMINUS, a);
+}
+
+
+/* 1 / a, in floating point so that a zero a gives an infinity */
+static
+num_t
+dual_recip(num_t a)
+{
+	num_t r;
+
+	r = num_new_fp(N_TEMP, NULL);
+	mpfr_set_ui(F(r), 1, round_mode);
+
+	return dual_op(OP_DIV, r, a);
+}
+
+
+/* Calls the one-argument builtin s, so that interval mode is honoured. */
+static
+num_t
+dual_fn(const char *s, num_t a)
+{
+	func_t fn;
+
+	if (a == NULL)
+		return NULL;
+
+	fn = funlookup(s, 0);
+	assert(fn != NULL && fn->builtin);
+
+	return fn->fn(fn->priv, s, 1, &a);
+}
+
+
+/*
+ * The partial derivatives of the builtins, with a the arguments and v
+ * the result. A partial left NULL means the builtin is not
+ * differentiable in that argument.
+ */
+static
+void
+rule_zero(int nargs, num_t *a, num_t v, num_t *p)
+{
+	p[0] = dual_int(0);
+}
+
+
+static
+void
+rule_sqrt(int nargs, num_t *a, num_t v, num_t *p)
+{
+	p[0] = dual_recip(dual_op(OP_MUL, dual_int(2), v));
+}
+
+
+static
+void
+rule_cbrt(int nargs, num_t *a, num_t v, num_t *p)
+{
+	p[0] = dual_recip(dual_op(OP_MUL, dual_int(3), dual_op(OP_MUL, v, v)));
+}
+
+
+static
+void
+rule_root(int nargs, num_t *a, num_t v, num_t *p)
+{
+	p[0] = dual_op(OP_MUL, v, dual_recip(dual_op(OP_MUL, a[1], a[0])));
+}
+
+
+static
+void
+rule_abs(int nargs, num_t *a, num_t v, num_t *p)
+{
+	p[0] = dual_fn("sgn", a[0]);
+}
+
+
+static
+void
+rule_ln(int nargs, num_t *a, num_t v, num_t *p)
+{
+	p[0] = dual_recip(a[0]);
+}
+
+
+static
+void
+rule_log2(int nargs, num_t *a, num_t v, num_t *p)
+{
+	p[0] = dual_recip(dual_op(OP_MUL, a[0], dual_fn("ln", dual_int(2))));
+}
+
+
+static
+void
+rule_log10(int nargs, num_t *a, num_t v, num_t *p)
+{
+	p[0] = dual_recip(dual_op(OP_MUL, a[0], dual_fn("ln", dual_int(10))));
+}
+
+
+static
+void
+rule_exp(int nargs, num_t *a, num_t v, num_t *p)
+{
+	p[0] = v;
+}
+
+
+static
+void
+rule_sin(int nargs, num_t *a, num_t v, num_t *p)
+{
+	p[0] = dual_fn("cos", a[0]);
+}
+
+
+static
+void
+rule_cos(int nargs, num_t *a, num_t v, num_t *p)
+{
+	p[0] = dual_neg(dual_fn("sin", a[0]));
+}
+
+
+static
+void
+rule_tan(int nargs, num_t *a, num_t v, num_t *p)
+{
+	p[0] = dual_op(OP_ADD, dual_int(1), dual_op(OP_MUL, v, v));
+}
+
+
+static
+void
+rule_tanh(int nargs, num_t *a, num_t v, num_t *p)
+{
+	p[0] = dual_op(OP_SUB, dual_int(1), dual_op(OP_MUL, v, v));
+}
+
+
+static
+void
+rule_cot(int nargs, num_t *a, num_t v, num_t *p)
+{
+	p[0] = dual_neg(dual_op(OP_ADD, dual_int(1), dual_op(OP_MUL, v, v)));
+}
+
+
+static
+void
+rule_sec(int nargs, num_t *a, num_t v, num_t *p)
+{
+	p[0] = dual_op(OP_MUL, v, dual_fn("tan", a[0]));
+}
+
+
+static
+void
+rule_csc(int nargs, num_t *a, num_t v, num_t *p)
+{
+	p[0] = dual_neg(dual_op(OP_MUL, v, dual_fn("cot", a[0])));
+}
+
+
+static
+void
+rule_sech(int nargs, num_t *a, num_t v, num_t *p)
+{
+	p[0] = dual_neg(dual_op(OP_MUL, v, dual_fn("tanh", a[0])));
+}
+
+
+static
+void
+rule_csch(int nargs, num_t *a, num_t v, num_t *p)
+{
+	p[0] = dual_neg(dual_op(OP_MUL, v, dual_fn("coth", a[0])));
+}
+
+
+static
+void
+rule_sinh(int nargs, num_t *a, num_t v, num_t *p)
+{
+	p[0] = dual_fn("cosh", a[0]);
+}
+
+
+static
+void
+rule_cosh(int nargs, num_t *a, num_t v, num_t *p)
+{
+	p[0] = dual_fn("sinh", a[0]);
+}
+
+
+/* 1 / sqrt(s + t * a^2) */
+static
+num_t
+rsqrt_sq(long s, long t, num_t a)
+{
+	return dual_recip(dual_fn("sqrt",
+	    dual_op(OP_ADD, dual_int(s),
+	    dual_op(OP_MUL, dual_int(t), dual_op(OP_MUL, a, a)))));
+}
+
+
+/* 1 / (s + t * a^2) */
+static
+num_t
+recip_sq(long s, long t, num_t a)
+{
+	return dual_recip(dual_op(OP_ADD, dual_int(s),
+	    dual_op(OP_MUL, dual_int(t), dual_op(OP_MUL, a, a))));
+}
+
+
+static
+void
+rule_asin(int nargs, num_t *a, num_t v, num_t *p)
+{
+	p[0] = rsqrt_sq(1, -1, a[0]);
+}
+
+
+static
+void
+rule_acos(int nargs, num_t *a, num_t v, num_t *p)
+{
+	p[0] = dual_neg(rsqrt_sq(1, -1, a[0]));
+}
+
+
+static
+void
+rule_atan(int nargs, num_t *a, num_t v, num_t *p)
+{
+	p[0] = recip_sq(1, 1, a[0]);
+}
+
+
+static
+void
+rule_asinh(int nargs, num_t *a, num_t v, num_t *p)
+{
+	p[0] = rsqrt_sq(1, 1, a[0]);
+}
+
+
+static
+void
+rule_acosh(int nargs, num_t *a, num_t v, num_t *p)
+{
+	p[0] = rsqrt_sq(-1, 1, a[0]);
+}
+
+
+static
+void
+rule_atanh(int nargs, num_t *a, num_t v, num_t *p)
+{
+	p[0] = recip_sq(1, -1, a[0]);
+}
+
+
+/* erf, erfc: +-2/sqrt(pi) * exp(-a^2) */
+static
+void
+rule_erf(int nargs, num_t *a, num_t v, num_t *p)
+{
+	num_t pi;
+
+	pi = ival_mode ? num_new_ival_const_pi(N_TEMP) :
+	    num_new_const_pi(N_TEMP);
+	p[0] = dual_op(OP_MUL,
+	    dual_op(OP_DIV, dual_int(2), dual_fn("sqrt", pi)),
+	    dual_fn("exp", dual_neg(dual_op(OP_MUL, a[0], a[0]))));
+}
+
+
+static
+void
+rule_erfc(int nargs, num_t *a, num_t v, num_t *p)
+{
+	rule_erf(nargs, a, v, p);
+	p[0] = dual_neg(p[0]);
+}
+
+
+static
+void
+rule_deg2rad(int nargs, num_t *a, num_t v, num_t *p)
+{
+	p[0] = dual_fn("deg2rad", dual_int(1));
+}
+
+
+static
+void
+rule_rad2deg(int nargs, num_t *a, num_t v, num_t *p)
+{
+	p[0] = dual_fn("rad2deg", dual_int(1));
+}
+
+
+/* atan2(y, x): (x, -y) / (x^2 + y^2) */
+static
+void
+rule_atan2(int nargs, num_t *a, num_t v, num_t *p)
+{
+	num_t r;
+
+	r = dual_op(OP_ADD, dual_op(OP_MUL, a[0], a[0]),
+	    dual_op(OP_MUL, a[1], a[1]));
+	r = dual_recip(r);
+	p[0] = dual_op(OP_MUL, a[1], r);
+	p[1] = dual_neg(dual_op(OP_MUL, a[0], r));
+}
+
+
+static
+void
+rule_hypot(int nargs, num_t *a, num_t v, num_t *p)
+{
+	p[0] = dual_op(OP_MUL, a[0], dual_recip(v));
+	p[1] = dual_op(OP_MUL, a[1], dual_recip(v));
+}
+
+
+/* min, max: follow the first argument that was picked */
+static
+void
+rule_pick(int nargs, num_t *a, num_t v, num_t *p)
+{
+	int i, found;
+
+	for (i = found = 0; i < nargs; i++) {
+		if (!found && !num_is_zero(num_cmp(CMP_EQ, a[i], v))) {
+			p[i] = dual_int(1);
+			found = 1;
+		} else {
+			p[i] = dual_int(0);
+		}
+	}
+}
+
+
+static
+void
+rule_avg(int nargs, num_t *a, num_t v, num_t *p)
+{
+	int i;
+
+	for (i = 0; i < nargs; i++)
+		p[i] = dual_recip(dual_int(nargs));
+}
+
+
+static const struct dual_rule
+{
+	const char *name;
+	dual_rule_t rule;
+} dual_rules[] = {
+	{ "sqrt",	rule_sqrt },
+	{ "cbrt",	rule_cbrt },
+	{ "root",	rule_root },
+	{ "abs",	rule_abs },
+	{ "sgn",	rule_zero },
+	{ "ln",		rule_ln },
+	{ "log2",	rule_log2 },
+	{ "log10",	rule_log10 },
+	{ "exp",	rule_exp },
+	{ "sec",	rule_sec },
+	{ "csc",	rule_csc },
+	{ "cot",	rule_cot },
+	{ "cos",	rule_cos },
+	{ "sin",	rule_sin },
+	{ "tan",	rule_tan },
+	{ "acos",	rule_acos },
+	{ "asin",	rule_asin },
+	{ "atan",	rule_atan },
+	{ "atan2",	rule_atan2 },
+	{ "cosh",	rule_cosh },
+	{ "sinh",	rule_sinh },
+	{ "tanh",	rule_tanh },
+	{ "sech",	rule_sech },
+	{ "csch",	rule_csch },
+	{ "coth",	rule_tanh },
+	{ "acosh",	rule_acosh },
+	{ "asinh",	rule_asinh },
+	{ "atanh",	rule_atanh },
+	{ "erf",	rule_erf },
+	{ "erfc",	rule_erfc },
+	{ "hypot",	rule_hypot },
+	{ "round",	rule_zero },
+	{ "ceil",	rule_zero },
+	{ "floor",	rule_zero },
+	{ "trunc",	rule_zero },
+	{ "int",	rule_zero },
+	{ "deg2rad",	rule_deg2rad },
+	{ "rad2deg",	rule_rad2deg },
+	{ "min",	rule_pick },
+	{ "max",	rule_pick },
+	{ "avg",	rule_avg },
+	{ NULL,		NULL }
+};
+
+
+/*
+ * The dual of a result v with partial derivatives p with respect to
+ * the arguments a: its tangent is the sum of p[i] * a[i]->d. A NULL
+ * partial of a non-constant argument means it cannot be differentiated.
+ */
+static
+dual_t
+dual_chain(const char *s, num_t v, int nargs, dual_t *a, num_t *p)
+{
+	num_t *d;
+	int i, j;
+
+	d = NULL;
+	for (i = 0; i < nargs; i++) {
+		if (a[i]->d == NULL)
+			continue;
+
+		if (p[i] == NULL) {
+			yyxerror("Cannot differentiate '%s' with respect to argument %d",
+			    s, i + 1);
+			return NULL;
+		}
+
+		if (d == NULL) {
+			d = dual_tangent();
+			for (j = 0; j < ndir; j++)
+				d[j] = dual_op(OP_MUL, p[i], a[i]->d[j]);
+		} else {
+			for (j = 0; j < ndir; j++)
+				d[j] = dual_op(OP_ADD, d[j],
+				    dual_op(OP_MUL, p[i], a[i]->d[j]));
+		}
+	}
+
+	if (d != NULL)
+		for (j = 0; j < ndir; j++)
+			if (d[j] == NULL)
+				return NULL;
+
+	return dual_new(v, d);
+}
+
+
+static
+dual_t
+dual_two_op(optype_t op, dual_t l, dual_t r)
+{
+	dual_t a[2];
+	num_t p[2], v;
+
+	if ((v = num_float_two_op(op, l->v, r->v)) == NULL)
+		return NULL;
+
+	if (l->d == NULL && r->d == NULL)
+		return dual_new(v, NULL);
+
+	p[0] = p[1] = NULL;
+
+	switch (op) {
+	case OP_ADD:
+		p[0] = p[1] = dual_int(1);
+		break;
+
+	case OP_SUB:
+		p[0] = dual_int(1);
+		p[1] = dual_int(-1);
+		break;
+
+	case OP_MUL:
+		p[0] = r->v;
+		p[1] = l->v;
+		break;
+
+	case OP_DIV:
+		p[0] = dual_recip(r->v);
+		p[1] = dual_neg(dual_op(OP_DIV, v, r->v));
+		break;
+
+	case OP_MOD:
+		/* a % b = a - q * b, with the quotient q locally constant */
+		p[0] = dual_int(1);
+		if (r->d != NULL)
+			p[1] = dual_neg(dual_op(OP_DIV,
+			    dual_op(OP_SUB, l->v, v), r->v));
+		break;
+
+	case OP_POW:
+		if (l->d != NULL)
+			p[0] = dual_op(OP_MUL, r->v, dual_op(OP_POW, l->v,
+			    dual_op(OP_SUB, r->v, dual_int(1))));
+		if (r->d != NULL)
+			p[1] = dual_op(OP_MUL, v, dual_fn("ln", l->v));
+		break;
+
+	default:
+		yyxerror("Unknown op in dual_two_op");
+		return NULL;
+	}
+
+	a[0] = l;
+	a[1] = r;
+
+	return dual_chain("operator", v, 2, a, p);
+}
+
+
+static dual_t dual_call(const char *s, explist_t l, hashtable_t env);
+
+
+static
+dual_t
+dual_eval(ast_t a, hashtable_t env)
+{
+	astcmp_t acmp;
+	astflow_t af;
+	astpsel_t ap;
+	astpselassign_t apa;
+	hashobj_t obj;
+	dual_t n, c, l, r, hi, lo;
+	num_t v;
+	var_t var;
+	int i;
+
+	assert(a != NULL);
+
+	switch (a->op_type) {
+	case OP_CMP:
+		acmp = (astcmp_t)a;
+		l = dual_eval(acmp->l, env);
+		r = dual_eval(acmp->r, env);
+		if (l == NULL || r == NULL)
+			return NULL;
+		n = dual_new(num_cmp(acmp->cmp_type, l->v, r->v), NULL);
+		break;
+
+	case OP_LISTING:
+		if (dual_eval(a->l, env) == NULL)
+			return NULL;
+		n = dual_eval(a->r, env);
+		break;
+
+	case OP_FLOW:
+		af = (astflow_t)a;
+		n = dual_new(num_new_const_zero(N_TEMP), NULL);
+		switch (af->flow_type) {
+		case FLOW_IF:
+			if ((c = dual_eval(af->cond, env)) == NULL)
+				return NULL;
+			if (!num_is_zero(c->v)) {
+				if (af->t != NULL)
+					n = dual_eval(af->t, env);
+			} else {
+				if (af->f != NULL)
+					n = dual_eval(af->f, env);
+			}
+			break;
+
+		case FLOW_WHILE:
+			if ((c = dual_eval(af->cond, env)) == NULL)
+				return NULL;
+			while (!num_is_zero(c->v)) {
+				n = dual_eval(af->t, env);
+				if ((c = dual_eval(af->cond, env)) == NULL)
+					return NULL;
+			}
+			break;
+		}
+		break;
+
+	case OP_ADD:
+	case OP_SUB:
+	case OP_MUL:
+	case OP_DIV:
+	case OP_MOD:
+	case OP_POW:
+		l = dual_eval(a->l, env);
+		r = dual_eval(a->r, env);
+		if (l == NULL || r == NULL)
+			return NULL;
+		n = dual_two_op(a->op_type, l, r);
+		break;
+
+	case OP_AND:
+	case OP_OR:
+	case OP_XOR:
+	case OP_SHR:
+	case OP_SHL:
+		l = dual_eval(a->l, env);
+		r = dual_eval(a->r, env);
+		if (l == NULL || r == NULL)
+			return NULL;
+		if (l->d != NULL || r->d != NULL) {
+			yyxerror("Cannot differentiate integer operations");
+			return NULL;
+		}
+		if ((v = num_int_two_op(a->op_type, l->v, r->v)) == NULL)
+			return NULL;
+		n = dual_new(v, NULL);
+		break;
+
+	case OP_UMINUS:
+		if ((l = dual_eval(a->l, env)) == NULL)
+			return NULL;
+		if ((v = num_float_one_op(a->op_type, l->v)) == NULL)
+			return NULL;
+		n = dual_new(v, NULL);
+		if (l->d != NULL) {
+			n->d = dual_tangent();
+			for (i = 0; i < ndir; i++)
+				n->d[i] = dual_neg(l->d[i]);
+		}
+		break;
+
+	case OP_UINV:
+	case OP_FAC:
+		if ((l = dual_eval(a->l, env)) == NULL)
+			return NULL;
+		if (l->d != NULL) {
+			yyxerror("Cannot differentiate integer operations");
+			return NULL;
+		}
+		if ((v = num_int_one_op(a->op_type, l->v)) == NULL)
+			return NULL;
+		n = dual_new(v, NULL);
+		break;
+
+	case OP_PSEL:
+		ap = (astpsel_t)a;
+		if ((l = dual_eval(ap->l, env)) == NULL)
+			return NULL;
+		if ((hi = dual_eval(ap->hi, env)) == NULL)
+			return NULL;
+		lo = NULL;
+		if (ap->lo != NULL && (lo = dual_eval(ap->lo, env)) == NULL)
+			return NULL;
+		if (l->d != NULL) {
+			yyxerror("Cannot differentiate integer operations");
+			return NULL;
+		}
+		v = num_int_part_sel(ap->psel_type, hi->v,
+		    (lo != NULL) ? lo->v : NULL, l->v);
+		if (v == NULL)
+			return NULL;
+		n = dual_new(v, NULL);
+		break;
+
+	case OP_NUM:
+		n = dual_new(((astnum_t) a)->num, NULL);
+		break;
+
+	case OP_VARREF:
+		obj = hashtable_lookup(env, ((astref_t) a)->name, 0);
+		if (obj != NULL && obj->data != NULL) {
+			n = obj->data;
+			break;
+		}
+
+		if ((var = varlookup(((astref_t) a)->name, 0)) == NULL) {
+			yyxerror("Variable '%s' not defined",
+			    ((astref_t) a)->name);
+			return NULL;
+		}
+		n = dual_new(var->v, NULL);
+		break;
+
+	case OP_VARASSIGN:
+		if ((l = dual_eval(((astassign_t)a)->v, env)) == NULL)
+			return NULL;
+		n = dual_new(num_new_z_or_fp(N_TEMP, l->v), l->d);
+		obj = hashtable_lookup(env, ((astassign_t) a)->name, 1);
+		obj->data = n;
+		break;
+
+	case OP_PSELASSIGN:
+		apa = (astpselassign_t)a;
+		if ((l = dual_eval(apa->v, env)) == NULL)
+			return NULL;
+		if ((hi = dual_eval(apa->hi, env)) == NULL)
+			return NULL;
+		lo = NULL;
+		if (apa->lo != NULL && (lo = dual_eval(apa->lo, env)) == NULL)
+			return NULL;
+
+		obj = hashtable_lookup(env, apa->name, 1);
+		r = obj->data;
+		if (l->d != NULL || (r != NULL && r->d != NULL)) {
+			yyxerror("Cannot differentiate integer operations");
+			return NULL;
+		}
+
+		/* the bits are written into a private integer copy */
+		r = dual_new(num_new_z(N_TEMP, (r != NULL) ? r->v : NULL),
+		    NULL);
+		v = num_int_part_set(apa->psel_type, hi->v,
+		    (lo != NULL) ? lo->v : NULL, r->v, l->v);
+		if (v == NULL)
+			return NULL;
+		obj->data = r;
+		n = dual_new(v, NULL);
+		break;
+
+	case OP_CALL:
+		n = dual_call(((astcall_t) a)->name, ((astcall_t) a)->l, env);
+		break;
+
+	default:
+		yyxerror("Unknown op type %d", a->op_type);
+		return NULL;
+	}
+
+	return n;
+}
+
+
+static
+int
+dual_check_args(func_t fn, const char *s, int nargs)
+{
+	if (fn == NULL) {
+		yyxerror("Unknown function '%s'", s);
+		return -1;
+	}
+
+	if (fn->flags & FUNC_FN_ARG) {
+		yyxerror("Cannot differentiate '%s'", s);
+		return -1;
+	}
+
+	if (nargs < fn->minargs || nargs > fn->maxargs) {
+		if (fn->minargs == fn->maxargs)
+			yyxerror("Function '%s' takes exactly %d arguments", s,
+			    fn->minargs);
+		else
+			yyxerror
+			    ("Function '%s' takes a minimum of %d and a maximum of %d arguments",
+			    s, fn->minargs, fn->maxargs);
+
+		return -1;
+	}
+
+	return 0;
+}
+
+
+static
+dual_t
+dual_apply(func_t fn, const char *s, int nargs, dual_t *args)
+{
+	const struct dual_rule *rule;
+	hashtable_t env;
+	namelist_t pn;
+	num_t *v, *p, r;
+	dual_t n;
+	int i, varying;
+
+	if (!fn->builtin) {
+		/* this recurses in C just like the tree walker */
+		if (fun_enter() < 0)
+			return NULL;
+
+		env = hashtable_new(121, NULL, NULL);
+		for (pn = fn->namelist, i = 0; pn != NULL; pn = pn->next, i++)
+			hashtable_lookup(env, pn->name, 1)->data = args[i];
+
+		n = dual_eval(fn->ast, env);
+		hashtable_destroy(env);
+		fun_leave();
+
+		if (n != NULL)
+			n = dual_new(num_new_z_or_fp(N_TEMP, n->v), n->d);
+
+		return n;
+	}
+
+	if ((v = alloc_safe_mem(BUCKET_DUAL, 2 * sizeof(num_t) * nargs)) == NULL) {
+		yyxerror("ENOMEM");
+		exit(1);
+	}
+	p = v + nargs;
+
+	varying = 0;
+	for (i = 0; i < nargs; i++) {
+		v[i] = args[i]->v;
+		p[i] = NULL;
+		if (args[i]->d != NULL)
+			varying = 1;
+	}
+
+	if ((r = fn->fn(fn->priv, s, nargs, v)) == NULL)
+		return NULL;
+
+	if (!varying)
+		return dual_new(r, NULL);
+
+	for (rule = dual_rules; rule->name != NULL; rule++)
+		if (strcmp(rule->name, s) == 0)
+			break;
+
+	if (rule->name == NULL) {
+		yyxerror("Cannot differentiate '%s'", s);
+		return NULL;
+	}
+
+	rule->rule(nargs, v, r, p);
+
+	return dual_chain(s, r, nargs, args, p);
+}
+
+
+static
+dual_t
+dual_call(const char *s, explist_t l, hashtable_t env)
+{
+	func_t fn;
+	explist_t p;
+	dual_t *args;
+	int nargs, i;
+
+	nargs = 0;
+	for (p = l; p != NULL; p = p->next)
+		++nargs;
+
+	fn = funlookup(s, 0);
+	if (dual_check_args(fn, s, nargs) < 0)
+		return NULL;
+
+	if ((args = alloc_safe_mem(BUCKET_DUAL, sizeof(dual_t) * nargs)) == NULL) {
+		yyxerror("ENOMEM");
+		exit(1);
+	}
+
+	for (p = l, i = 0; p != NULL; p = p->next, i++)
+		if ((args[i] = dual_eval(p->ast, env)) == NULL)
+			return NULL;
+
+	return dual_apply(fn, s, nargs, args);
+}
+
+
+/*
+ * Evaluates the function s at x, returning its value and storing its
+ * derivatives with respect to the first nd arguments in grad.
+ */
+num_t
+dual_diff(const char *s, int nargs, num_t *x, int nd, num_t *grad)
+{
+	func_t fn;
+	dual_t *args, n;
+	num_t r;
+	int i, j;
+
+	fn = funlookup(s, 0);
+	if (dual_check_args(fn, s, nargs) < 0)
+		return NULL;
+
+	ndir = nd;
+
+	if ((args = alloc_safe_mem(BUCKET_DUAL, sizeof(dual_t) * nargs)) == NULL) {
+		yyxerror("ENOMEM");
+		exit(1);
+	}
+
+	for (i = 0; i < nargs; i++) {
+		args[i] = dual_new(x[i], NULL);
+		if (i < nd) {
+			args[i]->d = dual_tangent();
+			for (j = 0; j < nd; j++)
+				args[i]->d[j] = dual_int(i == j);
+		}
+	}
+
+	r = NULL;
+	if ((n = dual_apply(fn, s, nargs, args)) != NULL) {
+		r = n->v;
+		for (j = 0; j < nd; j++)
+			grad[j] = (n->d != NULL) ? n->d[j] : dual_int(0);
+	}
+
+	free_safe_mem_bucket(BUCKET_DUAL);
+
+	return r;
+}
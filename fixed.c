@@ -0,0 +1,856 @@
+/*
+ * Copyright (c) 2026 Alex Hornung <alex@alexhornung.com>.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in
+ *    the documentation and/or other materials provided with the
+ *    distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE
+ * COPYRIGHT HOLDERS OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ * BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED
+ * AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT
+ * OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <limits.h>
+#include <assert.h>
+
+#include <gmp.h>
+#include <mpfr.h>
+
+#include "hashtable.h"
+
+#include "optype.h"
+#include "num.h"
+#include "var.h"
+#include "ast.h"
+#include "calc.h"
+#include "safe_mem.h"
+#include "fixed.h"
+#include "fold.h"
+
+/*
+ * Formats up to this many bits keep their raw word in an int64_t; the
+ * headroom lets sums and narrow products be formed exactly in 64 bits.
+ */
+#define FX_NARROW_BITS	62
+#define FX_MAX_BITS	(1 << 20)
+
+static fxovf_t fx_default_ovf = FX_SAT;
+static fxrnd_t fx_default_rnd = FX_TRUNC;
+
+
+static
+int
+fx_width(const struct numfx *f)
+{
+	return f->m + f->n;
+}
+
+
+static
+void
+fx_mpz_set_i64(mpz_t r, int64_t v)
+{
+#if LONG_MAX >= INT64_MAX
+	mpz_set_si(r, (long)v);
+#else
+	uint64_t u = (v < 0) ? -(uint64_t)v : (uint64_t)v;
+
+	mpz_set_ui(r, (unsigned long)(u >> 32));
+	mpz_mul_2exp(r, r, 32);
+	mpz_add_ui(r, r, (unsigned long)(u & 0xffffffffUL));
+	if (v < 0)
+		mpz_neg(r, r);
+#endif
+}
+
+
+static
+int64_t
+fx_mpz_get_i64(const mpz_t v)
+{
+#if LONG_MAX >= INT64_MAX
+	return (int64_t)mpz_get_si(v);
+#else
+	uint64_t u;
+	mpz_t t;
+
+	mpz_init(t);
+	mpz_abs(t, v);
+	u = mpz_get_ui(t);
+	mpz_tdiv_q_2exp(t, t, 32);
+	u |= (uint64_t)mpz_get_ui(t) << 32;
+	mpz_clear(t);
+
+	return (mpz_sgn(v) < 0) ? -(int64_t)u : (int64_t)u;
+#endif
+}
+
+
+static
+void
+fx_raw_z(mpz_t r, num_t a)
+{
+	if (X(a).wide)
+		mpz_set(r, X(a).z);
+	else
+		fx_mpz_set_i64(r, X(a).i);
+}
+
+
+static
+void
+fx_set_format(num_t r, int m, int n, int is_signed, fxovf_t ovf, fxrnd_t rnd)
+{
+	r->num_type = NUM_FIXED;
+
+	X(r).m = m;
+	X(r).n = n;
+	X(r).is_signed = is_signed;
+	X(r).ovf = ovf;
+	X(r).rnd = rnd;
+	X(r).wide = (m + n > FX_NARROW_BITS);
+	X(r).i = 0;
+
+	if (X(r).wide)
+		mpz_init(X(r).z);
+}
+
+
+static
+num_t
+fx_new_like(int flags, num_t fmt)
+{
+	num_t r;
+
+	r = num_new(flags);
+	fx_set_format(r, X(fmt).m, X(fmt).n, X(fmt).is_signed, X(fmt).ovf,
+	    X(fmt).rnd);
+
+	return r;
+}
+
+
+num_t
+num_new_fixed(int flags, num_t b)
+{
+	num_t r;
+
+	assert(b != NULL && b->num_type == NUM_FIXED);
+
+	r = fx_new_like(flags, b);
+	if (X(r).wide)
+		mpz_set(X(r).z, X(b).z);
+	else
+		X(r).i = X(b).i;
+
+	return r;
+}
+
+
+/*
+ * Exact dyadic value of any number: a = v * 2^e.
+ */
+static
+int
+fx_exact(mpz_t v, long *e, num_t a)
+{
+	switch (a->num_type) {
+	case NUM_INT:
+		mpz_set(v, Z(a));
+		*e = 0;
+		return 0;
+
+	case NUM_FP:
+		if (!mpfr_number_p(F(a))) {
+			yyxerror("Cannot represent NaN or infinity as fixed-point");
+			return -1;
+		}
+		if (mpfr_zero_p(F(a))) {
+			mpz_set_ui(v, 0);
+			*e = 0;
+		} else {
+			*e = (long)mpfr_get_z_2exp(v, F(a));
+		}
+		return 0;
+
+	case NUM_FIXED:
+		fx_raw_z(v, a);
+		*e = -(long)X(a).n;
+		return 0;
+
+	default:
+		yyxerror("invalid number in fixed-point operation");
+		return -1;
+	}
+}
+
+
+/*
+ * q = v / 2^k, rounded according to rnd.  q and v may alias.
+ */
+static
+void
+fx_round_shift_z(mpz_t q, const mpz_t v, unsigned long k, fxrnd_t rnd)
+{
+	mpz_t t;
+	int round_up;
+
+	if (k == 0) {
+		mpz_set(q, v);
+		return;
+	}
+
+	switch (rnd) {
+	case FX_ZERO:
+		mpz_tdiv_q_2exp(q, v, k);
+		break;
+
+	case FX_ROUND:
+	case FX_CONV:
+		mpz_init(t);
+		mpz_fdiv_r_2exp(t, v, k);
+		round_up = mpz_tstbit(t, k - 1);
+		mpz_fdiv_q_2exp(q, v, k);
+		/* exactly half way: bit k-1 is the only bit set in t */
+		if (round_up && rnd == FX_CONV &&
+		    mpz_scan1(t, 0) == k - 1 && mpz_even_p(q))
+			round_up = 0;
+		if (round_up)
+			mpz_add_ui(q, q, 1);
+		mpz_clear(t);
+		break;
+
+	case FX_TRUNC:
+	default:
+		mpz_fdiv_q_2exp(q, v, k);
+		break;
+	}
+}
+
+
+/*
+ * q = num / den, rounded according to rnd.  den must be positive.
+ */
+static
+void
+fx_round_div_z(mpz_t q, const mpz_t num, const mpz_t den, fxrnd_t rnd)
+{
+	mpz_t r;
+	int c;
+
+	switch (rnd) {
+	case FX_ZERO:
+		mpz_tdiv_q(q, num, den);
+		break;
+
+	case FX_ROUND:
+	case FX_CONV:
+		mpz_init(r);
+		mpz_fdiv_qr(q, r, num, den);
+		mpz_mul_2exp(r, r, 1);
+		c = mpz_cmp(r, den);
+		if (c > 0 || (c == 0 && (rnd == FX_ROUND || mpz_odd_p(q))))
+			mpz_add_ui(q, q, 1);
+		mpz_clear(r);
+		break;
+
+	case FX_TRUNC:
+	default:
+		mpz_fdiv_q(q, num, den);
+		break;
+	}
+}
+
+
+static
+void
+fx_overflow_z(mpz_t raw, const struct numfx *f)
+{
+	unsigned long w = (unsigned long)fx_width(f);
+	mpz_t lim;
+
+	mpz_init(lim);
+
+	if (f->ovf == FX_WRAP) {
+		mpz_fdiv_r_2exp(raw, raw, w);
+		if (f->is_signed && mpz_tstbit(raw, w - 1)) {
+			mpz_setbit(lim, w);
+			mpz_sub(raw, raw, lim);
+		}
+	} else {
+		/* upper limit: 2^(w-1) - 1 or 2^w - 1 */
+		mpz_setbit(lim, f->is_signed ? w - 1 : w);
+		mpz_sub_ui(lim, lim, 1);
+		if (mpz_cmp(raw, lim) > 0) {
+			mpz_set(raw, lim);
+		} else if (f->is_signed) {
+			/* lower limit: -2^(w-1) */
+			mpz_add_ui(lim, lim, 1);
+			mpz_neg(lim, lim);
+			if (mpz_cmp(raw, lim) < 0)
+				mpz_set(raw, lim);
+		} else if (mpz_sgn(raw) < 0) {
+			mpz_set_ui(raw, 0);
+		}
+	}
+
+	mpz_clear(lim);
+}
+
+
+static
+void
+fx_store_z(num_t r, const mpz_t raw)
+{
+	if (X(r).wide)
+		mpz_set(X(r).z, raw);
+	else
+		X(r).i = fx_mpz_get_i64(raw);
+}
+
+
+/*
+ * Round the exact value v * 2^e into r's format and store it.
+ * v is clobbered.
+ */
+static
+void
+fx_quantize(num_t r, mpz_t v, long e)
+{
+	long s = e + X(r).n;
+	long w = fx_width(&X(r));
+
+	if (s >= 0) {
+		/*
+		 * Shifting a non-zero value past the word always
+		 * overflows; 2^(w+1) with the right sign wraps to 0 and
+		 * saturates to the right limit without materializing
+		 * the shifted value.
+		 */
+		if (mpz_sgn(v) != 0 && s > w) {
+			int neg = (mpz_sgn(v) < 0);
+
+			mpz_set_ui(v, 0);
+			mpz_setbit(v, (unsigned long)w + 1);
+			if (neg)
+				mpz_neg(v, v);
+		} else {
+			mpz_mul_2exp(v, v, (unsigned long)s);
+		}
+	} else {
+		fx_round_shift_z(v, v, (unsigned long)-s, X(r).rnd);
+	}
+
+	fx_overflow_z(v, &X(r));
+	fx_store_z(r, v);
+}
+
+
+static
+int64_t
+fx_floor_shift_i(int64_t v, int k)
+{
+	/* floor(v / 2^k) without relying on >> of negative values */
+	if (v >= 0)
+		return v >> k;
+	return -(((-v) - 1) >> k) - 1;
+}
+
+
+static
+int64_t
+fx_round_shift_i(int64_t v, int k, fxrnd_t rnd)
+{
+	int64_t q, rem, half;
+
+	if (k <= 0)
+		return v * ((int64_t)1 << -k);
+
+	q = fx_floor_shift_i(v, k);
+	rem = v - q * ((int64_t)1 << k);
+	half = (int64_t)1 << (k - 1);
+
+	switch (rnd) {
+	case FX_ZERO:
+		if (rem != 0 && v < 0)
+			q++;
+		break;
+	case FX_ROUND:
+		if (rem >= half)
+			q++;
+		break;
+	case FX_CONV:
+		if (rem > half || (rem == half && (q & 1)))
+			q++;
+		break;
+	case FX_TRUNC:
+	default:
+		break;
+	}
+
+	return q;
+}
+
+
+static
+int64_t
+fx_overflow_i(int64_t v, const struct numfx *f)
+{
+	int w = fx_width(f);
+	int64_t lo, hi;
+	uint64_t u;
+
+	if (f->is_signed) {
+		hi = ((int64_t)1 << (w - 1)) - 1;
+		lo = -hi - 1;
+	} else {
+		hi = ((int64_t)1 << w) - 1;
+		lo = 0;
+	}
+
+	if (v >= lo && v <= hi)
+		return v;
+
+	if (f->ovf == FX_SAT)
+		return (v < lo) ? lo : hi;
+
+	u = (uint64_t)v & (((uint64_t)1 << w) - 1);
+	if (f->is_signed && (u >> (w - 1)))
+		return (int64_t)u - ((int64_t)1 << w);
+	return (int64_t)u;
+}
+
+
+/*
+ * Machine-integer path for +, - and * between two narrow operands.
+ * Returns 0 if the exact intermediate would not fit in 62 bits.
+ */
+static
+int
+fx_fast_two_op(optype_t op_type, num_t r, num_t a, num_t b)
+{
+	int wa = fx_width(&X(a)), wb = fx_width(&X(b));
+	int na = X(a).n, nb = X(b).n, nr = X(r).n;
+	int nmax, bits, k;
+	int64_t v;
+
+	if (X(a).wide || X(b).wide || X(r).wide)
+		return 0;
+
+	switch (op_type) {
+	case OP_ADD:
+	case OP_SUB:
+		nmax = (na > nb) ? na : nb;
+		bits = ((wa + nmax - na > wb + nmax - nb) ?
+		    wa + nmax - na : wb + nmax - nb) + 1;
+		k = nmax - nr;
+		if (bits + ((k < 0) ? -k : 0) > FX_NARROW_BITS)
+			return 0;
+		v = X(a).i * ((int64_t)1 << (nmax - na));
+		if (op_type == OP_ADD)
+			v += X(b).i * ((int64_t)1 << (nmax - nb));
+		else
+			v -= X(b).i * ((int64_t)1 << (nmax - nb));
+		break;
+
+	case OP_MUL:
+		bits = wa + wb;
+		k = na + nb - nr;
+		if (bits + ((k < 0) ? -k : 0) > FX_NARROW_BITS)
+			return 0;
+		v = X(a).i * X(b).i;
+		break;
+
+	default:
+		return 0;
+	}
+
+	X(r).i = fx_overflow_i(fx_round_shift_i(v, k, X(r).rnd), &X(r));
+	return 1;
+}
+
+
+static
+int
+fx_check_format(int m, int n, int is_signed)
+{
+	if (n < 0 || m < (is_signed ? 1 : 0)) {
+		yyxerror("Invalid fixed-point format Q%d.%d: need %s and n >= 0",
+		    m, n, is_signed ? "m >= 1 (m includes the sign bit)" :
+		    "m >= 0");
+		return -1;
+	}
+
+	if (m + n < 1 || m + n > FX_MAX_BITS) {
+		yyxerror("Invalid fixed-point format Q%d.%d: word length must be "
+		    "between 1 and %d bits", m, n, FX_MAX_BITS);
+		return -1;
+	}
+
+	return 0;
+}
+
+
+num_t
+num_fixed_from(int flags, num_t a, int m, int n, int is_signed)
+{
+	num_t r;
+	mpz_t v;
+	long e;
+
+	if (fx_check_format(m, n, is_signed) != 0)
+		return NULL;
+
+	mpz_init(v);
+	if (fx_exact(v, &e, a) != 0) {
+		mpz_clear(v);
+		return NULL;
+	}
+
+	r = num_new(flags);
+	fx_set_format(r, m, n, is_signed, fx_default_ovf, fx_default_rnd);
+	fx_quantize(r, v, e);
+	mpz_clear(v);
+
+	return r;
+}
+
+
+num_t
+num_fixed_two_op(optype_t op_type, num_t a, num_t b)
+{
+	num_t r, fmt;
+	mpz_t va, vb;
+	long ea, eb, e;
+	unsigned long k;
+
+	/* the result takes the format of the (left-most) fixed operand */
+	fmt = (a->num_type == NUM_FIXED) ? a : b;
+	r = fx_new_like(N_TEMP, fmt);
+
+	if (a->num_type == NUM_FIXED && b->num_type == NUM_FIXED &&
+	    fx_fast_two_op(op_type, r, a, b))
+		return r;
+
+	mpz_init(va);
+	mpz_init(vb);
+
+	if (fx_exact(va, &ea, a) != 0 || fx_exact(vb, &eb, b) != 0) {
+		r = NULL;
+		goto out;
+	}
+
+	switch (op_type) {
+	case OP_ADD:
+	case OP_SUB:
+	case OP_MOD:
+		/* align both operands to the smaller exponent */
+		if (ea > eb) {
+			mpz_mul_2exp(va, va, (unsigned long)(ea - eb));
+			e = eb;
+		} else {
+			mpz_mul_2exp(vb, vb, (unsigned long)(eb - ea));
+			e = ea;
+		}
+
+		if (op_type == OP_ADD) {
+			mpz_add(va, va, vb);
+		} else if (op_type == OP_SUB) {
+			mpz_sub(va, va, vb);
+		} else {
+			if (mpz_sgn(vb) == 0) {
+				yyxerror("Division by zero");
+				r = NULL;
+				goto out;
+			}
+			/* same sign convention as fmod */
+			mpz_tdiv_r(va, va, vb);
+		}
+		fx_quantize(r, va, e);
+		break;
+
+	case OP_MUL:
+		mpz_mul(va, va, vb);
+		fx_quantize(r, va, ea + eb);
+		break;
+
+	case OP_DIV:
+		if (mpz_sgn(vb) == 0) {
+			yyxerror("Division by zero");
+			r = NULL;
+			goto out;
+		}
+		/* raw = va * 2^(ea - eb + n) / vb */
+		e = ea - eb + X(r).n;
+		if (e >= 0)
+			mpz_mul_2exp(va, va, (unsigned long)e);
+		else
+			mpz_mul_2exp(vb, vb, (unsigned long)-e);
+		if (mpz_sgn(vb) < 0) {
+			mpz_neg(va, va);
+			mpz_neg(vb, vb);
+		}
+		fx_round_div_z(va, va, vb, X(r).rnd);
+		fx_overflow_z(va, &X(r));
+		fx_store_z(r, va);
+		break;
+
+	case OP_POW:
+		/* only exact non-negative integer powers */
+		if (eb < 0) {
+			if (mpz_sgn(vb) != 0 &&
+			    mpz_scan1(vb, 0) < (unsigned long)-eb) {
+				yyxerror("Exponent of a fixed-point power must be a "
+				    "non-negative integer");
+				r = NULL;
+				goto out;
+			}
+			mpz_tdiv_q_2exp(vb, vb, (unsigned long)-eb);
+		} else {
+			mpz_mul_2exp(vb, vb, (unsigned long)eb);
+		}
+		if (mpz_sgn(vb) < 0 || !mpz_fits_ulong_p(vb)) {
+			yyxerror("Exponent of a fixed-point power must be a "
+			    "non-negative integer that fits into an unsigned long");
+			r = NULL;
+			goto out;
+		}
+		k = mpz_get_ui(vb);
+		mpz_pow_ui(va, va, k);
+		fx_quantize(r, va, ea * (long)k);
+		break;
+
+	default:
+		yyxerror("Unknown op in num_fixed_two_op");
+		r = NULL;
+	}
+
+out:
+	mpz_clear(va);
+	mpz_clear(vb);
+
+	return r;
+}
+
+
+num_t
+num_fixed_neg(num_t a)
+{
+	num_t r;
+	mpz_t v;
+
+	r = fx_new_like(N_TEMP, a);
+
+	if (!X(a).wide) {
+		X(r).i = fx_overflow_i(-X(a).i, &X(r));
+		return r;
+	}
+
+	mpz_init(v);
+	mpz_neg(v, X(a).z);
+	fx_overflow_z(v, &X(r));
+	fx_store_z(r, v);
+	mpz_clear(v);
+
+	return r;
+}
+
+
+num_t
+num_fixed_raw(num_t a)
+{
+	num_t r;
+
+	r = num_new_z(N_TEMP, NULL);
+	fx_raw_z(Z(r), a);
+
+	return r;
+}
+
+
+int
+num_fixed_is_zero(num_t a)
+{
+	if (X(a).wide)
+		return mpz_sgn(X(a).z) == 0;
+	return X(a).i == 0;
+}
+
+
+/*
+ * Integer value of a fixed-point number, rounded like mpfr_get_z()
+ * would round it with the current rounding mode.
+ */
+void
+num_fixed_get_z(mpz_t r, num_t a)
+{
+	fx_raw_z(r, a);
+
+	switch (round_mode) {
+	case MPFR_RNDZ:
+		fx_round_shift_z(r, r, (unsigned long)X(a).n, FX_ZERO);
+		break;
+	case MPFR_RNDD:
+		fx_round_shift_z(r, r, (unsigned long)X(a).n, FX_TRUNC);
+		break;
+	case MPFR_RNDU:
+		mpz_neg(r, r);
+		fx_round_shift_z(r, r, (unsigned long)X(a).n, FX_TRUNC);
+		mpz_neg(r, r);
+		break;
+	default:
+		fx_round_shift_z(r, r, (unsigned long)X(a).n, FX_CONV);
+		break;
+	}
+}
+
+
+int
+num_fixed_set_fr(mpfr_t r, num_t a, mpfr_rnd_t rnd)
+{
+	mpz_t v;
+	int t;
+
+	mpz_init(v);
+	fx_raw_z(v, a);
+	t = mpfr_set_z_2exp(r, v, -(mpfr_exp_t)X(a).n, rnd);
+	mpz_clear(v);
+
+	return t;
+}
+
+
+static
+char *
+fx_pad(char *s, size_t digits)
+{
+	size_t len = strlen(s);
+	char *p;
+
+	if (len >= digits)
+		return s;
+
+	if ((p = malloc(digits + 1)) == NULL) {
+		yyxerror("ENOMEM");
+		exit(1);
+	}
+
+	memset(p, '0', digits - len);
+	memcpy(p + digits - len, s, len + 1);
+	free(s);
+
+	return p;
+}
+
+
+/*
+ * Decimal output is exact: raw / 2^n == raw * 5^n / 10^n.  Binary,
+ * octal and hexadecimal output show the raw two's complement word.
+ */
+char *
+num_fixed_str(num_t a, int base)
+{
+	int w = fx_width(&X(a)), n = X(a).n;
+	size_t len, ipart, flen, bits_per_digit;
+	char *digits, *s;
+	int neg;
+	mpz_t v;
+
+	mpz_init(v);
+	fx_raw_z(v, a);
+
+	if (base != 10) {
+		bits_per_digit = (base == 2) ? 1 : (base == 8) ? 3 : 4;
+		mpz_fdiv_r_2exp(v, v, (unsigned long)w);
+		if ((digits = mpz_get_str(NULL, base, v)) == NULL) {
+			yyxerror("ENOMEM");
+			exit(1);
+		}
+		mpz_clear(v);
+		return fx_pad(digits, (w + bits_per_digit - 1) / bits_per_digit);
+	}
+
+	neg = (mpz_sgn(v) < 0);
+	mpz_abs(v, v);
+	if (n > 0) {
+		mpz_t p5;
+
+		mpz_init(p5);
+		mpz_ui_pow_ui(p5, 5, (unsigned long)n);
+		mpz_mul(v, v, p5);
+		mpz_clear(p5);
+	}
+
+	if ((digits = mpz_get_str(NULL, 10, v)) == NULL) {
+		yyxerror("ENOMEM");
+		exit(1);
+	}
+	mpz_clear(v);
+
+	digits = fx_pad(digits, (size_t)n + 1);
+	len = strlen(digits);
+	ipart = len - (size_t)n;
+
+	/* drop trailing zeros of the fraction */
+	flen = (size_t)n;
+	while (flen > 0 && digits[ipart + flen - 1] == '0')
+		--flen;
+
+	if ((s = malloc(len + 3)) == NULL) {
+		yyxerror("ENOMEM");
+		exit(1);
+	}
+
+	snprintf(s, len + 3, "%s%.*s%s%.*s", neg ? "-" : "", (int)ipart, digits,
+	    flen ? "." : "", (int)flen, digits + ipart);
+	free(digits);
+
+	return s;
+}
+
+
+int
+fixed_mode_switch(const char *mode)
+{
+	if (strcmp(mode, "sat") == 0)
+		fx_default_ovf = FX_SAT;
+	else if (strcmp(mode, "wrap") == 0)
+		fx_default_ovf = FX_WRAP;
+	else if (strcmp(mode, "trunc") == 0)
+		fx_default_rnd = FX_TRUNC;
+	else if (strcmp(mode, "zero") == 0)
+		fx_default_rnd = FX_ZERO;
+	else if (strcmp(mode, "round") == 0)
+		fx_default_rnd = FX_ROUND;
+	else if (strcmp(mode, "conv") == 0)
+		fx_default_rnd = FX_CONV;
+	else {
+		yyxerror("Unknown fixed-point mode '%s' (expected sat, wrap, "
+		    "trunc, zero, round or conv)", mode);
+		return -1;
+	}
+
+	fold_invalidate();
+	return 0;
+}
@@ -0,0 +1,257 @@
+/*
+ * Copyright (c) 2026 Alex Hornung <alex@alexhornung.com>.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in
+ *    the documentation and/or other materials provided with the
+ *    distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE
+ * COPYRIGHT HOLDERS OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ * BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED
+ * AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT
+ * OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <assert.h>
+
+#include <gmp.h>
+#include <mpfr.h>
+
+#include "hashtable.h"
+
+#include "optype.h"
+#include "num.h"
+#include "var.h"
+#include "ast.h"
+#include "calc.h"
+#include "fold.h"
+#include "memo.h"
+#include "fmemo.h"
+
+/*
+ * Result caches of memo functions.  A function declared with
+ * memo function f(x) = ... endfunction gets one of its own, keyed by the
+ * exact values of its arguments, and kept on an LRU list of at most
+ * FMEMO_MAX entries.  Results may depend on the modes and on the
+ * constants folded into the function too, so the entries are dropped
+ * whenever fold_gen changes.
+ */
+#define FMEMO_MAX	65536
+#define FMEMO_SIZE	8191
+
+struct fmemo_ent
+{
+	struct memo_ent e;
+	num_t v;		/* NULL until the result is known */
+	int nargs;
+	num_t args[];
+};
+
+struct fmemo
+{
+	struct memo c;
+	unsigned long gen;		/* fold_gen of the entries */
+};
+
+/* what a call to a memo function is looked up by */
+struct fmemo_call
+{
+	int nargs;
+	num_t *args;
+};
+
+
+static
+void
+fmemo_release(struct memo_ent *e)
+{
+	struct fmemo_ent *ent = (struct fmemo_ent *)e;
+	int i;
+
+	for (i = 0; i < ent->nargs; i++)
+		num_delete(ent->args[i]);
+	if (ent->v != NULL)
+		num_delete(ent->v);
+	free(ent);
+}
+
+
+struct fmemo *
+fmemo_new(void)
+{
+	struct fmemo *m;
+
+	if ((m = malloc(sizeof(*m))) == NULL) {
+		yyxerror("ENOMEM");
+		exit(1);
+	}
+
+	memo_init(&m->c, FMEMO_SIZE, FMEMO_MAX, fmemo_release);
+	m->gen = fold_gen;
+
+	return m;
+}
+
+
+void
+fmemo_delete(struct fmemo *m)
+{
+	memo_destroy(&m->c);
+	free(m);
+}
+
+
+/* Drops entries computed under other modes or folded globals. */
+static
+void
+fmemo_check(struct fmemo *m)
+{
+	if (m->gen == fold_gen)
+		return;
+
+	memo_clear(&m->c);
+	m->gen = fold_gen;
+}
+
+
+static
+int
+fmemo_same(struct memo_ent *e, void *arg)
+{
+	struct fmemo_ent *ent = (struct fmemo_ent *)e;
+	struct fmemo_call *call = arg;
+	int i;
+
+	if (ent->nargs != call->nargs)
+		return 0;
+
+	for (i = 0; i < ent->nargs; i++)
+		if (!memo_same_num(ent->args[i], call->args[i]))
+			return 0;
+
+	return 1;
+}
+
+
+/* Copies a exactly, down to the precision of a floating point value. */
+static
+num_t
+fmemo_copy(num_t a)
+{
+	num_t c;
+
+	c = num_new_z_or_fp(0, a);
+	if (a->num_type == NUM_FP &&
+	    mpfr_get_prec(F(c)) != mpfr_get_prec(F(a))) {
+		mpfr_set_prec(F(c), mpfr_get_prec(F(a)));
+		mpfr_set(F(c), F(a), MPFR_RNDN);
+	}
+
+	return c;
+}
+
+
+/*
+ * Returns the result cached for a call with the given arguments.  On a
+ * miss, returns NULL and sets *miss to a new entry for the call, which
+ * must be passed to fmemo_put() with the result.
+ */
+num_t
+fmemo_get(struct fmemo *m, int nargs, num_t *args, struct fmemo_ent **miss)
+{
+	struct fmemo_call call;
+	struct fmemo_ent *ent;
+	unsigned long h;
+	int i;
+
+	fmemo_check(m);
+
+	h = (unsigned long)nargs;
+	for (i = 0; i < nargs; i++)
+		h = memo_hash_num(h, args[i]);
+
+	call.nargs = nargs;
+	call.args = args;
+	if ((ent = (struct fmemo_ent *)memo_find(&m->c, h, fmemo_same,
+	    &call)) != NULL) {
+		memo_hit(&m->c, &ent->e);
+		/* the entry may be evicted while the result is still in use */
+		return num_new_z_or_fp(N_TEMP, ent->v);
+	}
+
+	++m->c.misses;
+	if ((ent = malloc(sizeof(*ent) + nargs * sizeof(num_t))) == NULL) {
+		yyxerror("ENOMEM");
+		exit(1);
+	}
+	ent->e.hash = h;
+	ent->v = NULL;
+	ent->nargs = nargs;
+	for (i = 0; i < nargs; i++)
+		ent->args[i] = fmemo_copy(args[i]);
+
+	*miss = ent;
+	return NULL;
+}
+
+
+/*
+ * Caches r, if it is not NULL, as the result of the call that ent was
+ * returned for by fmemo_get().  ent is consumed either way.
+ */
+void
+fmemo_put(struct fmemo *m, struct fmemo_ent *ent, num_t r)
+{
+	struct fmemo_call call;
+	struct fmemo_ent *old;
+
+	if (r == NULL) {
+		fmemo_release(&ent->e);
+		return;
+	}
+
+	fmemo_check(m);
+
+	call.nargs = ent->nargs;
+	call.args = ent->args;
+	if ((old = (struct fmemo_ent *)memo_find(&m->c, ent->e.hash,
+	    fmemo_same, &call)) != NULL) {
+		/* a recursive call got there first */
+		num_delete(old->v);
+		old->v = num_new_z_or_fp(0, r);
+		fmemo_release(&ent->e);
+		return;
+	}
+
+	ent->v = num_new_z_or_fp(0, r);
+	memo_add(&m->c, &ent->e, ent->e.hash);
+}
+
+
+void
+fmemo_stats(struct fmemo *m, const char *name)
+{
+	fmemo_check(m);
+
+	printf("Memo function '%s': %u/%u entries, %lu hits, %lu misses\n",
+	    name, m->c.count, m->c.max, m->c.hits, m->c.misses);
+}
@@ -0,0 +1,359 @@
+/*
+ * Copyright (c) 2026 Alex Hornung <alex@alexhornung.com>.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in
+ *    the documentation and/or other materials provided with the
+ *    distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE
+ * COPYRIGHT HOLDERS OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ * BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED
+ * AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT
+ * OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+
+/*
+ * Constant folding, for both the bytecode compiler and the tree walker.
+ * Constant subtrees are evaluated once and replaced by OP_NUM nodes, if
+ * conditions that are constant select their branch, and constant
+ * statements whose value is thrown away by a listing are dropped.
+ *
+ * Besides literals, only the predefined constants pi, e and G are
+ * folded, and only for as long as nobody assigns to them.  The results
+ * depend on the modes arithmetic is done in too, so anything that
+ * changes either calls fold_invalidate(), and trees folded under an
+ * older fold_gen are folded again before they run.
+ */
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <assert.h>
+
+#include <gmp.h>
+#include <mpfr.h>
+
+#include "hashtable.h"
+
+#include "optype.h"
+#include "num.h"
+#include "var.h"
+#include "ast.h"
+#include "calc.h"
+#include "func.h"
+#include "safe_mem.h"
+#include "fold.h"
+
+#define IS_CONST(a)	((a) != NULL && (a)->op_type == OP_NUM)
+#define CONST(a)	(((astnum_t)(a))->num)
+
+unsigned long fold_gen = 1;
+
+
+void
+fold_invalidate(void)
+{
+	++fold_gen;
+}
+
+
+/*
+ * Replaces a by the value n computed from its constant operands, unless
+ * computing it failed.  Fixed-point values are not folded, as they have
+ * no place in the constant pool.
+ */
+static
+ast_t
+fold_result(ast_t a, num_t n, int nerr)
+{
+	ast_t r;
+
+	errors_muted = 0;
+
+	if (n == NULL || nerrors != nerr || n->num_type == NUM_FIXED)
+		return a;
+
+	/* n may be one of a's own constants, so it is pooled first */
+	r = ast_newnumval(n);
+	ast_delete(a);
+
+	return r;
+}
+
+
+static
+int
+fold_begin(void)
+{
+	errors_muted = 1;
+	return nerrors;
+}
+
+
+static ast_t fold(ast_t a, hashtable_t locals);
+
+
+static
+ast_t
+fold_call(astcall_t ac, hashtable_t locals)
+{
+	func_t fn;
+	explist_t p;
+	num_t *args, n;
+	int nargs, nconst, nerr, i;
+
+	/* a function name is not a value, and must be left as written */
+	fn = funlookup(ac->name, 0);
+	if (fn != NULL && (fn->flags & FUNC_FN_ARG)) {
+		for (p = (ac->l != NULL) ? ac->l->next : NULL; p != NULL;
+		    p = p->next)
+			p->ast = fold(p->ast, locals);
+		return (ast_t)ac;
+	}
+
+	nargs = nconst = 0;
+	for (p = ac->l; p != NULL; p = p->next) {
+		p->ast = fold(p->ast, locals);
+		++nargs;
+		if (IS_CONST(p->ast))
+			++nconst;
+	}
+
+	/* user functions may be redefined, and so are never folded */
+	if (fn == NULL || !fn->builtin || (fn->flags & FUNC_IMPURE) ||
+	    nconst != nargs || nargs < fn->minargs || nargs > fn->maxargs)
+		return (ast_t)ac;
+
+	if ((args = alloc_safe_mem(BUCKET_MANUAL,
+		    sizeof(num_t) * (nargs + 1))) == NULL) {
+		yyxerror("ENOMEM");
+		exit(1);
+	}
+
+	for (p = ac->l, i = 0; p != NULL; p = p->next, i++)
+		args[i] = CONST(p->ast);
+
+	nerr = fold_begin();
+	n = fn->fn(fn->priv, ac->name, nargs, args);
+	free_safe_mem(BUCKET_MANUAL, args);
+
+	return fold_result((ast_t)ac, n, nerr);
+}
+
+
+static
+ast_t
+fold_flow(astflow_t af, hashtable_t locals)
+{
+	ast_t r;
+
+	af->cond = fold(af->cond, locals);
+
+	if (af->flow_type == FLOW_IF && IS_CONST(af->cond)) {
+		if (!num_is_zero(CONST(af->cond))) {
+			r = af->t;
+			af->t = NULL;
+		} else {
+			r = af->f;
+			af->f = NULL;
+		}
+		ast_delete((ast_t)af);
+
+		if (r == NULL)
+			return ast_newnumval(num_new_const_zero(N_TEMP));
+
+		return fold(r, locals);
+	}
+
+	if (af->flow_type == FLOW_WHILE && IS_CONST(af->cond) &&
+	    num_is_zero(CONST(af->cond))) {
+		ast_delete((ast_t)af);
+		return ast_newnumval(num_new_const_zero(N_TEMP));
+	}
+
+	if (af->t != NULL)
+		af->t = fold(af->t, locals);
+	if (af->f != NULL)
+		af->f = fold(af->f, locals);
+
+	return (ast_t)af;
+}
+
+
+static
+ast_t
+fold(ast_t a, hashtable_t locals)
+{
+	astcmp_t acmp;
+	astpsel_t ap;
+	astpselassign_t apa;
+	var_t var;
+	ast_t r;
+	num_t lo;
+	int nerr;
+
+	switch (a->op_type) {
+	case OP_NUM:
+		break;
+
+	case OP_VARREF:
+		if (hashtable_lookup(locals, ((astref_t)a)->name, 0) != NULL)
+			break;
+		var = varlookup(((astref_t)a)->name, 0);
+		if (var == NULL || !var->constant || var->v == NULL)
+			break;
+
+		r = ast_newnumval(var->v);
+		ast_delete(a);
+		return r;
+
+	case OP_VARASSIGN:
+		((astassign_t)a)->v = fold(((astassign_t)a)->v, locals);
+		break;
+
+	case OP_PSELASSIGN:
+		apa = (astpselassign_t)a;
+		apa->hi = fold(apa->hi, locals);
+		if (apa->lo != NULL)
+			apa->lo = fold(apa->lo, locals);
+		apa->v = fold(apa->v, locals);
+		break;
+
+	case OP_LISTING:
+		a->l = fold(a->l, locals);
+		a->r = fold(a->r, locals);
+
+		/* a constant computes nothing the listing keeps */
+		if (IS_CONST(a->l)) {
+			r = a->r;
+			a->r = NULL;
+			ast_delete(a);
+			return r;
+		}
+		break;
+
+	case OP_FLOW:
+		return fold_flow((astflow_t)a, locals);
+
+	case OP_CALL:
+		return fold_call((astcall_t)a, locals);
+
+	case OP_CMP:
+		acmp = (astcmp_t)a;
+		acmp->l = fold(acmp->l, locals);
+		acmp->r = fold(acmp->r, locals);
+		if (IS_CONST(acmp->l) && IS_CONST(acmp->r)) {
+			nerr = fold_begin();
+			return fold_result(a, num_cmp(acmp->cmp_type,
+			    CONST(acmp->l), CONST(acmp->r)), nerr);
+		}
+		break;
+
+	case OP_PSEL:
+		ap = (astpsel_t)a;
+		ap->l = fold(ap->l, locals);
+		ap->hi = fold(ap->hi, locals);
+		if (ap->lo != NULL)
+			ap->lo = fold(ap->lo, locals);
+		if (IS_CONST(ap->l) && IS_CONST(ap->hi) &&
+		    (ap->lo == NULL || IS_CONST(ap->lo))) {
+			lo = (ap->lo != NULL) ? CONST(ap->lo) : NULL;
+			nerr = fold_begin();
+			return fold_result(a, num_int_part_sel(ap->psel_type,
+			    CONST(ap->hi), lo, CONST(ap->l)), nerr);
+		}
+		break;
+
+	case OP_ADD:
+	case OP_SUB:
+	case OP_MUL:
+	case OP_DIV:
+	case OP_MOD:
+	case OP_POW:
+		a->l = fold(a->l, locals);
+		a->r = fold(a->r, locals);
+		if (IS_CONST(a->l) && IS_CONST(a->r)) {
+			nerr = fold_begin();
+			return fold_result(a, num_float_two_op(a->op_type,
+			    CONST(a->l), CONST(a->r)), nerr);
+		}
+		break;
+
+	case OP_AND:
+	case OP_OR:
+	case OP_XOR:
+	case OP_SHR:
+	case OP_SHL:
+		a->l = fold(a->l, locals);
+		a->r = fold(a->r, locals);
+		if (IS_CONST(a->l) && IS_CONST(a->r)) {
+			nerr = fold_begin();
+			return fold_result(a, num_int_two_op(a->op_type,
+			    CONST(a->l), CONST(a->r)), nerr);
+		}
+		break;
+
+	case OP_UMINUS:
+		a->l = fold(a->l, locals);
+		if (IS_CONST(a->l)) {
+			nerr = fold_begin();
+			return fold_result(a, num_float_one_op(a->op_type,
+			    CONST(a->l)), nerr);
+		}
+		break;
+
+	case OP_UINV:
+	case OP_FAC:
+		a->l = fold(a->l, locals);
+		if (IS_CONST(a->l)) {
+			nerr = fold_begin();
+			return fold_result(a, num_int_one_op(a->op_type,
+			    CONST(a->l)), nerr);
+		}
+		break;
+
+	default:
+		break;
+	}
+
+	return a;
+}
+
+
+/*
+ * Folds a, which is consumed, returning the folded tree.  The names in
+ * params are the arguments of the function a is the body of.
+ */
+ast_t
+ast_fold(ast_t a, namelist_t params)
+{
+	hashtable_t locals;
+	namelist_t p;
+
+	locals = hashtable_new(61, NULL, NULL);
+	for (p = params; p != NULL; p = p->next)
+		hashtable_lookup(locals, p->name, 1);
+	ast_assigned(a, locals);
+
+	a = fold(a, locals);
+
+	hashtable_destroy(locals);
+
+	return a;
+}
@@ -29,10 +29,12 @@
 
 #include <stdarg.h>
 #include <stdio.h>
+#include <stdint.h>
 #include <stdlib.h>
 #include <string.h>
 #include <unistd.h>
 #include <assert.h>
+#include <sys/resource.h>
 
 #include <gmp.h>
 #include <mpfr.h>
@@ -45,23 +47,187 @@
 #include "ast.h"
 #include "calc.h"
 #include "safe_mem.h"
+#include "fixed.h"
+#include "ival.h"
+#include "dual.h"
+#include "modn.h"
+#include "rand.h"
+#include "vm.h"
+#include "fold.h"
+#include "bigz.h"
+#include "prime.h"
+#include "bitops.h"
+#include "memo.h"
+#include "fmemo.h"
 #include "func.h"
 
 static hashtable_t funtbl;
 
+/* bumped whenever a function is defined, see fun_resolve() */
+unsigned long fun_gen = 1;
+
+
+/*
+ * Memo cache for the results of the mpfr builtins, which are pure
+ * functions of their arguments, the result precision and the rounding
+ * mode. Entries keep copies of the arguments and are found by a hash of
+ * all of these, see memo.c.
+ */
+#define MEMO_MAX	1024
+#define MEMO_SIZE	2053
+
+struct memo_fr_ent
+{
+	struct memo_ent e;
+	void *fn;
+	mpfr_rnd_t rnd;
+	mpfr_prec_t prec;
+	int nargs;
+	mpfr_t a, b;
+	mpfr_t v;
+};
+
+/* what a call to an mpfr builtin is looked up by */
+struct memo_fr_call
+{
+	void *fn;
+	mpfr_prec_t prec;
+	mpfr_ptr a, b;
+};
+
+static struct memo memo_fr;
+
+
+static
+void
+memo_fr_release(struct memo_ent *e)
+{
+	struct memo_fr_ent *ent = (struct memo_fr_ent *)e;
+
+	mpfr_clear(ent->a);
+	if (ent->nargs == 2)
+		mpfr_clear(ent->b);
+	mpfr_clear(ent->v);
+	free(ent);
+}
+
+
+static
+int
+memo_fr_same(struct memo_ent *e, void *arg)
+{
+	struct memo_fr_ent *ent = (struct memo_fr_ent *)e;
+	struct memo_fr_call *call = arg;
+
+	return ent->fn == call->fn && ent->rnd == round_mode &&
+	    ent->prec == call->prec &&
+	    ent->nargs == ((call->b == NULL) ? 1 : 2) &&
+	    memo_same_fr(ent->a, call->a) &&
+	    (call->b == NULL || memo_same_fr(ent->b, call->b));
+}
+
+
+/*
+ * Looks up the result of fn applied to a (and b, if not NULL), copying
+ * it into r on a hit. On a miss, returns the new, still empty entry for
+ * the caller to fill in with memo_fill once the result is known.
+ */
+static
+struct memo_fr_ent *
+memo_lookup(void *fn, mpfr_t a, mpfr_t b, mpfr_t r)
+{
+	struct memo_fr_call call;
+	struct memo_fr_ent *ent;
+	unsigned long h;
+
+	call.fn = fn;
+	call.prec = mpfr_get_prec(r);
+	call.a = a;
+	call.b = b;
+
+	h = (unsigned long)(uintptr_t)fn;
+	h = h * 31 + (unsigned long)round_mode;
+	h = h * 31 + (unsigned long)call.prec;
+	h = memo_hash_fr(h, a);
+	if (b != NULL)
+		h = memo_hash_fr(h, b);
+
+	if ((ent = (struct memo_fr_ent *)memo_find(&memo_fr, h, memo_fr_same,
+	    &call)) != NULL) {
+		memo_hit(&memo_fr, &ent->e);
+		mpfr_set(r, ent->v, round_mode);
+		return NULL;
+	}
+
+	++memo_fr.misses;
+	if ((ent = malloc(sizeof(*ent))) == NULL) {
+		yyxerror("ENOMEM");
+		exit(1);
+	}
+	ent->fn = fn;
+	ent->rnd = round_mode;
+	ent->prec = call.prec;
+	ent->nargs = (b == NULL) ? 1 : 2;
+	mpfr_init2(ent->a, mpfr_get_prec(a));
+	mpfr_set(ent->a, a, MPFR_RNDN);
+	if (b != NULL) {
+		mpfr_init2(ent->b, mpfr_get_prec(b));
+		mpfr_set(ent->b, b, MPFR_RNDN);
+	}
+	mpfr_init2(ent->v, call.prec);
+	memo_add(&memo_fr, &ent->e, h);
+
+	return ent;
+}
+
+
+static
+void
+memo_fill(struct memo_fr_ent *ent, mpfr_t r)
+{
+	mpfr_set(ent->v, r, round_mode);
+}
+
+
+static
+void
+memo_stats_fn(void *priv, const char *name)
+{
+	func_t fn;
+
+	if ((fn = funlookup(name, 0)) != NULL && fn->memo != NULL)
+		fmemo_stats(fn->memo, name);
+}
+
+
+void
+memo_stats(void)
+{
+	printf("Memo cache: %u/%u entries, %lu hits, %lu misses\n",
+	    memo_fr.count, memo_fr.max, memo_fr.hits, memo_fr.misses);
+	fun_iterate(NULL, memo_stats_fn);
+}
+
 
 static
 num_t
 builtin_mpfr_fun_one_arg(void *priv, const char *s, int nargs, num_t * argv)
 {
 	mpfr_fun_one_arg_t fn = priv;
+	struct memo_fr_ent *ent;
 	num_t r;
 	num_t a;
 
+	if (ival_mode || argv[0]->num_type == NUM_IVAL)
+		return num_ival_fun(s, priv, argv[0]);
+
 	r = num_new_fp(N_TEMP, NULL);
 	a = num_new_fp(N_TEMP, argv[0]);
 
-	fn(F(r), F(a), round_mode);
+	if ((ent = memo_lookup(priv, F(a), NULL, F(r))) != NULL) {
+		fn(F(r), F(a), round_mode);
+		memo_fill(ent, F(r));
+	}
 
 	return r;
 }
@@ -75,6 +241,9 @@ builtin_mpfr_fun_one_arg_nornd(void *priv, const char *s, int nargs, num_t * arg
 	num_t r;
 	num_t a;
 
+	if (ival_mode || argv[0]->num_type == NUM_IVAL)
+		return num_ival_fun_nornd(priv, argv[0]);
+
 	r = num_new_fp(N_TEMP, NULL);
 	a = num_new_fp(N_TEMP, argv[0]);
 
@@ -89,14 +258,22 @@ num_t
 builtin_mpfr_fun_two_arg(void *priv, const char *s, int nargs, num_t * argv)
 {
 	mpfr_fun_two_arg_t fn = priv;
+	struct memo_fr_ent *ent;
 	num_t r;
 	num_t a, b;
 
+	if (ival_mode || argv[0]->num_type == NUM_IVAL ||
+	    argv[1]->num_type == NUM_IVAL)
+		return num_ival_fun2(s, priv, argv[0], argv[1]);
+
 	r = num_new_fp(N_TEMP, NULL);
 	a = num_new_fp(N_TEMP, argv[0]);
 	b = num_new_fp(N_TEMP, argv[1]);
 
-	fn(F(r), F(a), F(b), round_mode);
+	if ((ent = memo_lookup(priv, F(a), F(b), F(r))) != NULL) {
+		fn(F(r), F(a), F(b), round_mode);
+		memo_fill(ent, F(r));
+	}
 
 	return r;
 }
@@ -116,10 +293,15 @@ builtin_mpfr_fun_two_arg_ul(void *priv, const char *s, int nargs, num_t * argv)
 
 	if (!mpfr_fits_ulong_p(F(b), round_mode)) {
 		yyxerror
-		    ("Second argument to '%s' needs to fit into an unsigned long C datatype");
+		    ("Second argument to '%s' needs to fit into an unsigned long C datatype",
+		    s);
 		return NULL;
 	}
 
+	if (ival_mode || argv[0]->num_type == NUM_IVAL)
+		return num_ival_fun_ui(priv, argv[0],
+		    mpfr_get_ui(F(b), round_mode));
+
 	fn(F(r), F(a), mpfr_get_ui(F(b), round_mode), round_mode);
 
 	return r;
@@ -156,7 +338,8 @@ builtin_mpz_fun_one_arg_ul(void *priv, const char *s, int nargs, num_t * argv)
 
 	if (!mpz_fits_ulong_p(Z(a))) {
 		yyxerror
-		    ("Argument to '%s' needs to fit into an unsigned long C datatype");
+		    ("Argument to '%s' needs to fit into an unsigned long C datatype",
+		    s);
 		return NULL;
 	}
 
@@ -168,39 +351,37 @@ builtin_mpz_fun_one_arg_ul(void *priv, const char *s, int nargs, num_t * argv)
 
 static
 num_t
-builtin_mpz_fun_one_arg_bitcnt(void *priv, const char *s, int nargs, num_t * argv)
+builtin_mpz_fun_two_arg(void *priv, const char *s, int nargs, num_t * argv)
 {
-	mpz_fun_one_arg_bitcnt_t fn = priv;
-	mp_bitcnt_t bitcnt;
+	mpz_fun_two_arg_t fn = priv;
 	num_t r;
-	num_t a;
+	num_t a, b;
 
 	r = num_new_z(N_TEMP, NULL);
 	a = num_new_z(N_TEMP, argv[0]);
+	b = num_new_z(N_TEMP, argv[1]);
 
-	bitcnt = fn(Z(a));
-
-	mpz_init_set_ui(Z(r), (unsigned long)bitcnt);
+	fn(Z(r), Z(a), Z(b));
 
 	return r;
 }
 
 
+/* inv(a) inverts modulo the modulus of a modulus context */
 static
 num_t
-builtin_mpz_fun_two_arg(void *priv, const char *s, int nargs, num_t * argv)
+builtin_inv(void *priv, const char *s, int nargs, num_t * argv)
 {
-	mpz_fun_two_arg_t fn = priv;
-	num_t r;
-	num_t a, b;
+	if (nargs == 2)
+		return builtin_mpz_fun_two_arg(priv, s, nargs, argv);
 
-	r = num_new_z(N_TEMP, NULL);
-	a = num_new_z(N_TEMP, argv[0]);
-	b = num_new_z(N_TEMP, argv[1]);
-
-	fn(Z(r), Z(a), Z(b));
+	if (!modn_active) {
+		yyxerror("Function '%s' takes a modulus as second argument "
+		    "outside a modulus context", s);
+		return NULL;
+	}
 
-	return r;
+	return num_modn_inv(argv[0]);
 }
 
 
@@ -218,7 +399,8 @@ builtin_mpz_fun_two_arg_ul(void *priv, const char *s, int nargs, num_t * argv)
 
 	if (!mpz_fits_ulong_p(Z(b))) {
 		yyxerror
-		    ("Second argument to '%s' needs to fit into an unsigned long C datatype");
+		    ("Second argument to '%s' needs to fit into an unsigned long C datatype",
+		    s);
 		return NULL;
 	}
 
@@ -228,95 +410,717 @@ builtin_mpz_fun_two_arg_ul(void *priv, const char *s, int nargs, num_t * argv)
 }
 
 
+/*
+ * Checks that s names a function which accepts nargs arguments.
+ */
+int
+fun_check_args(func_t fn, const char *s, int nargs)
+{
+	if (fn == NULL) {
+		yyxerror("Unknown function '%s'", s);
+		return -1;
+	}
+
+	if (nargs < fn->minargs || nargs > fn->maxargs) {
+		if (fn->minargs == fn->maxargs)
+			yyxerror("Function '%s' takes exactly %d arguments", s,
+			    fn->minargs);
+		else
+			yyxerror
+			    ("Function '%s' takes a minimum of %d and a maximum of %d arguments",
+			    s, fn->minargs, fn->maxargs);
+
+		return -1;
+	}
+
+	return 0;
+}
+
+
+/*
+ * Looks up the result of a call to fn in its memo cache.  On a miss,
+ * *key is set to the entry to pass to fun_memo_put() with the result;
+ * it is NULL if fn is not a memo function.
+ */
+num_t
+fun_memo_get(func_t fn, int nargs, num_t *args, struct fmemo_ent **key)
+{
+	*key = NULL;
+	if (fn->memo == NULL)
+		return NULL;
+
+	return fmemo_get(fn->memo, nargs, args, key);
+}
+
+
+/* Stores r, which may be NULL if the call failed, under key. */
+void
+fun_memo_put(func_t fn, struct fmemo_ent *key, num_t r)
+{
+	if (key != NULL)
+		fmemo_put(fn->memo, key, r);
+}
+
+
+/*
+ * Calls evaluated by the tree walker recurse in C, so on top of the depth
+ * limit they are stopped while a quarter of the C stack is still left for
+ * the builtins, which may need some of it themselves.  The stack is
+ * measured from the outermost call.
+ */
+#define FUN_STACK_DEFAULT	(8UL * 1024 * 1024)
+
+static unsigned long fun_depth;
+static const char *fun_stack_top;
+static size_t fun_stack_room;
+
+
 static
+int
+fun_too_deep(void)
+{
+	struct rlimit rl;
+	char here;
+	size_t used;
+
+	if (fun_depth == 0) {
+		fun_stack_top = &here;
+		if (getrlimit(RLIMIT_STACK, &rl) != 0 ||
+		    rl.rlim_cur == RLIM_INFINITY)
+			fun_stack_room = FUN_STACK_DEFAULT;
+		else
+			fun_stack_room = rl.rlim_cur;
+		fun_stack_room -= fun_stack_room / 4;
+	}
+
+	used = (fun_stack_top > &here) ? (size_t)(fun_stack_top - &here) :
+	    (size_t)(&here - fun_stack_top);
+
+	if (fun_depth < vm_max_depth && used < fun_stack_room)
+		return 0;
+
+	yyxerror("Function calls nested more than %lu deep", fun_depth);
+	return 1;
+}
+
+
+/*
+ * Enters a call that recurses in C, returning -1 instead if it would
+ * nest too deep.  fun_leave() must follow it.
+ */
+int
+fun_enter(void)
+{
+	if (fun_too_deep())
+		return -1;
+
+	++fun_depth;
+	return 0;
+}
+
+
+void
+fun_leave(void)
+{
+	--fun_depth;
+}
+
+
+/*
+ * Applies a builtin or user function to already evaluated arguments.
+ */
 num_t
-builtin_mpz_fun_two_arg_bitcnt(void *priv, const char *s, int nargs, num_t * argv)
+fun_apply(func_t fn, const char *s, int nargs, num_t *args)
 {
-	mpz_fun_two_arg_bitcnt_t fn = priv;
-	mp_bitcnt_t bitcnt;
+	struct fmemo_ent *key;
+	hashtable_t argtbl;
+	namelist_t pn;
+	var_t v;
 	num_t r;
-	num_t a, b;
+	int i;
 
-	r = num_new_z(N_TEMP, NULL);
-	a = num_new_z(N_TEMP, argv[0]);
-	b = num_new_z(N_TEMP, argv[1]);
+	/* as in the VM, a call with an argument that has no value has none */
+	for (i = 0; i < nargs; i++)
+		if (args[i] == NULL)
+			return NULL;
+
+	if (fn->builtin)
+		return fn->fn(fn->priv, s, nargs, args);
+
+	if ((r = fun_memo_get(fn, nargs, args, &key)) != NULL)
+		return r;
+
+	if (vm_enabled && fn->code != NULL) {
+		r = vm_apply(fn->code, nargs, args);
+		fun_memo_put(fn, key, r);
+		return r;
+	}
+
+	if (fun_enter() < 0) {
+		fun_memo_put(fn, key, NULL);
+		return NULL;
+	}
+
+	argtbl = ext_varinit(121);
+
+	for (pn = fn->namelist, i = 0; pn != NULL; pn = pn->next, i++) {
+		v = ext_varlookup(argtbl, pn->name, 1);
+		v->v = args[i];
+		v->no_numfree = 1;
+	}
+
+	/*
+	 * fold_gen only changes between statements, so a tree that is out
+	 * of date is not being evaluated by any caller.
+	 */
+	if (fn->folded == NULL || fn->folded_gen != fold_gen) {
+		if (fn->folded != NULL)
+			ast_delete(fn->folded);
+		fn->folded = ast_fold(ast_copy(fn->ast), fn->namelist);
+		fn->folded_gen = fold_gen;
+	}
+
+	r = eval(fn->folded, argtbl);
+	fun_leave();
 
-	bitcnt = fn(Z(a), Z(b));
+	/* the result may be a local variable, which dies with argtbl */
+	if (r != NULL)
+		r = num_new_z_or_fp(N_TEMP, r);
 
-	mpz_init_set_ui(Z(r), (unsigned long)bitcnt);
+	hashtable_destroy(argtbl);
+
+	fun_memo_put(fn, key, r);
 
 	return r;
 }
 
 
+/*
+ * Applies fn, a builtin whose first argument names a function, to fnarg
+ * and the values of the other arguments.  The builtin is passed the name
+ * in place of its priv, and only the values in args.
+ */
 num_t
-call_fun(const char *s, explist_t l, hashtable_t vartbl)
+fun_apply_fnarg(func_t fn, const char *s, ast_t fnarg, int nargs,
+    num_t *args)
+{
+	int i;
+
+	if (fnarg->op_type != OP_VARREF) {
+		yyxerror("Function '%s' takes a varref as first argument", s);
+		return NULL;
+	}
+
+	for (i = 0; i < nargs; i++)
+		if (args[i] == NULL)
+			return NULL;
+
+	return fn->fn(((astref_t)fnarg)->name, s, nargs, args);
+}
+
+
+static
+num_t
+call_fn(func_t fn, const char *s, int nargs, explist_t l, hashtable_t vartbl)
 {
-	func_t fn;
 	explist_t p;
-	namelist_t pn;
+	ast_t fnarg;
 	num_t *args;
-	int nargs, i;
-	var_t v;
+	int i;
 	num_t r;
 
+	if (fun_check_args(fn, s, nargs) < 0)
+		return NULL;
+
+	fnarg = NULL;
+	if (fn->flags & FUNC_FN_ARG) {
+		fnarg = l->ast;
+		l = l->next;
+		--nargs;
+	}
+
+	if ((args =
+		alloc_safe_mem(BUCKET_MANUAL,
+		    sizeof(num_t) * nargs)) == NULL) {
+		yyxerror("ENOMEM");
+		exit(1);
+	}
+
+	i = 0;
+	for (p = l; p != NULL; p = p->next) {
+	  args[i++] = eval(p->ast, vartbl);
+	}
+
+	if (fnarg != NULL)
+		r = fun_apply_fnarg(fn, s, fnarg, nargs, args);
+	else
+		r = fun_apply(fn, s, nargs, args);
+
+	free_safe_mem(BUCKET_MANUAL, args);
+
+	return r;
+}
+
+
+num_t
+call_fun(const char *s, explist_t l, hashtable_t vartbl)
+{
+	explist_t p;
+	int nargs;
+
 	nargs = 0;
 	for (p = l; p != NULL; p = p->next)
 		++nargs;
 
-	if ((fn = funlookup(s, 0)) == NULL) {
-		yyxerror("Unknown function '%s'", s);
-		return NULL;
-	}
+	return call_fn(funlookup(s, 0), s, nargs, l, vartbl);
+}
+
+
+/*
+ * Returns the function a call refers to, looking it up only when a
+ * function has been defined since the last time.
+ */
+func_t
+fun_resolve(astcall_t ac)
+{
+	explist_t p;
+
+	if (ac->gen == fun_gen)
+		return ac->fn;
+
+	ac->nargs = 0;
+	for (p = ac->l; p != NULL; p = p->next)
+		++ac->nargs;
+
+	ac->fn = funlookup(ac->name, 0);
+	ac->gen = fun_gen;
+
+	return ac->fn;
+}
+
+
+num_t
+call_ast(astcall_t ac, hashtable_t vartbl)
+{
+	func_t fn;
+
+	fn = fun_resolve(ac);
+
+	return call_fn(fn, ac->name, ac->nargs, ac->l, vartbl);
+}
+
+
+static
+num_t
+builtin_min(void *priv, const char *s, int nargs, num_t * argv)
+{
+	num_t r;
+	num_t t;
+	int i;
+
+	r = num_new_fp(N_TEMP, argv[0]);
+	for (i = 1; i < nargs; i++) {
+		t = num_new_fp(N_TEMP, argv[i]);
+		if (mpfr_less_p(F(t), F(r)))
+			r = t;
+	}
+
+	return r;
+}
+
+
+static
+num_t
+builtin_max(void *priv, const char *s, int nargs, num_t * argv)
+{
+	num_t r;
+	num_t t;
+	int i;
+
+	r = num_new_fp(N_TEMP, argv[0]);
+	for (i = 1; i < nargs; i++) {
+		t = num_new_fp(N_TEMP, argv[i]);
+		if (mpfr_greater_p(F(t), F(r)))
+			r = t;
+	}
+
+	return r;
+}
+
+
+static
+num_t
+builtin_avg(void *priv, const char *s, int nargs, num_t * argv)
+{
+	num_t r;
+	num_t t;
+	int i;
+	unsigned long n = (unsigned long) nargs;
+
+	r = num_new_fp(N_TEMP, argv[0]);
+	for (i = 1; i < nargs; i++) {
+		t = num_new_fp(N_TEMP, argv[i]);
+		mpfr_add(F(r), F(r), F(t), round_mode);
+	}
+
+	mpfr_div_ui(F(r), F(r), n, round_mode);
+
+	return r;
+}
+
+
+static
+num_t
+builtin_sgn(void *priv, const char *s, int nargs, num_t * argv)
+{
+	num_t a, r;
+	int sgn;
+
+	r = num_new_z(N_TEMP, NULL);
+	if (argv[0]->num_type == NUM_INT) {
+		a = num_new_z(N_TEMP, argv[0]);
+		sgn = mpz_sgn(Z(a));
+	} else {
+		a = num_new_fp(N_TEMP, argv[0]);
+		sgn = mpfr_sgn(F(a));
+	}
+	mpz_set_si(Z(r), (long)sgn);
+	return r;
+}
+
+
+/*
+ * Integer view of a builtin argument; integers are used as they are
+ * rather than copied.
+ */
+static
+num_t
+int_arg(num_t a)
+{
+	return (a->num_type == NUM_INT) ? a : num_new_z(N_TEMP, a);
+}
+
+
+static
+num_t
+builtin_popcount(void *priv, const char *s, int nargs, num_t * argv)
+{
+	num_t a, r;
+
+	r = num_new_z(N_TEMP, NULL);
+	a = int_arg(argv[0]);
+	if (bitops_fits_u64(Z(a)))
+		mpz_set_ui(Z(r), (unsigned long)bitops_popcount(bitops_get_u64(Z(a))));
+	else
+		mpz_set_ui(Z(r), (unsigned long)mpz_popcount(Z(a)));
+	return r;
+}
+
+
+static
+num_t
+builtin_hamdist(void *priv, const char *s, int nargs, num_t * argv)
+{
+	num_t a, b, r;
+
+	r = num_new_z(N_TEMP, NULL);
+	a = int_arg(argv[0]);
+	b = int_arg(argv[1]);
+	if (bitops_fits_u64(Z(a)) && bitops_fits_u64(Z(b)))
+		mpz_set_ui(Z(r), (unsigned long)bitops_popcount(
+		    bitops_get_u64(Z(a)) ^ bitops_get_u64(Z(b))));
+	else
+		mpz_set_ui(Z(r), (unsigned long)mpz_hamdist(Z(a), Z(b)));
+	return r;
+}
+
+
+static
+num_t
+builtin_bits(void *priv, const char *s, int nargs, num_t * argv)
+{
+	num_t a, r;
+
+	r = num_new_z(N_TEMP, NULL);
+	a = int_arg(argv[0]);
+	if (bitops_fits_u64(Z(a)) && mpz_sgn(Z(a)) != 0)
+		mpz_set_ui(Z(r), 64UL - bitops_clz(bitops_get_u64(Z(a))));
+	else
+		mpz_set_ui(Z(r), (unsigned long)mpz_sizeinbase(Z(a), 2));
+	return r;
+}
+
+
+static
+num_t
+builtin_msb(void *priv, const char *s, int nargs, num_t * argv)
+{
+	num_t a, r;
+
+	r = num_new_z(N_TEMP, NULL);
+	a = int_arg(argv[0]);
+	if (mpz_sgn(Z(a)) <= 0) {
+		yyxerror("msb: argument must be a positive integer");
+		return NULL;
+	}
+	if (bitops_fits_u64(Z(a)))
+		mpz_set_ui(Z(r), 63UL - bitops_clz(bitops_get_u64(Z(a))));
+	else
+		mpz_set_ui(Z(r), (unsigned long)(mpz_sizeinbase(Z(a), 2) - 1));
+	return r;
+}
+
+
+static
+num_t
+builtin_ctz(void *priv, const char *s, int nargs, num_t * argv)
+{
+	num_t a, r;
+
+	r = num_new_z(N_TEMP, NULL);
+	a = int_arg(argv[0]);
+	if (mpz_sgn(Z(a)) == 0) {
+		yyxerror("ctz: argument must be non-zero");
+		return NULL;
+	}
+	if (bitops_fits_u64(Z(a)))
+		mpz_set_ui(Z(r), (unsigned long)bitops_ctz(bitops_get_u64(Z(a))));
+	else
+		mpz_set_ui(Z(r), (unsigned long)mpz_scan1(Z(a), 0));
+	return r;
+}
+
+
+/* pdep if priv is NULL, pext otherwise */
+static
+num_t
+builtin_pdep(void *priv, const char *s, int nargs, num_t * argv)
+{
+	num_t x, m, r;
+	uint64_t xv, mv;
+
+	r = num_new_z(N_TEMP, NULL);
+	x = int_arg(argv[0]);
+	m = int_arg(argv[1]);
+	if (mpz_sgn(Z(x)) < 0 || mpz_sgn(Z(m)) < 0) {
+		yyxerror("%s: arguments must be non-negative", s);
+		return NULL;
+	}
+
+	/* a 64-bit mask only ever touches the low 64 bits of x */
+	if (bitops_fits_u64(Z(m))) {
+		xv = bitops_get_u64(Z(x));
+		mv = bitops_get_u64(Z(m));
+		bitops_set_u64(Z(r), (priv == NULL) ? bitops_pdep(xv, mv) :
+		    bitops_pext(xv, mv));
+	} else if (priv == NULL) {
+		bitops_pdep_z(Z(r), Z(x), Z(m));
+	} else {
+		bitops_pext_z(Z(r), Z(x), Z(m));
+	}
+	return r;
+}
+
+
+/*
+ * Word operations: x is taken modulo 2^w, where the optional word width
+ * w (argument 'wi') defaults to 64.
+ */
+static
+int
+word_arg(const char *s, int nargs, num_t *argv, int wi, unsigned int *w,
+    uint64_t *x)
+{
+	num_t a;
+
+	*w = 64;
+	if (nargs > wi) {
+		a = int_arg(argv[wi]);
+		if (mpz_cmp_ui(Z(a), 1UL) < 0 || mpz_cmp_ui(Z(a), 64UL) > 0) {
+			yyxerror("%s: word width must be between 1 and 64", s);
+			return -1;
+		}
+		*w = (unsigned int)mpz_get_ui(Z(a));
+	}
+
+	*x = bitops_get_u64(Z(int_arg(argv[0])));
+	if (*w < 64)
+		*x &= (1ULL << *w) - 1;
+
+	return 0;
+}
+
+
+static
+num_t
+builtin_bitrev(void *priv, const char *s, int nargs, num_t * argv)
+{
+	num_t r;
+	unsigned int w;
+	uint64_t x;
+
+	if (word_arg(s, nargs, argv, 1, &w, &x) < 0)
+		return NULL;
+
+	r = num_new_z(N_TEMP, NULL);
+	bitops_set_u64(Z(r), bitops_bitrev(x) >> (64 - w));
+	return r;
+}
+
+
+static
+num_t
+builtin_bswap(void *priv, const char *s, int nargs, num_t * argv)
+{
+	num_t r;
+	unsigned int w;
+	uint64_t x;
+
+	if (word_arg(s, nargs, argv, 1, &w, &x) < 0)
+		return NULL;
+	if (w % 8 != 0) {
+		yyxerror("%s: word width must be a multiple of 8", s);
+		return NULL;
+	}
+
+	r = num_new_z(N_TEMP, NULL);
+	bitops_set_u64(Z(r), bitops_bswap(x) >> (64 - w));
+	return r;
+}
+
+
+static
+num_t
+builtin_clz(void *priv, const char *s, int nargs, num_t * argv)
+{
+	num_t r;
+	unsigned int w;
+	uint64_t x;
+
+	if (word_arg(s, nargs, argv, 1, &w, &x) < 0)
+		return NULL;
+
+	r = num_new_z(N_TEMP, NULL);
+	mpz_set_ui(Z(r), (unsigned long)(bitops_clz(x) - (64 - w)));
+	return r;
+}
+
+
+/* rotl if priv is NULL, rotr otherwise */
+static
+num_t
+builtin_rot(void *priv, const char *s, int nargs, num_t * argv)
+{
+	num_t r;
+	unsigned int w, n;
+	uint64_t x;
+
+	if (word_arg(s, nargs, argv, 2, &w, &x) < 0)
+		return NULL;
+
+	n = (unsigned int)mpz_fdiv_ui(Z(int_arg(argv[1])), w);
+	if (priv != NULL && n != 0)
+		n = w - n;
+	if (n != 0) {
+		x = (x << n) | (x >> (w - n));
+		if (w < 64)
+			x &= (1ULL << w) - 1;
+	}
+
+	r = num_new_z(N_TEMP, NULL);
+	bitops_set_u64(Z(r), x);
+	return r;
+}
+
+
+static
+num_t
+builtin_prod(void *priv, const char *s, int nargs, num_t * argv)
+{
+	num_t r, lo, hi;
+	int neg;
+
+	r = num_new_z(N_TEMP, NULL);
+	lo = num_new_z(N_TEMP, argv[0]);
+	hi = num_new_z(N_TEMP, argv[1]);
+
+	if (mpz_cmp(Z(lo), Z(hi)) > 0) {
+		mpz_set_ui(Z(r), 1);
+		return r;
+	}
+
+	if (mpz_sgn(Z(lo)) <= 0 && mpz_sgn(Z(hi)) >= 0)
+		return r;
+
+	/* an all-negative range is (-1)^count times the mirrored range */
+	if ((neg = (mpz_sgn(Z(hi)) < 0))) {
+		mpz_swap(Z(lo), Z(hi));
+		mpz_neg(Z(lo), Z(lo));
+		mpz_neg(Z(hi), Z(hi));
+	}
+
+	if (!mpz_fits_ulong_p(Z(lo)) || !mpz_fits_ulong_p(Z(hi))) {
+		yyxerror("Arguments to '%s' need to fit into an unsigned long C datatype", s);
+		return NULL;
+	}
+
+	bigz_prod_range(Z(r), mpz_get_ui(Z(lo)), mpz_get_ui(Z(hi)));
+
+	/* odd number of terms iff both ends have the same parity */
+	if (neg && mpz_odd_p(Z(lo)) == mpz_odd_p(Z(hi)))
+		mpz_neg(Z(r), Z(r));
+
+	return r;
+}
+
+
+static
+num_t
+builtin_rand(void *priv, const char *s, int nargs, num_t * argv)
+{
+	num_t r;
+
+	r = num_new_fp(N_TEMP, NULL);
+	rand_float(F(r));
+
+	return r;
+}
+
 
-	if (nargs < fn->minargs || nargs > fn->maxargs) {
-		if (fn->minargs == fn->maxargs)
-			yyxerror("Function '%s' takes exactly %d arguments", s,
-			    fn->minargs);
-		else
-			yyxerror
-			    ("Function '%s' takes a minimum of %d and a maximum of %d arguments",
-			    s, fn->minargs, fn->maxargs);
+static
+num_t
+builtin_randint(void *priv, const char *s, int nargs, num_t * argv)
+{
+	num_t r, lo, hi;
+
+	r = num_new_z(N_TEMP, NULL);
+	lo = num_new_z(N_TEMP, argv[0]);
+	hi = num_new_z(N_TEMP, argv[1]);
 
+	if (rand_int(Z(r), Z(lo), Z(hi)) < 0) {
+		yyxerror("Function '%s' needs a <= b", s);
 		return NULL;
 	}
 
-	if (!(fn->flags & FUNC_RAW_ARGS)) {
-		if ((args =
-			alloc_safe_mem(BUCKET_MANUAL,
-			    sizeof(num_t) * nargs)) == NULL) {
-			yyxerror("ENOMEM");
-			exit(1);
-		}
-
-		i = 0;
-		for (p = l; p != NULL; p = p->next) {
-		  args[i++] = eval(p->ast, vartbl);
-		}
-	}
+	return r;
+}
 
-	if (fn->builtin) {
-		if (!(fn->flags & FUNC_RAW_ARGS)) {
-			r = fn->fn(fn->priv, s, nargs, args);
-		} else {
-			r = fn->fn(vartbl, s, nargs, (void *)l);
-		}
-	} else {
-		hashtable_t argtbl = ext_varinit(121);
 
-		for (pn = fn->namelist, i = 0; pn != NULL; pn = pn->next, i++) {
-			v = ext_varlookup(argtbl, pn->name, 1);
-			v->v = args[i];
-			v->no_numfree = 1;
-		}
+static
+num_t
+builtin_randbits(void *priv, const char *s, int nargs, num_t * argv)
+{
+	num_t r, n;
 
-		r = eval(fn->ast, argtbl);
+	r = num_new_z(N_TEMP, NULL);
+	n = num_new_z(N_TEMP, argv[0]);
 
-		hashtable_destroy(argtbl);
+	if (!mpz_fits_ulong_p(Z(n))) {
+		yyxerror("Argument to '%s' needs to fit into an unsigned long C datatype", s);
+		return NULL;
 	}
 
-	if (!(fn->flags & FUNC_RAW_ARGS))
-		free_safe_mem(BUCKET_MANUAL, args);
+	rand_bits(Z(r), mpz_get_ui(Z(n)));
 
 	return r;
 }
@@ -324,58 +1128,66 @@ call_fun(const char *s, explist_t l, hashtable_t vartbl)
 
 static
 num_t
-builtin_min(void *priv, const char *s, int nargs, num_t * argv)
+builtin_seed(void *priv, const char *s, int nargs, num_t * argv)
 {
-	num_t r;
-	num_t t;
-	int i;
+	num_t a;
 
-	r = num_new_fp(N_TEMP, argv[0]);
-	for (i = 1; i < nargs; i++) {
-		t = num_new_fp(N_TEMP, argv[i]);
-		if (mpfr_less_p(F(t), F(r)))
-			r = t;
-	}
+	a = num_new_z(N_TEMP, argv[0]);
+	rand_seed(Z(a));
 
-	return r;
+	return NULL;
 }
 
 
+/*
+ * Fetches a [lo, hi] range argument pair, clamping lo to 0.  Returns 1
+ * for an empty range and -1 if the bounds don't fit.
+ */
 static
-num_t
-builtin_max(void *priv, const char *s, int nargs, num_t * argv)
+int
+builtin_prime_range(const char *s, num_t lo_n, num_t hi_n, unsigned long *lo,
+    unsigned long *hi)
 {
-	num_t r;
-	num_t t;
-	int i;
+	num_t a, b;
 
-	r = num_new_fp(N_TEMP, argv[0]);
-	for (i = 1; i < nargs; i++) {
-		t = num_new_fp(N_TEMP, argv[i]);
-		if (mpfr_greater_p(F(t), F(r)))
-			r = t;
+	a = num_new_z(N_TEMP, lo_n);
+	b = num_new_z(N_TEMP, hi_n);
+
+	if (mpz_sgn(Z(b)) < 0 || mpz_cmp(Z(a), Z(b)) > 0)
+		return 1;
+	if (mpz_sgn(Z(a)) < 0)
+		mpz_set_ui(Z(a), 0);
+
+	if (!mpz_fits_ulong_p(Z(b))) {
+		yyxerror("Arguments to '%s' need to fit into an unsigned long C datatype", s);
+		return -1;
 	}
 
-	return r;
+	*lo = mpz_get_ui(Z(a));
+	*hi = mpz_get_ui(Z(b));
+	return 0;
 }
 
 
 static
 num_t
-builtin_avg(void *priv, const char *s, int nargs, num_t * argv)
+builtin_countprimes(void *priv, const char *s, int nargs, num_t * argv)
 {
+	unsigned long lo, hi;
 	num_t r;
-	num_t t;
-	int i;
-	unsigned long n = (unsigned long) nargs;
+	int e;
 
-	r = num_new_fp(N_TEMP, argv[0]);
-	for (i = 1; i < nargs; i++) {
-		t = num_new_fp(N_TEMP, argv[i]);
-		mpfr_add(F(r), F(r), F(t), round_mode);
-	}
+	r = num_new_z(N_TEMP, NULL);
+	if (nargs == 1)
+		e = builtin_prime_range(s, num_new_const_zero(N_TEMP), argv[0],
+		    &lo, &hi);
+	else
+		e = builtin_prime_range(s, argv[0], argv[1], &lo, &hi);
 
-	mpfr_div_ui(F(r), F(r), n, round_mode);
+	if (e < 0)
+		return NULL;
+	if (e == 0)
+		mpz_set_ui(Z(r), prime_count(lo, hi));
 
 	return r;
 }
@@ -383,71 +1195,171 @@ builtin_avg(void *priv, const char *s, int nargs, num_t * argv)
 
 static
 num_t
-builtin_sgn(void *priv, const char *s, int nargs, num_t * argv)
+builtin_primes(void *priv, const char *s, int nargs, num_t * argv)
 {
-	num_t a, r;
-	int sgn;
+	unsigned long lo, hi, *list;
+	size_t i, n;
+	num_t r;
+	int e;
 
 	r = num_new_z(N_TEMP, NULL);
-	if (argv[0]->num_type == NUM_INT) {
-		a = num_new_z(N_TEMP, argv[0]);
-		sgn = mpz_sgn(Z(a));
-	} else {
-		a = num_new_fp(N_TEMP, argv[0]);
-		sgn = mpfr_sgn(F(a));
-	}
-	mpz_set_si(Z(r), (long)sgn);
+	if ((e = builtin_prime_range(s, argv[0], argv[1], &lo, &hi)) < 0)
+		return NULL;
+	if (e > 0)
+		return r;
+
+	list = prime_list(lo, hi, &n);
+	for (i = 0; i < n; i++)
+		printf("%lu\n", list[i]);
+	free(list);
+
+	mpz_set_ui(Z(r), (unsigned long)n);
 	return r;
 }
 
 
 static
 num_t
-builtin_bits(void *priv, const char *s, int nargs, num_t * argv)
+builtin_isprime(void *priv, const char *s, int nargs, num_t * argv)
 {
 	num_t a, r;
 
 	r = num_new_z(N_TEMP, NULL);
 	a = num_new_z(N_TEMP, argv[0]);
-	mpz_set_ui(Z(r), (unsigned long)mpz_sizeinbase(Z(a), 2));
+	/* mpz_probab_prime_p() would test |a| */
+	if (mpz_sgn(Z(a)) > 0 && mpz_probab_prime_p(Z(a), 25) > 0)
+		mpz_set_ui(Z(r), 1);
 	return r;
 }
 
 
 static
 num_t
-builtin_msb(void *priv, const char *s, int nargs, num_t * argv)
+builtin_prevprime(void *priv, const char *s, int nargs, num_t * argv)
 {
 	num_t a, r;
 
 	r = num_new_z(N_TEMP, NULL);
 	a = num_new_z(N_TEMP, argv[0]);
-	if (mpz_sgn(Z(a)) <= 0) {
-		yyxerror("msb: argument must be a positive integer");
+	if (prime_prev(Z(r), Z(a)) != 0) {
+		yyxerror("%s: argument must be greater than 2", s);
 		return NULL;
 	}
-	mpz_set_ui(Z(r), (unsigned long)(mpz_sizeinbase(Z(a), 2) - 1));
 	return r;
 }
 
 
+/*
+ * Prints the factorization of a, e.g. "2^3 * 3^2 * 5", and returns the
+ * number of prime factors counted with multiplicity.
+ */
 static
 num_t
-builtin_ctz(void *priv, const char *s, int nargs, num_t * argv)
+builtin_factor(void *priv, const char *s, int nargs, num_t * argv)
 {
-	num_t a, r;
+	struct prime_factor *f;
+	num_t a, r, b;
+	long budget = 30;
+	size_t i, n;
+	char *str;
 
 	r = num_new_z(N_TEMP, NULL);
 	a = num_new_z(N_TEMP, argv[0]);
+
+	if (nargs > 1) {
+		b = num_new_z(N_TEMP, argv[1]);
+		if (!mpz_fits_slong_p(Z(b)) || mpz_sgn(Z(b)) <= 0) {
+			yyxerror("%s: time budget must be a positive number of seconds", s);
+			return NULL;
+		}
+		budget = mpz_get_si(Z(b));
+	}
+
 	if (mpz_sgn(Z(a)) == 0) {
-		yyxerror("ctz: argument must be non-zero");
+		yyxerror("%s: argument must be non-zero", s);
 		return NULL;
 	}
-	mpz_set_ui(Z(r), (unsigned long)mpz_scan1(Z(a), 0));
+
+	if (mpz_sgn(Z(a)) < 0) {
+		printf("-1%s", (mpz_cmp_si(Z(a), -1) == 0) ? "\n" : " * ");
+		mpz_neg(Z(a), Z(a));
+	} else if (mpz_cmp_ui(Z(a), 1) == 0) {
+		printf("1\n");
+	}
+
+	if (mpz_cmp_ui(Z(a), 1) == 0)
+		return r;
+
+	n = prime_factorize(&f, Z(a), budget);
+
+	for (i = 0; i < n; i++) {
+		if ((str = mpz_get_str(NULL, 10, f[i].p)) == NULL) {
+			yyxerror("ENOMEM");
+			exit(1);
+		}
+		printf("%s%s", (i > 0) ? " * " : "", str);
+		if (f[i].e > 1)
+			printf("^%lu", f[i].e);
+		if (f[i].composite)
+			printf(" (composite)");
+		free(str);
+
+		mpz_add_ui(Z(r), Z(r), f[i].e);
+	}
+	printf("\n");
+
+	prime_factors_free(f, n);
 	return r;
 }
 
 
+static
+num_t
+builtin_fixed_common(const char *s, int is_signed, num_t * argv)
+{
+	num_t m, n;
+
+	m = num_new_z(N_TEMP, argv[1]);
+	n = num_new_z(N_TEMP, argv[2]);
+	if (!mpz_fits_sint_p(Z(m)) || !mpz_fits_sint_p(Z(n))) {
+		yyxerror("%s: format arguments m and n must fit into an int", s);
+		return NULL;
+	}
+
+	return num_fixed_from(N_TEMP, argv[0], (int)mpz_get_si(Z(m)),
+	    (int)mpz_get_si(Z(n)), is_signed);
+}
+
+
+static
+num_t
+builtin_fixed(void *priv, const char *s, int nargs, num_t * argv)
+{
+	return builtin_fixed_common(s, 1, argv);
+}
+
+
+static
+num_t
+builtin_ufixed(void *priv, const char *s, int nargs, num_t * argv)
+{
+	return builtin_fixed_common(s, 0, argv);
+}
+
+
+static
+num_t
+builtin_fxraw(void *priv, const char *s, int nargs, num_t * argv)
+{
+	if (argv[0]->num_type != NUM_FIXED) {
+		yyxerror("%s: argument must be a fixed-point value", s);
+		return NULL;
+	}
+
+	return num_fixed_raw(argv[0]);
+}
+
+
 static
 num_t
 builtin_deg2rad(void *priv, const char *s, int nargs, num_t * argv)
@@ -488,42 +1400,17 @@ static
 num_t
 builtin_tabulate(void *priv, const char *s, int nargs, num_t * argv)
 {
-	hashtable_t vartbl = (hashtable_t)priv;
-	explist_t p, l;
-	ast_t first_arg_ast;
-	const char *fn_name;
+	const char *fn_name = priv;
 	func_t fn;
 	num_t *results;
-	num_t *args;
 	int i;
 	int n, maxarglen, maxreslen;
 	char buf[256];
 	char buf2[256];
 
-	l = (explist_t)argv;
-	p = l;
-
-	first_arg_ast = p->ast;
-	if (first_arg_ast->op_type != OP_VARREF) {
-		yyxerror("Function 'tabulate' takes a varref as first argument");
-		return NULL;
-	}
-
-	fn_name = ((astref_t) first_arg_ast)->name;
-
-	if ((fn = funlookup(fn_name, 0)) == NULL) {
-		yyxerror("Unknown function '%s'", fn_name);
+	fn = funlookup(fn_name, 0);
+	if (fun_check_args(fn, fn_name, 1) < 0)
 		return NULL;
-	}
-
-	--nargs;
-
-	if ((args =
-		alloc_safe_mem(BUCKET_NUM_TEMP,
-		    sizeof(num_t) * nargs)) == NULL) {
-		yyxerror("ENOMEM");
-		exit(1);
-	}
 
 	if ((results =
 		alloc_safe_mem(BUCKET_NUM_TEMP,
@@ -533,26 +1420,21 @@ builtin_tabulate(void *priv, const char *s, int nargs, num_t * argv)
 	}
 
 	maxarglen = maxreslen = 0;
-	for (p = l->next, i = 0; p != NULL; p = p->next, ++i) {
-		struct explist lx;
-
-		args[i] = eval(p->ast, vartbl);
-
-		lx.ast = p->ast;
-		lx.next = NULL;
-		results[i] = call_fun(fn_name, &lx, vartbl);
+	for (i = 0; i < nargs; i++) {
+		if ((results[i] = fun_apply(fn, fn_name, 1, &argv[i])) == NULL)
+			return NULL;
 
 		n = num_snprint(buf, sizeof(buf)-1, 0, results[i]);
 		if (n > maxreslen)
 			maxreslen = n;
 
-		n = num_snprint(buf, sizeof(buf)-1, 0, args[i]);
+		n = num_snprint(buf, sizeof(buf)-1, 0, argv[i]);
 		if (n > maxarglen)
 			maxarglen = n;
 	}
 
 	for (i = 0; i < nargs; i++) {
-		num_snprint(buf, sizeof(buf)-1, maxarglen, args[i]);
+		num_snprint(buf, sizeof(buf)-1, maxarglen, argv[i]);
 		num_snprint(buf2, sizeof(buf2)-1, maxreslen, results[i]);
 		printf("%s | %s\n", buf, buf2);
 	}
@@ -561,6 +1443,66 @@ builtin_tabulate(void *priv, const char *s, int nargs, num_t * argv)
 }
 
 
+static
+num_t
+builtin_diff(void *priv, const char *s, int nargs, num_t * argv)
+{
+	num_t r, d;
+
+	r = dual_diff(priv, nargs, argv, 1, &d);
+
+	return (r != NULL) ? d : NULL;
+}
+
+
+static
+num_t
+builtin_grad(void *priv, const char *s, int nargs, num_t * argv)
+{
+	const char *fn_name = priv;
+	func_t fn;
+	namelist_t pn;
+	num_t *grad;
+	int i, n, maxarglen;
+	char buf[256];
+
+	if ((grad = alloc_safe_mem(BUCKET_MANUAL, sizeof(num_t) * nargs)) == NULL) {
+		yyxerror("ENOMEM");
+		exit(1);
+	}
+
+	if (dual_diff(fn_name, nargs, argv, nargs, grad) == NULL) {
+		free_safe_mem(BUCKET_MANUAL, grad);
+		return NULL;
+	}
+
+	/* a user function's partials are labelled with its parameter names */
+	fn = funlookup(fn_name, 0);
+	pn = fn->builtin ? NULL : fn->namelist;
+
+	maxarglen = 0;
+	for (i = 0; i < nargs; i++, pn = (pn != NULL) ? pn->next : NULL) {
+		n = (pn != NULL) ? (int)strlen(pn->name) :
+		    snprintf(buf, sizeof(buf), "%d", i + 1);
+		if (n > maxarglen)
+			maxarglen = n;
+	}
+
+	pn = fn->builtin ? NULL : fn->namelist;
+	for (i = 0; i < nargs; i++, pn = (pn != NULL) ? pn->next : NULL) {
+		num_snprint(buf, sizeof(buf)-1, 0, grad[i]);
+		if (pn != NULL)
+			printf("%*s | %s\n", maxarglen, pn->name, buf);
+		else
+			printf("%*d | %s\n", maxarglen, i + 1, buf);
+	}
+
+	free_safe_mem(BUCKET_MANUAL, grad);
+
+	return NULL;
+}
+
+
 struct builtin_arg_help
 {
 	const char *name;
@@ -690,7 +1632,7 @@ static const struct builtin_arg_help arg_help_fib[] = {
 
 static const struct builtin_arg_help arg_help_inv[] = {
 	{ "a", "Value to invert." },
-	{ "N", "Modulus." },
+	{ "N", "Modulus, by default that of the modulus context." },
 	{ NULL, NULL }
 };
 
@@ -720,6 +1662,25 @@ static const struct builtin_arg_help arg_help_ctz[] = {
 	{ NULL, NULL }
 };
 
+static const struct builtin_arg_help arg_help_word[] = {
+	{ "x", "Integer, taken modulo 2^w." },
+	{ "w", "Optional word width in bits, 1 to 64 (default 64)." },
+	{ NULL, NULL }
+};
+
+static const struct builtin_arg_help arg_help_pdep[] = {
+	{ "x", "Non-negative integer source." },
+	{ "m", "Non-negative integer mask." },
+	{ NULL, NULL }
+};
+
+static const struct builtin_arg_help arg_help_rot[] = {
+	{ "x", "Integer, taken modulo 2^w." },
+	{ "n", "Number of bit positions, taken modulo w." },
+	{ "w", "Optional word width in bits, 1 to 64 (default 64)." },
+	{ NULL, NULL }
+};
+
 static const struct builtin_arg_help arg_help_variadic_values[] = {
 	{ "a", "First value." },
 	{ "b", "Second value." },
@@ -734,6 +1695,86 @@ static const struct builtin_arg_help arg_help_tabulate[] = {
 	{ NULL, NULL }
 };
 
+static const struct builtin_arg_help arg_help_diff[] = {
+	{ "f", "Function name to differentiate." },
+	{ "x", "Point at which to take the derivative, with respect to f's first argument." },
+	{ "...", "Values of f's remaining arguments." },
+	{ NULL, NULL }
+};
+
+static const struct builtin_arg_help arg_help_grad[] = {
+	{ "f", "Function name to differentiate." },
+	{ "x", "Value of f's first argument." },
+	{ "...", "Values of f's remaining arguments." },
+	{ NULL, NULL }
+};
+
+static const struct builtin_arg_help arg_help_randint[] = {
+	{ "a", "Smallest possible result." },
+	{ "b", "Largest possible result." },
+	{ NULL, NULL }
+};
+
+static const struct builtin_arg_help arg_help_randbits[] = {
+	{ "n", "Number of random bits." },
+	{ NULL, NULL }
+};
+
+static const struct builtin_arg_help arg_help_seed[] = {
+	{ "s", "Integer seed." },
+	{ NULL, NULL }
+};
+
+static const struct builtin_arg_help arg_help_prevprime[] = {
+	{ "a", "Integer below which to search for the previous prime." },
+	{ NULL, NULL }
+};
+
+static const struct builtin_arg_help arg_help_isprime[] = {
+	{ "a", "Integer to test." },
+	{ NULL, NULL }
+};
+
+static const struct builtin_arg_help arg_help_primepi[] = {
+	{ "n", "Upper bound, inclusive." },
+	{ NULL, NULL }
+};
+
+static const struct builtin_arg_help arg_help_prime_range[] = {
+	{ "lo", "Lower bound, inclusive." },
+	{ "hi", "Upper bound, inclusive." },
+	{ NULL, NULL }
+};
+
+static const struct builtin_arg_help arg_help_factor[] = {
+	{ "a", "Non-zero integer to factor." },
+	{ "t", "Optional time budget in seconds for large cofactors (default 30)." },
+	{ NULL, NULL }
+};
+
+static const struct builtin_arg_help arg_help_primorial[] = {
+	{ "n", "Upper bound for the primes to multiply." },
+	{ NULL, NULL }
+};
+
+static const struct builtin_arg_help arg_help_prod[] = {
+	{ "lo", "First factor." },
+	{ "hi", "Last factor." },
+	{ NULL, NULL }
+};
+
+static const struct builtin_arg_help arg_help_fixed[] = {
+	{ "x", "Value to convert." },
+	{ "m", "Integer bits, including the sign bit for signed formats." },
+	{ "n", "Fractional bits." },
+	{ NULL, NULL }
+};
+
+static const struct builtin_arg_help arg_help_fxraw[] = {
+	{ "x", "Fixed-point value." },
+	{ NULL, NULL }
+};
+
 struct builtin_funcs
 {
 	const char *name;
@@ -943,6 +1984,36 @@ struct builtin_funcs
     "The smallest prime greater than a.",
     arg_help_nextprime,
     NULL },
+  { "prevprime" , NULL           , builtin_prevprime              , 1, 1   , 0,
+    "Previous prime.",
+    "The largest prime less than a.",
+    arg_help_prevprime,
+    "prevprime(100) => 97" },
+  { "isprime"   , NULL           , builtin_isprime                , 1, 1   , 0,
+    "Primality test.",
+    "1 if a is prime, otherwise 0. Exact below 2^64, a probable-prime test above.",
+    arg_help_isprime,
+    NULL },
+  { "primepi"   , NULL           , builtin_countprimes            , 1, 1   , 0,
+    "Prime-counting function.",
+    "The number of primes less than or equal to n.",
+    arg_help_primepi,
+    "primepi(100) => 25" },
+  { "countprimes", NULL          , builtin_countprimes            , 2, 2   , 0,
+    "Count primes in a range.",
+    "The number of primes p with lo <= p <= hi.",
+    arg_help_prime_range,
+    "countprimes(10, 20) => 4" },
+  { "primes"    , NULL           , builtin_primes                 , 2, 2   , FUNC_IMPURE,
+    "List primes in a range.",
+    "The number of primes p with lo <= p <= hi. The primes are printed, one per line.",
+    arg_help_prime_range,
+    NULL },
+  { "factor"    , NULL           , builtin_factor                 , 1, 2   , FUNC_IMPURE,
+    "Integer factorization.",
+    "The number of prime factors of a, counted with multiplicity. The factorization is printed.",
+    arg_help_factor,
+    "factor(360) prints 2^3 * 3^2 * 5 => 6" },
   { "gcd"       , mpz_gcd        , builtin_mpz_fun_two_arg        , 2, 2   , 0,
     "Greatest common divisor.",
     "The greatest common divisor of a and b.",
@@ -973,33 +2044,43 @@ struct builtin_funcs
     "The n-th Fibonacci number.",
     arg_help_fib,
     NULL },
-  { "invert"    , mpz_invert     , builtin_mpz_fun_two_arg        , 2, 2   , 0,
+  { "primorial" , bigz_primorial , builtin_mpz_fun_one_arg_ul     , 1, 1   , 0,
+    "Primorial.",
+    "The product of all primes less than or equal to n.",
+    arg_help_primorial,
+    "primorial(10) => 210" },
+  { "prod"      , NULL           , builtin_prod                   , 2, 2   , 0,
+    "Product of an integer range.",
+    "lo * (lo + 1) * ... * hi, or 1 if lo > hi.",
+    arg_help_prod,
+    "prod(5, 8) => 1680" },
+  { "invert"    , mpz_invert     , builtin_inv                    , 1, 2   , 0,
     "Modular inverse.",
     "A value x such that (a * x) % N == 1, when one exists.",
     arg_help_inv,
     "invert(3, 11) => 4" },
-  { "inv"       , mpz_invert     , builtin_mpz_fun_two_arg        , 2, 2   , 0,
+  { "inv"       , mpz_invert     , builtin_inv                    , 1, 2   , 0,
     "Modular inverse.",
     "A value x such that (a * x) % N == 1, when one exists.",
     arg_help_inv,
     "inv(3, 11) => 4" },
 
-  { "hamdist"   , mpz_hamdist    , builtin_mpz_fun_two_arg_bitcnt , 2, 2   , 0,
+  { "hamdist"   , NULL           , builtin_hamdist                , 2, 2   , 0,
     "Hamming distance.",
     "The number of bit positions where a and b differ.",
     arg_help_hamdist,
     NULL },
-  { "countones" , mpz_popcount   , builtin_mpz_fun_one_arg_bitcnt , 1, 1   , 0,
+  { "countones" , NULL           , builtin_popcount               , 1, 1   , 0,
     "Count set bits.",
     "The number of 1-bits in a.",
     arg_help_popcount,
     NULL },
-  { "popcount"  , mpz_popcount   , builtin_mpz_fun_one_arg_bitcnt , 1, 1   , 0,
+  { "popcount"  , NULL           , builtin_popcount               , 1, 1   , 0,
     "Count set bits.",
     "The number of 1-bits in a.",
     arg_help_popcount,
     NULL },
-  { "popcnt"    , mpz_popcount   , builtin_mpz_fun_one_arg_bitcnt , 1, 1   , 0,
+  { "popcnt"    , NULL           , builtin_popcount               , 1, 1   , 0,
     "Count set bits.",
     "The number of 1-bits in a.",
     arg_help_popcount,
@@ -1019,6 +2100,78 @@ struct builtin_funcs
     "The number of consecutive zero bits at the least-significant end of a.",
     arg_help_ctz,
     NULL },
+  { "clz"       , NULL           , builtin_clz                    , 1, 2   , 0,
+    "Count leading zeros.",
+    "The number of consecutive zero bits at the most-significant end of the w-bit word x.",
+    arg_help_word,
+    "clz(1, 32) => 31" },
+  { "pdep"      , NULL           , builtin_pdep                   , 2, 2   , 0,
+    "Parallel bit deposit.",
+    "The low bits of x scattered, in order, to the set bit positions of m.",
+    arg_help_pdep,
+    "pdep(0b101, 0b11100) => 0b10100" },
+  { "pext"      , (void *)1      , builtin_pdep                   , 2, 2   , 0,
+    "Parallel bit extract.",
+    "The bits of x at the set bit positions of m, packed into the low bits.",
+    arg_help_pdep,
+    "pext(0b10100, 0b11100) => 0b101" },
+  { "bitrev"    , NULL           , builtin_bitrev                 , 1, 2   , 0,
+    "Bit reversal.",
+    "The w-bit word x with the order of its bits reversed.",
+    arg_help_word,
+    "bitrev(1, 8) => 128" },
+  { "bswap"     , NULL           , builtin_bswap                  , 1, 2   , 0,
+    "Byte swap.",
+    "The w-bit word x with the order of its bytes reversed.",
+    arg_help_word,
+    "bswap(0x1234, 16) => 0x3412" },
+  { "rotl"      , NULL           , builtin_rot                    , 2, 3   , 0,
+    "Rotate left.",
+    "The w-bit word x rotated left by n bits.",
+    arg_help_rot,
+    "rotl(0x81, 1, 8) => 3" },
+  { "rotr"      , (void *)1      , builtin_rot                    , 2, 3   , 0,
+    "Rotate right.",
+    "The w-bit word x rotated right by n bits.",
+    arg_help_rot,
+    "rotr(3, 1, 8) => 0x81" },
+
+  { "fixed"     , NULL           , builtin_fixed                  , 3, 3   , 0,
+    "Signed fixed-point conversion.",
+    "x rounded into the signed Qm.n format. Arithmetic on the result stays in that format.",
+    arg_help_fixed,
+    "fixed(1.3, 4, 4) => 1.25" },
+  { "ufixed"    , NULL           , builtin_ufixed                 , 3, 3   , 0,
+    "Unsigned fixed-point conversion.",
+    "x rounded into the unsigned UQm.n format. Arithmetic on the result stays in that format.",
+    arg_help_fixed,
+    "ufixed(300, 8, 0) => 255" },
+  { "fxraw"     , NULL           , builtin_fxraw                  , 1, 1   , 0,
+    "Raw fixed-point word.",
+    "The stored integer of x, i.e. x * 2^n.",
+    arg_help_fxraw,
+    "fxraw(fixed(-0.5, 4, 4)) => -8" },
+
+  { "rand"      , NULL           , builtin_rand                   , 0, 0   , FUNC_IMPURE,
+    "Uniform random number.",
+    "A random number in [0, 1) with every bit of the current precision random.",
+    NULL,
+    NULL },
+  { "randint"   , NULL           , builtin_randint                , 2, 2   , FUNC_IMPURE,
+    "Uniform random integer.",
+    "A random integer in [a, b].",
+    arg_help_randint,
+    "randint(1, 6)" },
+  { "randbits"  , NULL           , builtin_randbits               , 1, 1   , FUNC_IMPURE,
+    "Random bits.",
+    "A random integer in [0, 2^n). Large results are generated by all threads.",
+    arg_help_randbits,
+    "randbits(128)" },
+  { "seed"      , NULL           , builtin_seed                   , 1, 1   , FUNC_IMPURE,
+    "Seed the random number generator.",
+    "No numeric result. The following random numbers are determined by s.",
+    arg_help_seed,
+    "seed(42)" },
 
   { "min"       , NULL           , builtin_min                    , 2, 1000, 0,
     "Minimum of all arguments.",
@@ -1036,12 +2189,23 @@ struct builtin_funcs
     arg_help_variadic_values,
     NULL },
 
-  { "tabulate"  , NULL           , builtin_tabulate               , 2, 1000, FUNC_RAW_ARGS,
+  { "tabulate"  , NULL           , builtin_tabulate               , 2, 1000, FUNC_FN_ARG,
     "Print a table of a unary function applied to each following argument expression.",
     "No numeric result. The table is printed directly.",
     arg_help_tabulate,
     "tabulate(sqrt, 1, 4, 9, 16)" },
 
+  { "diff"      , NULL           , builtin_diff                   , 2, 1000, FUNC_FN_ARG,
+    "Derivative of a function, computed exactly with dual numbers.",
+    "The derivative of f with respect to its first argument at x.",
+    arg_help_diff,
+    "diff(sin, 0) => 1" },
+  { "grad"      , NULL           , builtin_grad                   , 2, 1000, FUNC_FN_ARG,
+    "Print the gradient of a function, computed exactly with dual numbers.",
+    "No numeric result. The partial derivatives are printed directly.",
+    arg_help_grad,
+    "grad(hypot, 3, 4)" },
+
   { NULL        , NULL           , NULL                           , 0, 0   , 0,
     NULL,
     NULL,
@@ -1068,7 +2232,7 @@ _initbuiltin(void)
 
 
 void
-user_newfun(char *name, namelist_t nl, ast_t a)
+user_newfun(char *name, namelist_t nl, ast_t a, int flags)
 {
 	func_t fn;
 	namelist_t p;
@@ -1078,8 +2242,20 @@ user_newfun(char *name, namelist_t nl, ast_t a)
 	for (p = nl; p != NULL; p = p->next)
 		++i;
 
-	if ((fn = funlookup(name, 0)) != NULL) {
+	/* calls that cached the old definition, or its absence, look again */
+	++fun_gen;
+
+	if ((fn = funlookup(name, 0)) != NULL && fn->builtin) {
+		/* a builtin that was folded into code is being replaced */
+		fold_invalidate();
+	} else if (fn != NULL) {
+		  if (fn->code != NULL)
+			  vm_code_delete(fn->code);
+		  if (fn->memo != NULL)
+			  fmemo_delete(fn->memo);
 		  ast_delete(fn->ast);
+		  if (fn->folded != NULL)
+			  ast_delete(fn->folded);
 		  namelist_delete(fn->namelist);
 	} else {
 		fn = funlookup(name, 1);
@@ -1090,12 +2266,16 @@ user_newfun(char *name, namelist_t nl, ast_t a)
 	fn->fn = NULL;
 	fn->minargs = fn->maxargs = i;
 	fn->builtin = 0;
-	fn->flags = 0;
+	fn->flags = flags;
 
 	fn->namelist = nl;
 	fn->ast = a;
+	fn->folded = NULL;
+	fn->code = (a != NULL) ? vm_compile(a, nl) : NULL;
+	fn->memo = (flags & FUNC_MEMO) ? fmemo_new() : NULL;
 
-	printf("Defined function '%s'\n", name);
+	printf("Defined %sfunction '%s'\n", (flags & FUNC_MEMO) ? "memo " : "",
+	    name);
 }
 
 
@@ -1116,6 +2296,7 @@ int
 funinit(void)
 {
 	funtbl = hashtable_new(9901, NULL, funhashdtor);
+	memo_init(&memo_fr, MEMO_SIZE, MEMO_MAX, memo_fr_release);
 	_initbuiltin();
 
 	return 0;
@@ -1232,7 +2413,8 @@ funlist(void)
 	for (n = 0; n < i.count; n++) {
 		f = funlookup(i.s[n], 0);
 		printf("%s%*s%s\n", i.s[n], maxlen-(int)strlen(i.s[n]), "",
-		    f->builtin ? "[builtin]" : "[user-defined]");
+		    f->builtin ? "[builtin]" :
+		    (f->memo != NULL) ? "[user-defined, memo]" : "[user-defined]");
 	}
 }
 
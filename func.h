@@ -27,6 +27,8 @@
  * SUCH DAMAGE.
  */
 
+struct fmemo_ent;
+
 typedef num_t(*builtin_func_t) (void *, const char *, int, num_t *);
 
 typedef int (*mpfr_fun_one_arg_t) (mpfr_t, mpfr_t, mpfr_rnd_t);
@@ -37,10 +39,8 @@ typedef int (*mpfr_fun_two_arg_ul_t) (mpfr_t, mpfr_t, unsigned long,
 
 typedef void (*mpz_fun_one_arg_t) (mpz_t, mpz_t);
 typedef void (*mpz_fun_one_arg_ul_t) (mpz_t, unsigned long);
-typedef mp_bitcnt_t (*mpz_fun_one_arg_bitcnt_t) (mpz_t);
 typedef void (*mpz_fun_two_arg_t) (mpz_t, mpz_t, mpz_t);
 typedef void (*mpz_fun_two_arg_ul_t) (mpz_t, mpz_t, unsigned long);
-typedef mp_bitcnt_t (*mpz_fun_two_arg_bitcnt_t) (mpz_t, mpz_t);
 
 typedef struct func
 {
@@ -53,17 +53,37 @@ typedef struct func
 
 	namelist_t namelist;
 	ast_t ast;
+	ast_t folded;		/* ast with its constants folded, for vm off */
+	unsigned long folded_gen;	/* fold_gen when folded */
+	struct vm_code *code;
+	struct fmemo *memo;	/* result cache of a memo function */
 } *func_t;
 
 
 
+extern unsigned long fun_gen;
+
 int funinit(void);
 func_t funlookup(const char *s, int alloc);
 num_t call_fun(const char *s, explist_t l, hashtable_t vartbl);
+func_t fun_resolve(astcall_t ac);
+num_t call_ast(astcall_t ac, hashtable_t vartbl);
+int fun_check_args(func_t fn, const char *s, int nargs);
+int fun_enter(void);
+void fun_leave(void);
+num_t fun_apply(func_t fn, const char *s, int nargs, num_t *args);
+num_t fun_apply_fnarg(func_t fn, const char *s, ast_t fnarg, int nargs,
+    num_t *args);
+num_t fun_memo_get(func_t fn, int nargs, num_t *args,
+    struct fmemo_ent **key);
+void fun_memo_put(func_t fn, struct fmemo_ent *key, num_t r);
 void funlist(void);
 void funhelp(const char *name);
+void memo_stats(void);
 
 void fun_iterate(void *priv, var_it_fn fn);
-void user_newfun(char *name, namelist_t nl, ast_t a);
+void user_newfun(char *name, namelist_t nl, ast_t a, int flags);
 
-#define FUNC_RAW_ARGS	0x01
+#define FUNC_FN_ARG	0x01	/* first argument names a function */
+#define FUNC_IMPURE	0x02	/* has side effects, or a different result each call */
+#define FUNC_MEMO	0x04	/* user function whose results are cached */
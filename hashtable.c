@@ -116,6 +116,9 @@ hashtable_lookup(hashtable_t tbl, const char *needle, int alloc)
 static void
 _hashtable_delete(hashtable_t tbl, hashobj_t obj, unsigned int idx)
 {
+	if (obj == tbl->table[idx])
+		tbl->table[idx] = obj->next;
+
 	if (obj->prev != NULL)
 		obj->prev->next = obj->next;
 
@@ -129,9 +132,6 @@ _hashtable_delete(hashtable_t tbl, hashobj_t obj, unsigned int idx)
 	obj->str = NULL;
 
 	free(obj);
-
-	if (obj == tbl->table[idx])
-		tbl->table[idx] = NULL;
 }
 
 
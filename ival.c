@@ -0,0 +1,844 @@
+/*
+ * Copyright (c) 2026 Alex Hornung <alex@alexhornung.com>.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in
+ *    the documentation and/or other materials provided with the
+ *    distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE
+ * COPYRIGHT HOLDERS OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ * BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED
+ * AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT
+ * OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <assert.h>
+
+#include <gmp.h>
+#include <mpfr.h>
+
+#include "hashtable.h"
+
+#include "optype.h"
+#include "num.h"
+#include "var.h"
+#include "ast.h"
+#include "calc.h"
+#include "safe_mem.h"
+#include "fixed.h"
+#include "func.h"
+#include "ival.h"
+#include "fold.h"
+
+/*
+ * Interval arithmetic. In interval mode, every result that is not an
+ * exact integer is an interval whose bounds are rounded outwards, so it
+ * is guaranteed to contain the exact result, and only the digits the
+ * interval certifies are printed. Plain floating point operands are
+ * taken to be exact.
+ */
+int ival_mode = 0;
+
+enum ival_kind
+{
+	IVAL_MONO,	/* monotonic over its domain */
+	IVAL_MIN0,	/* decreasing below 0, increasing above */
+	IVAL_MAX0,	/* increasing below 0, decreasing above */
+	IVAL_POLE0,	/* monotonic on either side of a pole at 0 */
+	IVAL_COS,
+	IVAL_SIN,
+	IVAL_TAN
+};
+
+static const struct ival_fn
+{
+	void *fn;
+	enum ival_kind kind;
+} ival_fns[] = {
+	{ mpfr_sqrt	, IVAL_MONO  },
+	{ mpfr_cbrt	, IVAL_MONO  },
+	{ mpfr_log	, IVAL_MONO  },
+	{ mpfr_log2	, IVAL_MONO  },
+	{ mpfr_log10	, IVAL_MONO  },
+	{ mpfr_exp	, IVAL_MONO  },
+	{ mpfr_asin	, IVAL_MONO  },
+	{ mpfr_acos	, IVAL_MONO  },
+	{ mpfr_atan	, IVAL_MONO  },
+	{ mpfr_sinh	, IVAL_MONO  },
+	{ mpfr_tanh	, IVAL_MONO  },
+	{ mpfr_asinh	, IVAL_MONO  },
+	{ mpfr_acosh	, IVAL_MONO  },
+	{ mpfr_atanh	, IVAL_MONO  },
+	{ mpfr_erf	, IVAL_MONO  },
+	{ mpfr_erfc	, IVAL_MONO  },
+	{ mpfr_abs	, IVAL_MIN0  },
+	{ mpfr_cosh	, IVAL_MIN0  },
+	{ mpfr_sech	, IVAL_MAX0  },
+	{ mpfr_csch	, IVAL_POLE0 },
+	{ mpfr_coth	, IVAL_POLE0 },
+	{ mpfr_cos	, IVAL_COS   },
+	{ mpfr_sin	, IVAL_SIN   },
+	{ mpfr_tan	, IVAL_TAN   },
+};
+
+
+static
+mpfr_prec_t
+ival_prec(num_t a)
+{
+	mpfr_prec_t prec = mpfr_get_default_prec();
+
+	if (a->num_type == NUM_FP && mpfr_get_prec(F(a)) > prec)
+		prec = mpfr_get_prec(F(a));
+	else if (a->num_type == NUM_IVAL && mpfr_get_prec(I(a).lo) > prec)
+		prec = mpfr_get_prec(I(a).lo);
+	else if (a->num_type == NUM_FIXED && X(a).m + X(a).n > prec)
+		prec = X(a).m + X(a).n;
+
+	return prec;
+}
+
+
+static
+num_t
+ival_new(int flags, mpfr_prec_t prec)
+{
+	num_t r;
+
+	r = num_new(flags);
+	r->num_type = NUM_IVAL;
+	mpfr_init2(I(r).lo, prec);
+	mpfr_init2(I(r).hi, prec);
+
+	return r;
+}
+
+
+num_t
+num_new_ival(int flags, num_t b)
+{
+	num_t r;
+
+	if (b == NULL)
+		return ival_new(flags, mpfr_get_default_prec());
+
+	r = ival_new(flags, ival_prec(b));
+
+	switch (b->num_type) {
+	case NUM_INT:
+		mpfr_set_z(I(r).lo, Z(b), MPFR_RNDD);
+		mpfr_set_z(I(r).hi, Z(b), MPFR_RNDU);
+		break;
+
+	case NUM_FP:
+		mpfr_set(I(r).lo, F(b), MPFR_RNDD);
+		mpfr_set(I(r).hi, F(b), MPFR_RNDU);
+		break;
+
+	case NUM_FIXED:
+		num_fixed_set_fr(I(r).lo, b, MPFR_RNDD);
+		num_fixed_set_fr(I(r).hi, b, MPFR_RNDU);
+		break;
+
+	case NUM_IVAL:
+		mpfr_set(I(r).lo, I(b).lo, MPFR_RNDD);
+		mpfr_set(I(r).hi, I(b).hi, MPFR_RNDU);
+		break;
+
+	default:
+		yyxerror("invalid number at num_new_ival!");
+		exit(1);
+	}
+
+	return r;
+}
+
+
+static
+void
+ival_whole(num_t r)
+{
+	mpfr_set_inf(I(r).lo, -1);
+	mpfr_set_inf(I(r).hi, 1);
+}
+
+
+static
+int
+ival_has_zero(num_t a)
+{
+	return (mpfr_sgn(I(a).lo) <= 0 && mpfr_sgn(I(a).hi) >= 0);
+}
+
+
+/*
+ * Widen the bound lo (hi) to include t; a NaN, from an operation outside
+ * of its domain, spreads to the bound.
+ */
+static
+void
+ival_lower(mpfr_t lo, mpfr_t t)
+{
+	if (mpfr_nan_p(t))
+		mpfr_set_nan(lo);
+	else if (!mpfr_nan_p(lo) && mpfr_less_p(t, lo))
+		mpfr_set(lo, t, MPFR_RNDD);
+}
+
+
+static
+void
+ival_upper(mpfr_t hi, mpfr_t t)
+{
+	if (mpfr_nan_p(t))
+		mpfr_set_nan(hi);
+	else if (!mpfr_nan_p(hi) && mpfr_greater_p(t, hi))
+		mpfr_set(hi, t, MPFR_RNDU);
+}
+
+
+/* r = a * b, or a / b if div; the bounds are among the four products */
+static
+void
+ival_mul(num_t r, num_t a, num_t b, int div)
+{
+	int (*op)(mpfr_ptr, mpfr_srcptr, mpfr_srcptr, mpfr_rnd_t);
+	mpfr_ptr x[2] = { I(a).lo, I(a).hi };
+	mpfr_ptr y[2] = { I(b).lo, I(b).hi };
+	mpfr_t t;
+	int i;
+
+	if (div && ival_has_zero(b)) {
+		ival_whole(r);
+		return;
+	}
+
+	op = div ? mpfr_div : mpfr_mul;
+	mpfr_init2(t, mpfr_get_prec(I(r).lo));
+
+	op(I(r).lo, x[0], y[0], MPFR_RNDD);
+	op(I(r).hi, x[0], y[0], MPFR_RNDU);
+	for (i = 1; i < 4; i++) {
+		op(t, x[i >> 1], y[i & 1], MPFR_RNDD);
+		ival_lower(I(r).lo, t);
+		op(t, x[i >> 1], y[i & 1], MPFR_RNDU);
+		ival_upper(I(r).hi, t);
+	}
+
+	mpfr_clear(t);
+}
+
+
+/* Bounds of a monotonic fn over a, from its values at the end points. */
+static
+void
+ival_mono(num_t r, mpfr_fun_one_arg_t fn, num_t a)
+{
+	mpfr_t t;
+
+	mpfr_init2(t, mpfr_get_prec(I(r).lo));
+
+	fn(I(r).lo, I(a).lo, MPFR_RNDD);
+	fn(t, I(a).hi, MPFR_RNDD);
+	ival_lower(I(r).lo, t);
+
+	fn(I(r).hi, I(a).hi, MPFR_RNDU);
+	fn(t, I(a).lo, MPFR_RNDU);
+	ival_upper(I(r).hi, t);
+
+	mpfr_clear(t);
+}
+
+
+/* r = a ** n */
+static
+void
+ival_pow_z(num_t r, num_t a, mpz_t n)
+{
+	num_t p, one;
+	mpz_t m;
+	mpfr_t t;
+
+	if (mpz_sgn(n) == 0) {
+		mpfr_set_ui(I(r).lo, 1, MPFR_RNDD);
+		mpfr_set_ui(I(r).hi, 1, MPFR_RNDU);
+		return;
+	}
+
+	mpz_init(m);
+	mpz_abs(m, n);
+	p = (mpz_sgn(n) > 0) ? r : ival_new(N_TEMP, mpfr_get_prec(I(r).lo));
+
+	if (mpz_odd_p(m) || mpfr_sgn(I(a).lo) >= 0) {
+		mpfr_pow_z(I(p).lo, I(a).lo, m, MPFR_RNDD);
+		mpfr_pow_z(I(p).hi, I(a).hi, m, MPFR_RNDU);
+	} else if (mpfr_sgn(I(a).hi) <= 0) {
+		mpfr_pow_z(I(p).lo, I(a).hi, m, MPFR_RNDD);
+		mpfr_pow_z(I(p).hi, I(a).lo, m, MPFR_RNDU);
+	} else {
+		/* an even power of an interval around 0 */
+		mpfr_init2(t, mpfr_get_prec(I(p).hi));
+		mpfr_set_zero(I(p).lo, 1);
+		mpfr_pow_z(I(p).hi, I(a).hi, m, MPFR_RNDU);
+		mpfr_pow_z(t, I(a).lo, m, MPFR_RNDU);
+		ival_upper(I(p).hi, t);
+		mpfr_clear(t);
+	}
+
+	if (p != r) {
+		one = ival_new(N_TEMP, mpfr_get_prec(I(r).lo));
+		mpfr_set_ui(I(one).lo, 1, MPFR_RNDD);
+		mpfr_set_ui(I(one).hi, 1, MPFR_RNDU);
+		ival_mul(r, one, p, 1);
+	}
+
+	mpz_clear(m);
+}
+
+
+/* Whether b is an exact integer, which is stored in n if so. */
+static
+int
+ival_int_exp(mpz_t n, num_t b)
+{
+	if (b->num_type == NUM_INT) {
+		mpz_set(n, Z(b));
+		return 1;
+	} else if (b->num_type == NUM_FP && mpfr_integer_p(F(b))) {
+		mpfr_get_z(n, F(b), MPFR_RNDN);
+		return 1;
+	} else if (b->num_type == NUM_IVAL && mpfr_integer_p(I(b).lo) &&
+	    mpfr_equal_p(I(b).lo, I(b).hi)) {
+		mpfr_get_z(n, I(b).lo, MPFR_RNDN);
+		return 1;
+	}
+
+	return 0;
+}
+
+
+num_t
+num_ival_two_op(optype_t op_type, num_t a, num_t b)
+{
+	num_t r, ia, ib, t, u;
+	mpfr_prec_t prec;
+	mpz_t n;
+
+	ia = num_new_ival(N_TEMP, a);
+	ib = num_new_ival(N_TEMP, b);
+
+	prec = mpfr_get_prec(I(ia).lo);
+	if (mpfr_get_prec(I(ib).lo) > prec)
+		prec = mpfr_get_prec(I(ib).lo);
+	r = ival_new(N_TEMP, prec);
+
+	switch (op_type) {
+	case OP_ADD:
+		mpfr_add(I(r).lo, I(ia).lo, I(ib).lo, MPFR_RNDD);
+		mpfr_add(I(r).hi, I(ia).hi, I(ib).hi, MPFR_RNDU);
+		break;
+
+	case OP_SUB:
+		mpfr_sub(I(r).lo, I(ia).lo, I(ib).hi, MPFR_RNDD);
+		mpfr_sub(I(r).hi, I(ia).hi, I(ib).lo, MPFR_RNDU);
+		break;
+
+	case OP_MUL:
+		ival_mul(r, ia, ib, 0);
+		break;
+
+	case OP_DIV:
+		ival_mul(r, ia, ib, 1);
+		break;
+
+	case OP_POW:
+		mpz_init(n);
+		if (ival_int_exp(n, b)) {
+			ival_pow_z(r, ia, n);
+		} else if (mpfr_sgn(I(ia).lo) > 0) {
+			/* a ** b = exp(b * ln(a)) */
+			t = ival_new(N_TEMP, prec);
+			u = ival_new(N_TEMP, prec);
+			ival_mono(t, (mpfr_fun_one_arg_t)mpfr_log, ia);
+			ival_mul(u, t, ib, 0);
+			ival_mono(r, (mpfr_fun_one_arg_t)mpfr_exp, u);
+		} else {
+			yyxerror("Interval powers need a positive base or an "
+			    "integer exponent");
+			r = NULL;
+		}
+		mpz_clear(n);
+		break;
+
+	case OP_MOD:
+		yyxerror("Modulo is not supported for intervals");
+		r = NULL;
+		break;
+
+	default:
+		yyxerror("Unknown op in num_ival_two_op");
+		r = NULL;
+	}
+
+	return r;
+}
+
+
+num_t
+num_ival_neg(num_t a)
+{
+	num_t r;
+
+	r = ival_new(N_TEMP, mpfr_get_prec(I(a).lo));
+	mpfr_neg(I(r).lo, I(a).hi, MPFR_RNDD);
+	mpfr_neg(I(r).hi, I(a).lo, MPFR_RNDU);
+
+	return r;
+}
+
+
+/*
+ * Bounds of cos, sin or tan over a. The extrema of cos and sin and the
+ * poles of tan are at (k + s) * pi, with s = 0 for cos and 1/2 for the
+ * others; k is bracketed using bounds on pi, which can only widen the
+ * result.
+ */
+static
+void
+ival_trig(num_t r, num_t a, enum ival_kind kind)
+{
+	mpfr_t pl, ph, kl, ku;
+	mpz_t zl, zu;
+	mpfr_prec_t prec;
+
+	if (!mpfr_number_p(I(a).lo) || !mpfr_number_p(I(a).hi)) {
+		if (kind == IVAL_TAN) {
+			ival_whole(r);
+		} else {
+			mpfr_set_si(I(r).lo, -1, MPFR_RNDD);
+			mpfr_set_si(I(r).hi, 1, MPFR_RNDU);
+		}
+		return;
+	}
+
+	prec = mpfr_get_prec(I(a).lo) + 32;
+	mpfr_inits2(prec, pl, ph, kl, ku, (mpfr_ptr)NULL);
+	mpz_init(zl);
+	mpz_init(zu);
+
+	mpfr_const_pi(pl, MPFR_RNDD);
+	mpfr_const_pi(ph, MPFR_RNDU);
+
+	mpfr_div(kl, I(a).lo, (mpfr_sgn(I(a).lo) >= 0) ? ph : pl, MPFR_RNDD);
+	mpfr_div(ku, I(a).hi, (mpfr_sgn(I(a).hi) >= 0) ? pl : ph, MPFR_RNDU);
+	if (kind != IVAL_COS) {
+		mpfr_sub_d(kl, kl, 0.5, MPFR_RNDD);
+		mpfr_sub_d(ku, ku, 0.5, MPFR_RNDU);
+	}
+	mpfr_get_z(zl, kl, MPFR_RNDU);
+	mpfr_get_z(zu, ku, MPFR_RNDD);
+
+	if (mpz_cmp(zl, zu) <= 0) {
+		mpz_sub(zu, zu, zl);
+		if (kind == IVAL_TAN) {
+			ival_whole(r);
+		} else if (mpz_sgn(zu) > 0) {
+			mpfr_set_si(I(r).lo, -1, MPFR_RNDD);
+			mpfr_set_si(I(r).hi, 1, MPFR_RNDU);
+		} else if (mpz_even_p(zl)) {
+			/* a maximum of 1 at k */
+			mpfr_set_si(I(r).hi, 1, MPFR_RNDU);
+		} else {
+			mpfr_set_si(I(r).lo, -1, MPFR_RNDD);
+		}
+	}
+
+	mpz_clear(zl);
+	mpz_clear(zu);
+	mpfr_clears(pl, ph, kl, ku, (mpfr_ptr)NULL);
+}
+
+
+num_t
+num_ival_fun(const char *s, void *fn, num_t a)
+{
+	const struct ival_fn *f = NULL;
+	mpfr_t zero;
+	num_t r;
+	size_t i;
+
+	for (i = 0; i < sizeof(ival_fns) / sizeof(ival_fns[0]); i++) {
+		if (ival_fns[i].fn == fn) {
+			f = &ival_fns[i];
+			break;
+		}
+	}
+
+	if (f == NULL) {
+		yyxerror("'%s' does not support intervals", s);
+		return NULL;
+	}
+
+	a = num_new_ival(N_TEMP, a);
+	r = ival_new(N_TEMP, mpfr_get_prec(I(a).lo));
+	ival_mono(r, (mpfr_fun_one_arg_t)fn, a);
+
+	mpfr_init2(zero, MPFR_PREC_MIN);
+	mpfr_set_zero(zero, 1);
+
+	switch (f->kind) {
+	case IVAL_MIN0:
+		if (ival_has_zero(a))
+			((mpfr_fun_one_arg_t)fn)(I(r).lo, zero, MPFR_RNDD);
+		break;
+
+	case IVAL_MAX0:
+		if (ival_has_zero(a))
+			((mpfr_fun_one_arg_t)fn)(I(r).hi, zero, MPFR_RNDU);
+		break;
+
+	case IVAL_POLE0:
+		if (ival_has_zero(a))
+			ival_whole(r);
+		break;
+
+	case IVAL_COS:
+	case IVAL_SIN:
+	case IVAL_TAN:
+		ival_trig(r, a, f->kind);
+		break;
+
+	default:
+		break;
+	}
+
+	mpfr_clear(zero);
+	return r;
+}
+
+
+/* For the non-decreasing rounding functions, which are exact here. */
+num_t
+num_ival_fun_nornd(void *fn, num_t a)
+{
+	mpfr_fun_one_arg_nornd_t f = fn;
+	num_t r;
+
+	a = num_new_ival(N_TEMP, a);
+	r = ival_new(N_TEMP, mpfr_get_prec(I(a).lo));
+
+	f(I(r).lo, I(a).lo);
+	f(I(r).hi, I(a).hi);
+
+	return r;
+}
+
+
+/* For root(a, n), which is increasing in a. */
+num_t
+num_ival_fun_ui(void *fn, num_t a, unsigned long n)
+{
+	mpfr_fun_two_arg_ul_t f = fn;
+	num_t r;
+
+	a = num_new_ival(N_TEMP, a);
+	r = ival_new(N_TEMP, mpfr_get_prec(I(a).lo));
+
+	f(I(r).lo, I(a).lo, n, MPFR_RNDD);
+	f(I(r).hi, I(a).hi, n, MPFR_RNDU);
+
+	return r;
+}
+
+
+/* The smallest and largest absolute value in a. */
+static
+void
+ival_abs(mpfr_t mig, mpfr_t mag, num_t a)
+{
+	if (mpfr_cmpabs(I(a).lo, I(a).hi) > 0) {
+		mpfr_abs(mag, I(a).lo, MPFR_RNDU);
+		mpfr_abs(mig, I(a).hi, MPFR_RNDD);
+	} else {
+		mpfr_abs(mag, I(a).hi, MPFR_RNDU);
+		mpfr_abs(mig, I(a).lo, MPFR_RNDD);
+	}
+
+	if (ival_has_zero(a))
+		mpfr_set_zero(mig, 1);
+}
+
+
+num_t
+num_ival_fun2(const char *s, void *fn, num_t a, num_t b)
+{
+	mpfr_t ma, Ma, mb, Mb;
+	mpfr_prec_t prec;
+	num_t r;
+
+	if (fn != (void *)mpfr_hypot) {
+		yyxerror("'%s' does not support intervals", s);
+		return NULL;
+	}
+
+	a = num_new_ival(N_TEMP, a);
+	b = num_new_ival(N_TEMP, b);
+
+	prec = mpfr_get_prec(I(a).lo);
+	if (mpfr_get_prec(I(b).lo) > prec)
+		prec = mpfr_get_prec(I(b).lo);
+	r = ival_new(N_TEMP, prec);
+
+	mpfr_inits2(prec, ma, Ma, mb, Mb, (mpfr_ptr)NULL);
+	ival_abs(ma, Ma, a);
+	ival_abs(mb, Mb, b);
+
+	/* hypot is increasing in the absolute value of either argument */
+	mpfr_hypot(I(r).lo, ma, mb, MPFR_RNDD);
+	mpfr_hypot(I(r).hi, Ma, Mb, MPFR_RNDU);
+
+	mpfr_clears(ma, Ma, mb, Mb, (mpfr_ptr)NULL);
+	return r;
+}
+
+
+static
+int
+ival_const_e(mpfr_t r, mpfr_rnd_t rnd)
+{
+	mpfr_t one;
+	int t;
+
+	mpfr_init_set_si(one, 1, rnd);
+	t = mpfr_exp(r, one, rnd);
+	mpfr_clear(one);
+
+	return t;
+}
+
+
+static
+num_t
+ival_const(int flags, int (*fn)(mpfr_t, mpfr_rnd_t))
+{
+	num_t r;
+
+	r = ival_new(flags, mpfr_get_default_prec());
+	fn(I(r).lo, MPFR_RNDD);
+	fn(I(r).hi, MPFR_RNDU);
+
+	return r;
+}
+
+
+num_t
+num_new_ival_const_pi(int flags)
+{
+	return ival_const(flags, mpfr_const_pi);
+}
+
+
+num_t
+num_new_ival_const_catalan(int flags)
+{
+	return ival_const(flags, mpfr_const_catalan);
+}
+
+
+num_t
+num_new_ival_const_e(int flags)
+{
+	return ival_const(flags, ival_const_e);
+}
+
+
+/* Midpoints stand in for intervals wherever a single value is needed. */
+void
+num_ival_mid(mpfr_t r, num_t a, mpfr_rnd_t rnd)
+{
+	mpfr_add(r, I(a).lo, I(a).hi, rnd);
+	mpfr_div_2ui(r, r, 1, rnd);
+}
+
+
+int
+num_ival_is_zero(num_t a)
+{
+	mpfr_t t;
+	int z;
+
+	mpfr_init2(t, mpfr_get_prec(I(a).lo));
+	num_ival_mid(t, a, MPFR_RNDN);
+	z = mpfr_zero_p(t);
+	mpfr_clear(t);
+
+	return z;
+}
+
+
+void
+num_ival_get_z(mpz_t r, num_t a)
+{
+	mpfr_t t;
+
+	mpfr_init2(t, mpfr_get_prec(I(a).lo) + 1);
+	num_ival_mid(t, a, MPFR_RNDN);
+	mpfr_get_z(r, t, round_mode);
+	mpfr_clear(t);
+}
+
+
+/*
+ * The bounds rounded to n significant digits, if they agree. Every value
+ * in between then rounds to the same digits, so they are the correctly
+ * rounded value of whatever exact result the interval encloses.
+ */
+static
+char *
+ival_digits(num_t a, size_t n, mpfr_exp_t *e)
+{
+	char *sl, *sh;
+	mpfr_exp_t eh;
+
+	sl = mpfr_get_str(NULL, e, 10, n, I(a).lo, MPFR_RNDN);
+	sh = mpfr_get_str(NULL, &eh, 10, n, I(a).hi, MPFR_RNDN);
+	if (sl == NULL || sh == NULL) {
+		yyxerror("ENOMEM");
+		exit(1);
+	}
+
+	if (*e != eh || strcmp(sl, sh) != 0) {
+		mpfr_free_str(sl);
+		sl = NULL;
+	}
+	mpfr_free_str(sh);
+
+	return sl;
+}
+
+
+/*
+ * Prints the digits the interval certifies, or its bounds if there are
+ * none: a bracket [lo, hi] with bounds rounded outwards.
+ */
+char *
+num_ival_str(num_t a, int sci)
+{
+	char *d, *s, *p;
+	mpfr_exp_t e, ew;
+	mpfr_t w, lo, hi;
+	size_t n, len;
+	int neg;
+
+	if (mpfr_zero_p(I(a).lo) && mpfr_zero_p(I(a).hi))
+		return strdup("0");
+
+	d = NULL;
+	if (mpfr_regular_p(I(a).lo) && mpfr_regular_p(I(a).hi) &&
+	    mpfr_sgn(I(a).lo) == mpfr_sgn(I(a).hi)) {
+		n = (size_t)(mpfr_get_prec(I(a).lo) * 0.30103) + 2;
+
+		/* no more digits than the width of the interval allows */
+		if (!mpfr_equal_p(I(a).lo, I(a).hi)) {
+			mpfr_init2(w, 32);
+			mpfr_sub(w, I(a).hi, I(a).lo, MPFR_RNDU);
+			ew = mpfr_get_exp((mpfr_cmpabs(I(a).lo, I(a).hi) > 0) ?
+			    I(a).lo : I(a).hi) - mpfr_get_exp(w);
+			mpfr_clear(w);
+			if (ew < 0)
+				ew = 0;
+			if ((size_t)(ew * 0.30103) + 2 < n)
+				n = (size_t)(ew * 0.30103) + 2;
+		}
+
+		for (; n >= 1 && (d = ival_digits(a, n, &e)) == NULL; n--)
+			;
+	}
+
+	if (d == NULL) {
+		/* the bounds of -0 print as 0 */
+		mpfr_init2(lo, mpfr_get_prec(I(a).lo));
+		mpfr_init2(hi, mpfr_get_prec(I(a).hi));
+		mpfr_set(lo, I(a).lo, MPFR_RNDD);
+		mpfr_set(hi, I(a).hi, MPFR_RNDU);
+		if (mpfr_zero_p(lo))
+			mpfr_set_zero(lo, 1);
+		if (mpfr_zero_p(hi))
+			mpfr_set_zero(hi, 1);
+
+		if (mpfr_asprintf(&p, "[%.6RDg, %.6RUg]", lo, hi) < 0) {
+			yyxerror("ENOMEM");
+			exit(1);
+		}
+		mpfr_clear(lo);
+		mpfr_clear(hi);
+		s = strdup(p);
+		mpfr_free_str(p);
+		return s;
+	}
+
+	neg = (d[0] == '-');
+	p = d + neg;
+	len = strlen(p);
+
+	/* trailing zeros are only significant if the value is not exact */
+	if (mpfr_equal_p(I(a).lo, I(a).hi))
+		while (len > 1 && p[len - 1] == '0')
+			p[--len] = '\0';
+
+	if ((s = malloc(len + 32 + ((e < 0) ? -e : 0))) == NULL) {
+		yyxerror("ENOMEM");
+		exit(1);
+	}
+
+	if (!sci && e > 0 && (size_t)e <= len) {
+		sprintf(s, "%s%.*s%s%s", neg ? "-" : "", (int)e, p,
+		    ((size_t)e < len) ? "." : "", p + e);
+	} else if (!sci && e <= 0 && e > -5) {
+		sprintf(s, "%s0.%.*s%s", neg ? "-" : "", (int)-e, "0000", p);
+	} else {
+		sprintf(s, "%s%c%s%se%+03ld", neg ? "-" : "", p[0],
+		    (len > 1) ? "." : "", p + 1, (long)(e - 1));
+	}
+
+	mpfr_free_str(d);
+	return s;
+}
+
+
+int
+ival_mode_switch(const char *mode)
+{
+	if (strcmp(mode, "on") == 0)
+		ival_mode = 1;
+	else if (strcmp(mode, "off") == 0)
+		ival_mode = 0;
+	else {
+		yyxerror("Unknown interval mode '%s' (expected on or off)",
+		    mode);
+		return -1;
+	}
+
+	varinit_constants();
+	fold_invalidate();
+	return 0;
+}
@@ -0,0 +1,47 @@
+/*
+ * Copyright (c) 2026 Alex Hornung <alex@alexhornung.com>.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in
+ *    the documentation and/or other materials provided with the
+ *    distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE
+ * COPYRIGHT HOLDERS OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ * BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED
+ * AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT
+ * OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+
+extern int ival_mode;
+
+num_t num_new_ival(int flags, num_t b);
+num_t num_ival_two_op(optype_t op_type, num_t a, num_t b);
+num_t num_ival_neg(num_t a);
+num_t num_ival_fun(const char *s, void *fn, num_t a);
+num_t num_ival_fun_nornd(void *fn, num_t a);
+num_t num_ival_fun_ui(void *fn, num_t a, unsigned long n);
+num_t num_ival_fun2(const char *s, void *fn, num_t a, num_t b);
+num_t num_new_ival_const_pi(int flags);
+num_t num_new_ival_const_catalan(int flags);
+num_t num_new_ival_const_e(int flags);
+int num_ival_is_zero(num_t a);
+void num_ival_mid(mpfr_t r, num_t a, mpfr_rnd_t rnd);
+void num_ival_get_z(mpz_t r, num_t a);
+char *num_ival_str(num_t a, int sci);
+
+int ival_mode_switch(const char *mode);
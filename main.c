@@ -30,6 +30,7 @@
 #include <sys/types.h>
 #include <stdarg.h>
 #include <stdio.h>
+#include <stdint.h>
 #include <stdlib.h>
 #include <string.h>
 #include <unistd.h>
@@ -53,6 +54,15 @@
 #include "calc.h"
 #include "func.h"
 #include "safe_mem.h"
+#include "fixed.h"
+#include "ival.h"
+#include "par.h"
+#include "rand.h"
+#include "vm.h"
+#include "fold.h"
+#include "bitops.h"
+#include "cpool.h"
+#include "radix.h"
 #include "calc.tab.h"
 #include "lex.yy.h"
 
@@ -69,11 +79,19 @@ filename_in_home(const char *fname)
 }
 
 
+/* every error is counted; while errors_muted is set, none is printed */
+int nerrors;
+int errors_muted;
+
 void
 yyxerror(const char *s, ...)
 {
 	va_list ap;
 
+	++nerrors;
+	if (errors_muted)
+		return;
+
 	va_start(ap, s);
 
 	fprintf(stderr, "%d: error: ", 0 /* XXX: HACK! */);
@@ -512,7 +530,11 @@ main(int argc, char *argv[])
 
 	varinit();
 	num_init();
+	cpool_init();
 	funinit();
+	par_init();
+	rand_init();
+	bitops_init();
 
 	signal(SIGTERM, sig_handler);
 	signal(SIGQUIT, sig_handler);
@@ -526,6 +548,7 @@ main(int argc, char *argv[])
 		    MAJ_VER, MIN_VER);
 		printf("Copyright (c) 2012-2026 Alex Hornung\n\n");
 
+		abbrev_digits = ABBREV_DEFAULT;
 		load_rc();
 
 		if ((error = linenoiseHistoryLoad(HISTORY_FILE)) == 0) {
@@ -565,6 +588,41 @@ main(int argc, char *argv[])
 static char mode = 'd';
 mpfr_rnd_t round_mode = MPFR_RNDN;
 static int scientific_mode = 0;
+unsigned long abbrev_digits = 0;
+
+struct snprint_sink
+{
+	char *s;
+	size_t sz;
+	size_t len;
+};
+
+
+static
+void
+file_sink(void *priv, const char *s, size_t len)
+{
+	fwrite(s, 1, len, (FILE *)priv);
+}
+
+
+static
+void
+buf_sink(void *priv, const char *s, size_t len)
+{
+	struct snprint_sink *b = priv;
+	size_t n = 0;
+
+	if (b->len + 1 < b->sz) {
+		n = b->sz - 1 - b->len;
+		if (n > len)
+			n = len;
+		memcpy(b->s + b->len, s, n);
+		b->s[b->len + n] = '\0';
+	}
+
+	b->len += len;
+}
 
 void
 mode_switch(char new_mode)
@@ -573,6 +631,32 @@ mode_switch(char new_mode)
 	round_mode = (new_mode == 'd' || new_mode == 's') ? MPFR_RNDN : MPFR_RNDZ;
 	mpfr_set_default_rounding_mode(round_mode);
 	scientific_mode = (new_mode == 's');
+	fold_invalidate();
+}
+
+
+/*
+ * The integer to show abbreviated in place of a, if abbreviation is on
+ * and a is an integer that may well have more than abbrev_digits digits.
+ */
+static
+num_t
+abbrev_int(num_t a)
+{
+	if (abbrev_digits == 0)
+		return NULL;
+
+	if (a->num_type == NUM_INT)
+		return a;
+
+	/* an exponent of 3 bits per digit is below any such value */
+	if (a->num_type == NUM_FP && !scientific_mode &&
+	    mpfr_integer_p(F(a)) && !mpfr_zero_p(F(a)) &&
+	    mpfr_get_exp(F(a)) > 0 &&
+	    (unsigned long)mpfr_get_exp(F(a)) > 3 * abbrev_digits)
+		return num_new_z(N_TEMP, a);
+
+	return NULL;
 }
 
 
@@ -581,7 +665,8 @@ num_print(num_t n)
 {
 	const char *prefix = "";
 	char *s;
-	num_t a;
+	char abbrev[96];
+	num_t a, z;
 	int base;
 
 	switch (mode) {
@@ -593,21 +678,43 @@ num_print(num_t n)
 	default: base = 10; prefix = "";
 	}
 
-	if (base != 10 && n->num_type != NUM_INT)
+	if (base != 10 && n->num_type != NUM_INT && n->num_type != NUM_FIXED)
 		a = num_new_z(N_TEMP, n);
 	else
 		a = n;
 
-	if (a->num_type == NUM_INT) {
+	if ((z = abbrev_int(a)) != NULL &&
+	    radix_abbrev(abbrev, sizeof(abbrev), Z(z), base,
+	    abbrev_digits) >= 0) {
+		printf("%s%s\n", prefix, abbrev);
+	} else if (a->num_type == NUM_INT && base == 10 &&
+	    radix_wants(mpz_sizeinbase(Z(a), 2))) {
+		fputs(prefix, stdout);
+		radix_put_z(Z(a), file_sink, stdout);
+		putchar('\n');
+	} else if (a->num_type == NUM_INT) {
 		if ((s = mpz_get_str(NULL, base, Z(a))) == NULL) {
 			yyxerror("ENOMEM");
 			exit(1);
 		}
 		mpfr_printf("%s%s\n", prefix, s);
 		free(s);
+	} else if (a->num_type == NUM_FIXED) {
+		s = num_fixed_str(a, base);
+		printf("%s%s\n", prefix, s);
+		free(s);
+	} else if (a->num_type == NUM_IVAL) {
+		s = num_ival_str(a, scientific_mode);
+		printf("%s\n", s);
+		free(s);
 	} else if (a->num_type == NUM_FP) {
 		if (scientific_mode) {
 			mpfr_printf("%.6R*G\n", round_mode, F(a));
+		} else if (mpfr_integer_p(F(a)) && !mpfr_zero_p(F(a)) &&
+		    mpfr_get_exp(F(a)) > 0 &&
+		    radix_wants((size_t)mpfr_get_exp(F(a)))) {
+			/* integral, so the conversion to mpz is exact */
+			num_print(num_new_z(N_TEMP, a));
 		} else if (mpfr_integer_p(F(a))) {
 			mpfr_printf("%.0R*f\n", round_mode, F(a));
 		} else {
@@ -624,7 +731,8 @@ num_snprint(char *s, size_t sz, int w, num_t n)
 {
 	const char *prefix = "";
 	char *str;
-	num_t a;
+	char abbrev[96];
+	num_t a, z;
 	int base;
 	int r = 0;
 
@@ -637,12 +745,24 @@ num_snprint(char *s, size_t sz, int w, num_t n)
 	default: base = 10; prefix = "";
 	}
 
-	if (base != 10 && n->num_type != NUM_INT)
+	if (base != 10 && n->num_type != NUM_INT && n->num_type != NUM_FIXED)
 		a = num_new_z(N_TEMP, n);
 	else
 		a = n;
 
-	if (a->num_type == NUM_INT) {
+	if ((z = abbrev_int(a)) != NULL &&
+	    radix_abbrev(abbrev, sizeof(abbrev), Z(z), base,
+	    abbrev_digits) >= 0) {
+		r = snprintf(s, sz, "%s%*s", prefix, w, abbrev);
+	} else if (a->num_type == NUM_INT && base == 10 &&
+	    radix_wants(mpz_sizeinbase(Z(a), 2))) {
+		/* far wider than any field width, so no padding is needed */
+		struct snprint_sink b = { s, sz, 0 };
+
+		buf_sink(&b, prefix, strlen(prefix));
+		radix_put_z(Z(a), buf_sink, &b);
+		r = (int)b.len;
+	} else if (a->num_type == NUM_INT) {
 		if ((str = mpz_get_str(NULL, base, Z(a))) == NULL) {
 			yyxerror("ENOMEM");
 			exit(1);
@@ -656,6 +776,14 @@ num_snprint(char *s, size_t sz, int w, num_t n)
 		default:  r = gmp_snprintf(s, sz, "%s%*Zd", prefix, w, Z(a)); break;
 		}
 		free(str);
+	} else if (a->num_type == NUM_FIXED) {
+		str = num_fixed_str(a, base);
+		r = snprintf(s, sz, "%s%*s", prefix, w, str);
+		free(str);
+	} else if (a->num_type == NUM_IVAL) {
+		str = num_ival_str(a, scientific_mode);
+		r = snprintf(s, sz, "%*s", w, str);
+		free(str);
 	} else if (a->num_type == NUM_FP) {
 		if (scientific_mode) {
 			r = mpfr_snprintf(s, sz, "%*.6R*G", w, round_mode, F(a));
@@ -677,14 +805,25 @@ extern int nallocations;
 void
 go(struct parse_ctx *ctx, ast_t a)
 {
+	struct vm_code *code = NULL;
 	var_t var;
 	num_t ans, old_ans = NULL;
 
 	//printf("Allocations: %d\n", nallocations);
-	ans = eval(a, NULL);
+	if (vm_enabled) {
+		/* ans may be one of the code's constants, so it is kept */
+		code = vm_compile(a, NULL);
+		ans = vm_run(code);
+	} else {
+		a = ast_fold(a, NULL);
+		ans = eval(a, NULL);
+	}
 
-	if (ans == NULL)
+	if (ans == NULL) {
+		if (code != NULL)
+			vm_code_delete(code);
 		return;
+	}
 
 	if (!ctx->silent) {
 		if (isatty(fileno(stdin)))
@@ -696,12 +835,17 @@ go(struct parse_ctx *ctx, ast_t a)
 	if (var->v != NULL)
 		old_ans = var->v;
 
-	var->v = num_new_fp(0, ans);
+	if (ans->num_type == NUM_IVAL)
+		var->v = num_new_ival(0, ans);
+	else
+		var->v = num_new_fp(0, ans);
 
 	if (old_ans != NULL)
 		num_delete(old_ans);
 
 	num_delete_temp();
+	if (code != NULL)
+		vm_code_delete(code);
 	ast_delete(a);
 
 	//printf("Allocations: %d\n", nallocations);
@@ -716,6 +860,9 @@ help(void)
 	printf("\tls\t\t- Lists all variables\n\n");
 
 	printf("\tlsfn\t\t- Lists all functions\n\n");
+	printf("\tcachestats\t- Shows the hit and miss counts of the\n");
+	printf("\t\t\t  builtin function result cache and of each\n");
+	printf("\t\t\t  memo function\n\n");
 
 	printf("\thelp\t\t- Lists available commands\n\n");
 
@@ -727,6 +874,21 @@ help(void)
 	printf("\t\t\t  of the following: b,d,s,h,o,x - for binary, decimal, \n");
 	printf("\t\t\t  scientific decimal, hexadecimal, octal, hexadecimal, \n");
 	printf("\t\t\t  output\n\n");
+	printf("\tfxmode <MODE>\t- Sets the overflow or rounding mode used by new\n");
+	printf("\t\t\t  fixed-point values: sat, wrap (overflow) or\n");
+	printf("\t\t\t  trunc, zero, round, conv (rounding)\n\n");
+	printf("\tinterval <on|off> - Switches interval arithmetic on or\n");
+	printf("\t\t\t  off; results then show only certified digits\n\n");
+	printf("\tmodulus <N|off>\t- Reduces integer +, -, *, ** and inv modulo N\n\n");
+	printf("\tvm <on|off>\t- Runs statements and functions as bytecode (on,\n");
+	printf("\t\t\t  the default) or by walking the syntax tree\n\n");
+	printf("\tdepth <N>\t- Limits how deeply calls between functions may\n");
+	printf("\t\t\t  nest (default 1000000)\n\n");
+	printf("\tthreads <N>\t- Use up to N threads for large multiplies;\n");
+	printf("\t\t\t  0 uses one thread per CPU\n\n");
+	printf("\tabbrev <N>\t- Show integers of more than N digits as their\n");
+	printf("\t\t\t  leading and trailing digits and digit count;\n");
+	printf("\t\t\t  0 shows them in full\n\n");
 	printf("\tquit\t\t- Exits the program\n\n");
 	printf("\texit\t\t- Exits the program\n\n");
 }
@@ -0,0 +1,287 @@
+/*
+ * Copyright (c) 2026 Alex Hornung <alex@alexhornung.com>.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in
+ *    the documentation and/or other materials provided with the
+ *    distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE
+ * COPYRIGHT HOLDERS OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ * BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED
+ * AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT
+ * OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <assert.h>
+
+#include <gmp.h>
+#include <mpfr.h>
+
+#include "hashtable.h"
+
+#include "optype.h"
+#include "num.h"
+#include "var.h"
+#include "ast.h"
+#include "calc.h"
+#include "memo.h"
+
+/*
+ * Result caches, for the mpfr builtins and for memo functions.  Entries
+ * are found by a hash of their arguments taken straight from the limbs,
+ * in buckets of their own, and compared by value with the arguments of
+ * a call.  They are kept on an LRU list; once max of them exist the
+ * least recently used one is evicted.  What an entry holds beyond its
+ * head is up to its cache, which frees it with its release function.
+ */
+
+void
+memo_init(struct memo *m, unsigned int size, unsigned int max,
+    memo_release_t release)
+{
+	memset(m, 0, sizeof(*m));
+
+	if ((m->tbl = calloc(size, sizeof(*m->tbl))) == NULL) {
+		yyxerror("ENOMEM");
+		exit(1);
+	}
+	m->size = size;
+	m->max = max;
+	m->release = release;
+}
+
+
+static
+void
+memo_unlink(struct memo *m, struct memo_ent *ent)
+{
+	if (ent->prev != NULL)
+		ent->prev->next = ent->next;
+	else
+		m->head = ent->next;
+
+	if (ent->next != NULL)
+		ent->next->prev = ent->prev;
+	else
+		m->tail = ent->prev;
+}
+
+
+static
+void
+memo_push(struct memo *m, struct memo_ent *ent)
+{
+	ent->prev = NULL;
+	ent->next = m->head;
+	if (m->head != NULL)
+		m->head->prev = ent;
+	else
+		m->tail = ent;
+	m->head = ent;
+}
+
+
+static
+void
+memo_evict(struct memo *m, struct memo_ent *ent)
+{
+	struct memo_ent **pp;
+
+	for (pp = &m->tbl[ent->hash % m->size]; *pp != ent;
+	    pp = &(*pp)->chain)
+		;
+	*pp = ent->chain;
+
+	memo_unlink(m, ent);
+	--m->count;
+	m->release(ent);
+}
+
+
+void
+memo_clear(struct memo *m)
+{
+	while (m->head != NULL)
+		memo_evict(m, m->head);
+}
+
+
+void
+memo_destroy(struct memo *m)
+{
+	memo_clear(m);
+	free(m->tbl);
+}
+
+
+/*
+ * Returns the entry with the given hash that same() finds to be for
+ * arg, or NULL if there is none.
+ */
+struct memo_ent *
+memo_find(struct memo *m, unsigned long hash, memo_same_t same, void *arg)
+{
+	struct memo_ent *ent;
+
+	for (ent = m->tbl[hash % m->size]; ent != NULL; ent = ent->chain)
+		if (ent->hash == hash && same(ent, arg))
+			return ent;
+
+	return NULL;
+}
+
+
+/* Counts a hit on ent, which becomes the most recently used entry. */
+void
+memo_hit(struct memo *m, struct memo_ent *ent)
+{
+	++m->hits;
+	memo_unlink(m, ent);
+	memo_push(m, ent);
+}
+
+
+void
+memo_add(struct memo *m, struct memo_ent *ent, unsigned long hash)
+{
+	if (m->count == m->max)
+		memo_evict(m, m->tail);
+
+	ent->hash = hash;
+	ent->chain = m->tbl[hash % m->size];
+	m->tbl[hash % m->size] = ent;
+	memo_push(m, ent);
+	++m->count;
+}
+
+
+unsigned long
+memo_hash_fr(unsigned long h, mpfr_t a)
+{
+	const mp_limb_t *d;
+	mp_size_t i, n;
+
+	h = h * 31 + (unsigned long)mpfr_get_prec(a);
+	h = h * 31 + (unsigned long)(mpfr_signbit(a) != 0);
+	if (!mpfr_regular_p(a))
+		return h * 31 + (mpfr_nan_p(a) ? 1 : mpfr_inf_p(a) ? 2 : 3);
+
+	h = h * 31 + (unsigned long)mpfr_get_exp(a);
+	d = mpfr_custom_get_significand(a);
+	n = (mpfr_get_prec(a) + GMP_NUMB_BITS - 1) / GMP_NUMB_BITS;
+	for (i = 0; i < n; i++)
+		h = h * 31 + (unsigned long)d[i];
+
+	return h;
+}
+
+
+/* Whether a and b are the same value, down to the precision. */
+int
+memo_same_fr(mpfr_t a, mpfr_t b)
+{
+	if (mpfr_get_prec(a) != mpfr_get_prec(b) ||
+	    mpfr_signbit(a) != mpfr_signbit(b))
+		return 0;
+
+	if (mpfr_nan_p(a) || mpfr_nan_p(b))
+		return mpfr_nan_p(a) && mpfr_nan_p(b);
+
+	return mpfr_equal_p(a, b);
+}
+
+
+static
+unsigned long
+memo_hash_z(unsigned long h, mpz_t z)
+{
+	size_t i, n;
+
+	h = h * 31 + (unsigned long)(mpz_sgn(z) + 1);
+	n = mpz_size(z);
+	for (i = 0; i < n; i++)
+		h = h * 31 + (unsigned long)mpz_getlimbn(z, i);
+
+	return h;
+}
+
+
+/*
+ * Hashes a together with its type and its precision or fixed-point
+ * format, which memo_same_num() tells apart too.
+ */
+unsigned long
+memo_hash_num(unsigned long h, num_t a)
+{
+	h = h * 31 + (unsigned long)a->num_type;
+
+	switch (a->num_type) {
+	case NUM_INT:
+		return memo_hash_z(h, Z(a));
+
+	case NUM_FIXED:
+		h = h * 31 + (unsigned long)X(a).m;
+		h = h * 31 + (unsigned long)X(a).n;
+		h = h * 31 + (unsigned long)X(a).is_signed;
+		h = h * 31 + (unsigned long)X(a).ovf;
+		h = h * 31 + (unsigned long)X(a).rnd;
+		if (X(a).wide)
+			return memo_hash_z(h, X(a).z);
+		return h * 31 + (unsigned long)(uint64_t)X(a).i;
+
+	case NUM_IVAL:
+		return memo_hash_fr(memo_hash_fr(h, I(a).lo), I(a).hi);
+
+	default:
+		return memo_hash_fr(h, F(a));
+	}
+}
+
+
+int
+memo_same_num(num_t a, num_t b)
+{
+	if (a->num_type != b->num_type)
+		return 0;
+
+	switch (a->num_type) {
+	case NUM_INT:
+		return mpz_cmp(Z(a), Z(b)) == 0;
+
+	case NUM_FIXED:
+		if (X(a).m != X(b).m || X(a).n != X(b).n ||
+		    X(a).is_signed != X(b).is_signed ||
+		    X(a).ovf != X(b).ovf || X(a).rnd != X(b).rnd ||
+		    X(a).wide != X(b).wide)
+			return 0;
+		if (X(a).wide)
+			return mpz_cmp(X(a).z, X(b).z) == 0;
+		return X(a).i == X(b).i;
+
+	case NUM_IVAL:
+		return memo_same_fr(I(a).lo, I(b).lo) &&
+		    memo_same_fr(I(a).hi, I(b).hi);
+
+	default:
+		return memo_same_fr(F(a), F(b));
+	}
+}
@@ -0,0 +1,69 @@
+/*
+ * Copyright (c) 2026 Alex Hornung <alex@alexhornung.com>.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in
+ *    the documentation and/or other materials provided with the
+ *    distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE
+ * COPYRIGHT HOLDERS OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ * BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED
+ * AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT
+ * OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+
+#ifndef _MEMO_H
+#define _MEMO_H
+
+/* The head of an entry, which each cache's own entries start with. */
+struct memo_ent
+{
+	unsigned long hash;
+	struct memo_ent *chain;		/* next in the bucket */
+	struct memo_ent *prev;
+	struct memo_ent *next;
+};
+
+typedef void (*memo_release_t)(struct memo_ent *);
+typedef int (*memo_same_t)(struct memo_ent *, void *);
+
+struct memo
+{
+	struct memo_ent **tbl;
+	struct memo_ent *head, *tail;	/* most and least recently used */
+	unsigned int size;		/* buckets */
+	unsigned int max;		/* entries */
+	unsigned int count;
+	unsigned long hits, misses;
+	memo_release_t release;
+};
+
+void memo_init(struct memo *m, unsigned int size, unsigned int max,
+    memo_release_t release);
+void memo_clear(struct memo *m);
+void memo_destroy(struct memo *m);
+struct memo_ent *memo_find(struct memo *m, unsigned long hash,
+    memo_same_t same, void *arg);
+void memo_hit(struct memo *m, struct memo_ent *ent);
+void memo_add(struct memo *m, struct memo_ent *ent, unsigned long hash);
+unsigned long memo_hash_fr(unsigned long h, mpfr_t a);
+int memo_same_fr(mpfr_t a, mpfr_t b);
+unsigned long memo_hash_num(unsigned long h, num_t a);
+int memo_same_num(num_t a, num_t b);
+
+#endif
@@ -0,0 +1,300 @@
+/*
+ * Copyright (c) 2026 Alex Hornung <alex@alexhornung.com>.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in
+ *    the documentation and/or other materials provided with the
+ *    distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE
+ * COPYRIGHT HOLDERS OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ * BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED
+ * AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT
+ * OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <assert.h>
+
+#include <gmp.h>
+#include <mpfr.h>
+
+#include "hashtable.h"
+
+#include "optype.h"
+#include "num.h"
+#include "var.h"
+#include "ast.h"
+#include "calc.h"
+#include "modn.h"
+#include "fold.h"
+
+/*
+ * Modular arithmetic context. While a modulus N is set, the integer
+ * results of +, -, * and ** are reduced into [0, N), and a negative
+ * power is a power of the inverse. An odd N below 2^63 is
+ * handled in machine words with Montgomery multiplication; any other N
+ * goes through mpz, where mpz_powm does its own Montgomery reduction.
+ */
+int modn_active = 0;
+
+static mpz_t modn;
+static int modn_init;
+
+#ifdef __SIZEOF_INT128__
+#define MODN_WORD
+
+typedef unsigned __int128 u128;
+
+static int modn_word;
+static uint64_t mw_n;		/* N */
+static uint64_t mw_ninv;	/* -N^-1 mod 2^64 */
+static uint64_t mw_r1;		/* 2^64 mod N, i.e. 1 in Montgomery form */
+static uint64_t mw_r2;		/* 2^128 mod N */
+
+
+/* t * 2^-64 mod N, for t < N * 2^64 */
+static inline
+uint64_t
+mw_redc(u128 t)
+{
+	uint64_t m;
+
+	m = (uint64_t)t * mw_ninv;
+	t = (t + (u128)m * mw_n) >> 64;
+
+	return ((uint64_t)t >= mw_n) ? (uint64_t)t - mw_n : (uint64_t)t;
+}
+
+
+static inline
+uint64_t
+mw_mul(uint64_t a, uint64_t b)
+{
+	return mw_redc((u128)a * b);
+}
+
+
+static
+void
+mw_init(void)
+{
+	uint64_t inv;
+	int i;
+
+	modn_word = mpz_sizeinbase(modn, 2) < 64 && mpz_odd_p(modn);
+	if (!modn_word)
+		return;
+
+	mw_n = mpz_get_ui(modn);
+
+	/* Newton's iteration doubles the correct low bits of N^-1 each time */
+	inv = mw_n;
+	for (i = 0; i < 5; i++)
+		inv *= 2 - mw_n * inv;
+	mw_ninv = -inv;
+
+	mw_r1 = -mw_n % mw_n;
+	mw_r2 = (u128)mw_r1 * mw_r1 % mw_n;
+}
+
+
+/* a^e mod N by left-to-right binary exponentiation in Montgomery form */
+static
+uint64_t
+mw_pow(uint64_t a, mpz_t e)
+{
+	uint64_t am, r;
+	size_t i;
+
+	am = mw_mul(a, mw_r2);
+	r = mw_r1;
+
+	for (i = mpz_sizeinbase(e, 2); i-- > 0; ) {
+		r = mw_mul(r, r);
+		if (mpz_tstbit(e, i))
+			r = mw_mul(r, am);
+	}
+
+	return mw_redc(r);
+}
+
+
+static
+num_t
+num_modn_word_op(optype_t op_type, num_t a, num_t b)
+{
+	num_t r;
+	uint64_t x, y;
+
+	x = mpz_fdiv_ui(Z(a), mw_n);
+	y = (op_type == OP_POW) ? 0 : mpz_fdiv_ui(Z(b), mw_n);
+
+	switch (op_type) {
+	case OP_ADD:
+		x += y;
+		if (x >= mw_n)
+			x -= mw_n;
+		break;
+
+	case OP_SUB:
+		x = (x >= y) ? x - y : x + (mw_n - y);
+		break;
+
+	case OP_MUL:
+		/* x * y * 2^-64 * 2^128 * 2^-64 */
+		x = mw_mul(mw_mul(x, y), mw_r2);
+		break;
+
+	case OP_POW:
+		x = mw_pow(x, Z(b));
+		break;
+
+	default:
+		yyxerror("Unknown op in num_modn_two_op");
+		return NULL;
+	}
+
+	r = num_new_z(N_TEMP, NULL);
+	mpz_set_ui(Z(r), x);
+
+	return r;
+}
+#endif
+
+
+num_t
+num_modn_two_op(optype_t op_type, num_t a, num_t b)
+{
+	num_t r;
+
+	assert(a->num_type == NUM_INT && b->num_type == NUM_INT);
+
+	/* a negative power is a power of the inverse */
+	if (op_type == OP_POW && mpz_sgn(Z(b)) < 0) {
+		if ((a = num_modn_inv(a)) == NULL)
+			return NULL;
+		r = num_new_z(N_TEMP, NULL);
+		mpz_neg(Z(r), Z(b));
+		b = r;
+	}
+
+#ifdef MODN_WORD
+	if (modn_word)
+		return num_modn_word_op(op_type, a, b);
+#endif
+
+	r = num_new_z(N_TEMP, NULL);
+
+	switch (op_type) {
+	case OP_ADD:
+		mpz_add(Z(r), Z(a), Z(b));
+		break;
+
+	case OP_SUB:
+		mpz_sub(Z(r), Z(a), Z(b));
+		break;
+
+	case OP_MUL:
+		mpz_mul(Z(r), Z(a), Z(b));
+		break;
+
+	case OP_POW:
+		mpz_powm(Z(r), Z(a), Z(b), modn);
+		return r;
+
+	default:
+		yyxerror("Unknown op in num_modn_two_op");
+		return NULL;
+	}
+
+	mpz_mod(Z(r), Z(r), modn);
+
+	return r;
+}
+
+
+/*
+ * Negation stays exact, like a literal, so that a negative exponent
+ * still means a power of the inverse.
+ */
+num_t
+num_modn_neg(num_t a)
+{
+	num_t r;
+
+	assert(a->num_type == NUM_INT);
+
+	r = num_new_z(N_TEMP, NULL);
+	mpz_neg(Z(r), Z(a));
+
+	return r;
+}
+
+
+num_t
+num_modn_inv(num_t a)
+{
+	num_t r;
+
+	r = num_new_z(N_TEMP, a);
+	if (mpz_invert(Z(r), Z(r), modn) == 0) {
+		yyxerror("Value has no inverse modulo the current modulus");
+		return NULL;
+	}
+
+	return r;
+}
+
+
+int
+modn_switch(const char *mode)
+{
+	mpz_t n;
+
+	if (strcmp(mode, "off") == 0) {
+		modn_active = 0;
+		fold_invalidate();
+		return 0;
+	}
+
+	mpz_init(n);
+	if (mpz_set_str(n, mode, 0) != 0 || mpz_cmp_ui(n, 1) <= 0) {
+		yyxerror("Invalid modulus '%s' (expected an integer above 1 "
+		    "or off)", mode);
+		mpz_clear(n);
+		return -1;
+	}
+
+	if (!modn_init) {
+		mpz_init(modn);
+		modn_init = 1;
+	}
+	mpz_swap(modn, n);
+	mpz_clear(n);
+	modn_active = 1;
+
+#ifdef MODN_WORD
+	mw_init();
+#endif
+
+	fold_invalidate();
+	return 0;
+}
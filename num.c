@@ -28,7 +28,9 @@
  */
 
 #include <ctype.h>
+#include <limits.h>
 #include <stdio.h>
+#include <stdint.h>
 #include <stdlib.h>
 #include <string.h>
 #include <unistd.h>
@@ -45,6 +47,10 @@
 #include "ast.h"
 #include "calc.h"
 #include "safe_mem.h"
+#include "fixed.h"
+#include "ival.h"
+#include "modn.h"
+#include "bigz.h"
 
 void
 num_delete(num_t a)
@@ -59,6 +65,26 @@ num_delete_temp(void)
 	free_safe_mem_bucket(BUCKET_NUM_TEMP);
 }
 
+
+/*
+ * Temporaries normally live until the end of the statement.  A loop
+ * takes num_temp_mark() when it starts, and after every iteration
+ * num_temp_release() frees the temporaries made since, except for the
+ * values in keep that later iterations still need.
+ */
+num_t
+num_temp_mark(void)
+{
+	return safe_mem_last(BUCKET_NUM_TEMP);
+}
+
+
+void
+num_temp_release(num_t mark, void **keep, int nkeep)
+{
+	free_safe_mem_since(BUCKET_NUM_TEMP, mark, keep, nkeep);
+}
+
 static
 int
 num_is_z(num_t a)
@@ -91,6 +117,12 @@ num_prec(num_t a)
 		return 2048;
 	} else if (a != NULL && a->num_type == NUM_FP) {
 		return mpfr_get_prec(F(a));
+	} else if (a != NULL && a->num_type == NUM_FIXED) {
+		/* enough to hold any value of the format exactly */
+		prec = X(a).m + X(a).n;
+		return (prec > MPFR_PREC_MIN) ? prec : MPFR_PREC_MIN;
+	} else if (a != NULL && a->num_type == NUM_IVAL) {
+		return mpfr_get_prec(I(a).lo);
 	} else {
 		return mpfr_get_default_prec();
 	}
@@ -129,6 +161,10 @@ num_new_z_or_fp(int flags, num_t b)
 
 	if (b->num_type == NUM_INT)
 		return num_new_z(flags, b);
+	else if (b->num_type == NUM_FIXED)
+		return num_new_fixed(flags, b);
+	else if (b->num_type == NUM_IVAL)
+		return num_new_ival(flags, b);
 	else
 		return num_new_fp(flags, b);
 }
@@ -148,6 +184,10 @@ num_new_z(int flags, num_t b)
 			mpz_set(Z(r), Z(b));
 		else if (b->num_type == NUM_FP)
 			mpfr_get_z(Z(r), F(b), round_mode);
+		else if (b->num_type == NUM_FIXED)
+			num_fixed_get_z(Z(r), b);
+		else if (b->num_type == NUM_IVAL)
+			num_ival_get_z(Z(r), b);
 	}
 
 	return r;
@@ -173,137 +213,269 @@ num_new_fp(int flags, num_t b)
 			mpfr_set_z(F(r), Z(b), round_mode);
 		else if (b->num_type == NUM_FP)
 			mpfr_set(F(r), F(b), round_mode);
+		else if (b->num_type == NUM_FIXED)
+			num_fixed_set_fr(F(r), b, round_mode);
+		else if (b->num_type == NUM_IVAL)
+			num_ival_mid(F(r), b, round_mode);
 	}
 
 	return r;
 }
 
 
+/*
+ * Literals are parsed in place, straight from the scanner's buffer: '_'
+ * separators are skipped rather than stripped into a copy, and digit
+ * strings that fit into an unsigned long are accumulated directly instead
+ * of going through mpz_set_str.
+ */
+#define NUM_LIT_BUFSZ		128
+
+/* decimal exponents up to this size are scaled with an exact power of ten */
+#define NUM_LIT_EXACT_EXP	4096
+
 static
-char *
-num_normalize_literal(const char *str)
+unsigned long
+num_lit_digit(char c)
 {
-	size_t i, j, len;
-	char *normalized;
+	if (c >= '0' && c <= '9')
+		return (unsigned long)(c - '0');
+	else
+		return (unsigned long)(tolower((unsigned char)c) - 'a' + 10);
+}
 
-	len = strlen(str);
-	if ((normalized = malloc(len + 1)) == NULL) {
+
+static
+void
+num_lit_set_z(mpz_t z, const char *s, const char *end, int base)
+{
+	char buf[NUM_LIT_BUFSZ], *digits, *d;
+	unsigned long v = 0, dv;
+	const char *c;
+
+	for (c = s; c < end; c++) {
+		if (*c == '_' || *c == '.')
+			continue;
+		dv = num_lit_digit(*c);
+		if (v > (ULONG_MAX - dv) / (unsigned long)base)
+			break;
+		v = v * (unsigned long)base + dv;
+	}
+
+	if (c == end) {
+		mpz_set_ui(z, v);
+		return;
+	}
+
+	/* too wide for a machine word */
+	if ((size_t)(end - s) < sizeof(buf)) {
+		digits = buf;
+	} else if ((digits = malloc((size_t)(end - s) + 1)) == NULL) {
 		yyxerror("ENOMEM");
 		exit(1);
 	}
 
-	for (i = 0, j = 0; i < len; ++i) {
-		if (str[i] != '_')
-			normalized[j++] = str[i];
+	for (c = s, d = digits; c < end; c++) {
+		if (*c != '_' && *c != '.')
+			*d++ = *c;
 	}
-	normalized[j] = '\0';
+	*d = '\0';
+
+	if (mpz_set_str(z, digits, base) != 0)
+		yyxerror("mpz_set_str");
 
-	return normalized;
+	if (digits != buf)
+		free(digits);
 }
 
-num_t
-num_new_from_str(int flags, numtype_t typehint, char *str)
+
+static
+long
+num_lit_si_exp(char c)
+{
+	switch (c) {
+	case 'k':	return 3;
+	case 'M':	return 6;
+	case 'G':	return 9;
+	case 'T':	return 12;
+	case 'P':	return 15;
+	case 'E':	return 18;
+	case 'm':	return -3;
+	case 'u':	return -6;
+	case 'n':	return -9;
+	case 'p':	return -12;
+	case 'f':	return -15;
+	case 'a':	return -18;
+	default:
+		yyxerror("Unknown suffix");
+		exit(1);
+	}
+}
+
+
+/*
+ * A decimal literal is mantissa * 10^exp, where the exponent collects
+ * the fraction digits, the E part and the SI suffix. Both factors are
+ * exact integers, so the value is rounded only once, in direction rnd.
+ */
+static
+void
+num_lit_set_fr(mpfr_t f, const char *s, mpfr_rnd_t rnd)
+{
+	const char *c, *mend;
+	long exp = 0, e = 0;
+	int frac = 0, neg = 0;
+	mpz_t m, p;
+	mpfr_t t, u;
+	mpfr_rnd_t urnd;
+
+	for (c = s; isdigit((unsigned char)*c) || *c == '_' || *c == '.'; c++) {
+		if (*c == '.')
+			frac = 1;
+		else if (frac && *c != '_')
+			--exp;
+	}
+	mend = c;
+
+	/* an E on its own is the exa suffix */
+	if ((*c == 'e' || *c == 'E') && *(c + 1) != '\0') {
+		++c;
+		if (*c == '-' || *c == '+')
+			neg = (*c++ == '-');
+		for (; isdigit((unsigned char)*c) || *c == '_'; c++) {
+			if (*c != '_' && e < LONG_MAX / 20)
+				e = e * 10 + (*c - '0');
+		}
+		exp += neg ? -e : e;
+	}
+
+	if (*c != '\0')
+		exp += num_lit_si_exp(*c);
+
+	mpz_init(m);
+	num_lit_set_z(m, s, mend, 10);
+
+	mpz_init(p);
+	mpfr_init2(t, (mpz_sizeinbase(m, 2) < MPFR_PREC_MIN) ?
+	    MPFR_PREC_MIN : (mpfr_prec_t)mpz_sizeinbase(m, 2));
+	mpfr_set_z(t, m, rnd);
+
+	if (mpz_sgn(m) == 0 || exp == 0) {
+		mpfr_set(f, t, rnd);
+	} else if (exp > 0 && exp <= NUM_LIT_EXACT_EXP) {
+		mpz_ui_pow_ui(p, 10UL, (unsigned long)exp);
+		mpfr_mul_z(f, t, p, rnd);
+	} else if (exp < 0 && -exp <= NUM_LIT_EXACT_EXP) {
+		mpz_ui_pow_ui(p, 10UL, (unsigned long)-exp);
+		mpfr_div_z(f, t, p, rnd);
+	} else {
+		/*
+		 * Far out of range of any sensible precision; let MPFR scale
+		 * with a power of ten carrying plenty of guard bits.
+		 */
+		urnd = rnd;
+		if (exp < 0 && rnd == MPFR_RNDD)
+			urnd = MPFR_RNDU;
+		else if (exp < 0 && rnd == MPFR_RNDU)
+			urnd = MPFR_RNDD;
+
+		mpfr_init2(u, mpfr_get_prec(f) + 64);
+		mpfr_ui_pow_ui(u, 10UL, (unsigned long)((exp < 0) ? -exp : exp),
+		    urnd);
+		if (exp < 0)
+			mpfr_div(f, t, u, rnd);
+		else
+			mpfr_mul(f, t, u, rnd);
+		mpfr_clear(u);
+	}
+
+	mpfr_clear(t);
+	mpz_clear(p);
+	mpz_clear(m);
+}
+
+
+/*
+ * Parses a literal into z (integers) or f (everything else), initializing
+ * only the one that is used, and returns the type of the literal. If hi
+ * is not NULL, a literal that is not an integer is enclosed in [f, hi]
+ * instead, and NUM_IVAL is returned.
+ */
+static
+numtype_t
+num_parse_lit(numtype_t typehint, const char *str, mpz_t z, mpfr_t f,
+    mpfr_t hi)
 {
 	numtype_t type = typehint;
-	double exp;
-	char *normalized, *suffix, *s;
-	int base, type_override, r;
-	num_t n;
+	const char *s;
+	int base;
 
-	normalized = num_normalize_literal(str);
-	str = normalized;
-	n = num_new(flags);
+	base = 10;
+	if (str[0] == '0' && (str[1] == 'x' || str[1] == 'X')) {
+		base = 16;
+		str += 2;
+	} else if (str[0] == '0' && (str[1] == 'b' || str[1] == 'B')) {
+		base = 2;
+		str += 2;
+	} else if (str[0] == '0' && str[1] == 'd') {
+		str += 2;
+	} else if (typehint == NUM_INT && str[0] == '0') {
+		base = 8;
+		str += 1;
+	}
 
 	/*
 	 * If it's a decimal number but it doesn't have a floating point, suffix, etc
 	 * treat it as an integer.
 	 */
-	type_override = 1;
 	if (typehint == NUM_FP) {
-		s = (str[1] == 'd') ? str + 2 : str;
-		while (*s != '\0') {
-			if (!isdigit(*s++)) {
-				type_override = 0;
-				break;
-			}
-		}
-
-		if (type_override)
+		for (s = str; isdigit((unsigned char)*s) || *s == '_'; s++)
+			;
+		if (*s == '\0')
 			type = NUM_INT;
 	}
 
-	n->num_type = type;
+	if (type == NUM_INT) {
+		mpz_init(z);
+		num_lit_set_z(z, str, str + strlen(str), base);
+	} else if (hi != NULL) {
+		mpfr_init(f);
+		mpfr_init(hi);
+		num_lit_set_fr(f, str, MPFR_RNDD);
+		num_lit_set_fr(hi, str, MPFR_RNDU);
+		type = NUM_IVAL;
+	} else {
+		mpfr_init(f);
+		num_lit_set_fr(f, str, round_mode);
+	}
 
-	base = 0;
+	return type;
+}
 
-	if (str[1] == 'd') {
-		base = 10;
-		str += 2;
-	}
 
-	if (type == NUM_INT) {
-		if ((r = mpz_init_set_str(Z(n), str, base)) != 0) {
-			yyxerror("mpz_init_set_str");
-			mpz_clear(Z(n));
-		}
-	} else {
-		if (str[1] == 'd')
-			str += 2;
+numtype_t
+num_parse_literal(numtype_t typehint, const char *str, mpz_t z, mpfr_t f)
+{
+	return num_parse_lit(typehint, str, z, f, NULL);
+}
 
-		mpfr_init(F(n));
-		r = mpfr_strtofr(F(n), str, &suffix, 0, round_mode);
 
-		/*
-		 * XXX: add support for IEC binary prefixes?
-		 */
-		if (*suffix != '\0') {
-			switch (*suffix) {
-			case 'k':
-				exp = 1000;
-				break;
-			case 'M':
-				exp = 1000000;
-				break;
-			case 'G':
-				exp = 1000000000;
-				break;
-			case 'T':
-				exp = 1000000000000;
-				break;
-			case 'P':
-				exp = 1000000000000000;
-				break;
-			case 'E':
-				exp = 1000000000000000000;
-				break;
-			case 'm':
-				exp = 0.001;
-				break;
-			case 'u':
-				exp = 0.000001;
-				break;
-			case 'n':
-				exp = 0.000000001;
-				break;
-			case 'p':
-				exp = 0.000000000001;
-				break;
-			case 'f':
-				exp = 0.000000000000001;
-				break;
-			case 'a':
-				exp = 0.000000000000000001;
-				break;
-			default:
-				yyxerror("Unknown suffix");
-				exit(1);
-			}
+numtype_t
+num_parse_literal_ival(numtype_t typehint, const char *str, mpz_t z,
+    mpfr_t lo, mpfr_t hi)
+{
+	return num_parse_lit(typehint, str, z, lo, hi);
+}
 
-			mpfr_mul_d(F(n), F(n), exp, round_mode);
-		}
-	}
 
-	free(normalized);
+num_t
+num_new_from_str(int flags, numtype_t typehint, const char *str)
+{
+	num_t n;
+
+	n = num_new(flags);
+	n->num_type = num_parse_literal(typehint, str, Z(n), F(n));
+
 	return n;
 }
 
@@ -374,6 +546,14 @@ num_is_zero(num_t a)
 		nz = mpfr_cmp_si(F(a), 0);
 		break;
 
+	case NUM_FIXED:
+		nz = !num_fixed_is_zero(a);
+		break;
+
+	case NUM_IVAL:
+		nz = !num_ival_is_zero(a);
+		break;
+
 	default:
 		yyxerror("invalid number at num_is_zero!");
 		exit(1);
@@ -450,7 +630,7 @@ num_int_one_op(optype_t op_type, num_t a)
 			    ("Argument to factorial needs to fit into an unsigned long C datatype");
 			return NULL;
 		}
-		mpz_fac_ui(Z(r), mpz_get_ui(Z(a)));
+		bigz_fac(Z(r), mpz_get_ui(Z(a)));
 		break;
 
 	default:
@@ -461,18 +641,17 @@ num_int_one_op(optype_t op_type, num_t a)
 }
 
 
-num_t
-num_int_part_sel(pseltype_t op_type, num_t hi, num_t lo, num_t a)
+/*
+ * Resolves the indices of a part select into the position of its least
+ * significant bit and its width in bits. A descending range [hi-:cnt]
+ * of zero bits yields a zero width.
+ */
+static
+int
+psel_range(pseltype_t op_type, num_t hi, num_t lo, unsigned long *lo_ui,
+    unsigned long *width)
 {
-	num_t r, m;
-	unsigned long mask_shl, lo_ui;
-
-	r = num_new_z(N_TEMP, NULL);
-	m = num_new_z(N_TEMP, NULL);
-	a = num_new_z(N_TEMP, a);
 	hi = num_new_z(N_TEMP, hi);
-	if (lo != NULL)
-		lo = num_new_z(N_TEMP, lo);
 
 	switch (op_type) {
 	case PSEL_SINGLE:
@@ -480,13 +659,15 @@ num_int_part_sel(pseltype_t op_type, num_t hi, num_t lo, num_t a)
 		break;
 
 	case PSEL_FRANGE:
+		lo = num_new_z(N_TEMP, lo);
 		break;
 
 	case PSEL_DRANGE:
+		lo = num_new_z(N_TEMP, lo);
 		if (mpz_cmp_si(Z(lo), 0L) < 0) {
 			yyxerror("low index of part select operation must be "
 			    "positive");
-			return NULL;
+			return -1;
 		}
 		mpz_sub_ui(Z(lo), Z(lo), 1UL);
 		mpz_sub(Z(lo), Z(hi), Z(lo));
@@ -496,41 +677,220 @@ num_int_part_sel(pseltype_t op_type, num_t hi, num_t lo, num_t a)
 	if (mpz_cmp_si(Z(hi), 0L) < 0) {
 		yyxerror("high index of part select operation must be "
 		    "positive");
-		return NULL;
+		return -1;
 	}
 
 	if (mpz_cmp_si(Z(lo), 0L) < 0) {
 		yyxerror("low index of part select operation must be "
 		    "positive");
-		return NULL;
+		return -1;
 	}
 
-	if (!mpz_fits_ulong_p(Z(hi))) {
+	if (!mpz_fits_ulong_p(Z(hi)) || mpz_get_ui(Z(hi)) == ULONG_MAX) {
 		yyxerror("high index of part select operation needs to fit "
 		    "into an unsigned long C datatype");
-		return NULL;
+		return -1;
 	}
 
 	if (!mpz_fits_ulong_p(Z(lo))) {
 		yyxerror("low index of part select operation needs to fit "
 		    "into an unsigned long C datatype");
-		return NULL;
+		return -1;
 	}
 
-	lo_ui = mpz_get_ui(Z(lo));
-	mask_shl = 1 + (mpz_get_ui(Z(hi)) - lo_ui);
+	*lo_ui = mpz_get_ui(Z(lo));
 
-	/*
-	 * We do the part sel by:
-	 *  (1) shifting right by 'lo'
-	 *  (2) anding with ((1 << mask_shl)-1)
-	 */
-	mpz_div_2exp(Z(r), Z(a), lo_ui);
-	mpz_set_ui(Z(m), 1UL);
-	mpz_mul_2exp(Z(m), Z(m), mask_shl);
-	mpz_sub_ui(Z(m), Z(m), 1UL);
+	if (mpz_cmp(Z(hi), Z(lo)) >= 0) {
+		*width = mpz_get_ui(Z(hi)) - *lo_ui + 1;
+	} else if (op_type == PSEL_DRANGE) {
+		*width = 0;
+	} else {
+		yyxerror("high index of part select operation must not be "
+		    "below the low index");
+		return -1;
+	}
 
-	mpz_and(Z(r), Z(r), Z(m));
+	return 0;
+}
+
+
+/*
+ * Extracts the width bits of a starting at bit lo into r. Non-negative
+ * operands only touch the limbs covering the field; negative ones are
+ * handled with two's complement semantics through floor division.
+ */
+static
+void
+psel_extract(mpz_ptr r, mpz_srcptr a, unsigned long lo, unsigned long width)
+{
+	const mp_limb_t *ap;
+	mp_limb_t *rp;
+	size_t an, li, sn, rn;
+	unsigned int sh;
+
+	if (width == 0) {
+		mpz_set_ui(r, 0UL);
+		return;
+	}
+
+	if (mpz_sgn(a) < 0) {
+		mpz_fdiv_q_2exp(r, a, lo);
+		mpz_fdiv_r_2exp(r, r, width);
+		return;
+	}
+
+	an = mpz_size(a);
+	li = lo / GMP_NUMB_BITS;
+	sh = lo % GMP_NUMB_BITS;
+
+	if (li >= an) {
+		mpz_set_ui(r, 0UL);
+		return;
+	}
+
+	/* source limbs spanned by the field, and limbs of the result */
+	sn = (width - 1) / GMP_NUMB_BITS +
+	    ((width - 1) % GMP_NUMB_BITS + sh) / GMP_NUMB_BITS + 1;
+	if (sn > an - li)
+		sn = an - li;
+	rn = (width - 1) / GMP_NUMB_BITS + 1;
+	if (rn > sn)
+		rn = sn;
+
+	ap = mpz_limbs_read(a);
+	rp = mpz_limbs_write(r, sn);
+
+	if (sh != 0)
+		mpn_rshift(rp, ap + li, sn, sh);
+	else
+		mpn_copyi(rp, ap + li, sn);
+
+	if (rn == (width - 1) / GMP_NUMB_BITS + 1 &&
+	    width % GMP_NUMB_BITS != 0)
+		rp[rn - 1] &= ((mp_limb_t)1 << (width % GMP_NUMB_BITS)) - 1;
+
+	mpz_limbs_finish(r, rn);
+}
+
+
+/*
+ * Replaces the width bits of a starting at bit lo with the (non-negative,
+ * already truncated) field f. For non-negative a only the limbs covering
+ * the field are written, growing a if the field lies beyond its top.
+ */
+static
+void
+psel_insert(mpz_ptr a, unsigned long lo, unsigned long width, mpz_srcptr f)
+{
+	const mp_limb_t *fp;
+	mp_limb_t *ap, m;
+	size_t an, fn, n, li, hl, i;
+	unsigned int sh, eb;
+	mpz_t t;
+
+	if (width == 0)
+		return;
+
+	if (mpz_sgn(a) < 0) {
+		mpz_init(t);
+		psel_extract(t, a, lo, width);
+		mpz_sub(t, f, t);
+		mpz_mul_2exp(t, t, lo);
+		mpz_add(a, a, t);
+		mpz_clear(t);
+		return;
+	}
+
+	an = mpz_size(a);
+	fn = mpz_size(f);
+	li = lo / GMP_NUMB_BITS;
+	sh = lo % GMP_NUMB_BITS;
+
+	/* nothing to clear and nothing to set */
+	if (fn == 0 && li >= an)
+		return;
+
+	hl = (lo + (width - 1)) / GMP_NUMB_BITS;
+
+	if (fn == 0) {
+		n = an;
+	} else {
+		n = li + fn + 1;
+		if (n > hl + 1)
+			n = hl + 1;
+		if (n < an)
+			n = an;
+	}
+
+	ap = mpz_limbs_modify(a, n);
+	for (i = an; i < n; i++)
+		ap[i] = 0;
+
+	/* clear the field */
+	eb = (lo + (width - 1)) % GMP_NUMB_BITS + 1;
+	for (i = li; i <= hl && i < n; i++) {
+		m = ~(mp_limb_t)0;
+		if (i == li)
+			m <<= sh;
+		if (i == hl && eb != GMP_NUMB_BITS)
+			m &= ((mp_limb_t)1 << eb) - 1;
+		ap[i] &= ~m;
+	}
+
+	/* and merge in the new value */
+	fp = mpz_limbs_read(f);
+	for (i = 0; i < fn; i++) {
+		ap[li + i] |= fp[i] << sh;
+		if (sh != 0 && li + i + 1 < n)
+			ap[li + i + 1] |= fp[i] >> (GMP_NUMB_BITS - sh);
+	}
+
+	mpz_limbs_finish(a, n);
+}
+
+
+num_t
+num_int_part_sel(pseltype_t op_type, num_t hi, num_t lo, num_t a)
+{
+	num_t r;
+	unsigned long lo_ui, width;
+
+	if (psel_range(op_type, hi, lo, &lo_ui, &width) < 0)
+		return NULL;
+
+	r = num_new_z(N_TEMP, NULL);
+	if (a->num_type != NUM_INT)
+		a = num_new_z(N_TEMP, a);
+
+	psel_extract(Z(r), Z(a), lo_ui, width);
+
+	return r;
+}
+
+
+/*
+ * Writes v into the selected bits of the integer a, in place. The value
+ * is truncated to the width of the field (two's complement for negative
+ * values) and the truncated value is returned.
+ */
+num_t
+num_int_part_set(pseltype_t op_type, num_t hi, num_t lo, num_t a, num_t v)
+{
+	num_t r;
+	unsigned long lo_ui, width;
+
+	assert(a->num_type == NUM_INT);
+
+	if (psel_range(op_type, hi, lo, &lo_ui, &width) < 0)
+		return NULL;
+
+	r = num_new_z(N_TEMP, v);
+	if (width > 0)
+		mpz_fdiv_r_2exp(Z(r), Z(r), width);
+	else
+		mpz_set_ui(Z(r), 0UL);
+
+	psel_insert(Z(a), lo_ui, width, Z(r));
 
 	return r;
 }
@@ -540,21 +900,43 @@ num_t
 num_float_two_op(optype_t op_type, num_t a, num_t b)
 {
 	num_t r, r_z, rem_z, a_z, b_z;
-	int both_z = num_both_z(a, b);
+	int both_z, int_pow;
 
-	r = num_new_fp(N_TEMP, NULL);
-	mpfr_set_prec(F(r), num_max_prec(a, b));
+	if (a->num_type == NUM_IVAL || b->num_type == NUM_IVAL)
+		return num_ival_two_op(op_type, a, b);
 
-	a = num_new_fp(N_TEMP, a);
-	b = num_new_fp(N_TEMP, b);
+	if (a->num_type == NUM_FIXED || b->num_type == NUM_FIXED)
+		return num_fixed_two_op(op_type, a, b);
+
+	both_z = num_both_z(a, b);
+
+	/* in interval mode, whatever is not exact gets bounds */
+	if (ival_mode && !both_z)
+		return num_ival_two_op(op_type, a, b);
 
+	int_pow = (a->num_type == NUM_INT);
+
+	/*
+	 * Take the integer operands before the conversion to floating
+	 * point, which would round integers wider than its precision.
+	 */
 	if (both_z) {
 		r_z = num_new_z(N_TEMP, NULL);
 		rem_z = num_new_z(N_TEMP, NULL);
 		a_z = num_new_z(N_TEMP, a);
 		b_z = num_new_z(N_TEMP, b);
+
+		if (modn_active && (op_type == OP_ADD || op_type == OP_SUB ||
+		    op_type == OP_MUL || op_type == OP_POW))
+			return num_modn_two_op(op_type, a_z, b_z);
 	}
 
+	r = num_new_fp(N_TEMP, NULL);
+	mpfr_set_prec(F(r), num_max_prec(a, b));
+
+	a = num_new_fp(N_TEMP, a);
+	b = num_new_fp(N_TEMP, b);
+
 	switch (op_type) {
 	case OP_ADD:
 		if (both_z) {
@@ -576,7 +958,7 @@ num_float_two_op(optype_t op_type, num_t a, num_t b)
 
 	case OP_MUL:
 		if (both_z) {
-			mpz_mul(Z(r_z), Z(a_z), Z(b_z));
+			bigz_mul(Z(r_z), Z(a_z), Z(b_z));
 			return r_z;
 		} else {
 			mpfr_mul(F(r), F(a), F(b), round_mode);
@@ -584,13 +966,18 @@ num_float_two_op(optype_t op_type, num_t a, num_t b)
 		break;
 
 	case OP_DIV:
-		if (both_z)
-			mpz_divmod(Z(r_z), Z(rem_z), Z(a_z), Z(b_z));
+		/* a zero divisor is left to mpfr, which gives an infinity */
+		if (both_z) {
+			if (mpz_sgn(Z(b_z)) != 0) {
+				mpz_divmod(Z(r_z), Z(rem_z), Z(a_z), Z(b_z));
+				if (num_is_zero(rem_z))
+					return r_z;
+			}
+			if (ival_mode)
+				return num_ival_two_op(op_type, a_z, b_z);
+		}
 
-		if (both_z && num_is_zero(rem_z))
-			return r_z;
-		else
-			mpfr_div(F(r), F(a), F(b), round_mode);
+		mpfr_div(F(r), F(a), F(b), round_mode);
 		break;
 
 	case OP_MOD:
@@ -606,6 +993,14 @@ num_float_two_op(optype_t op_type, num_t a, num_t b)
 		break;
 
 	case OP_POW:
+		/* exact integer powers, unless the result would be huge */
+		if (both_z) {
+			if (int_pow && mpz_fits_ulong_p(Z(b_z)) &&
+			    bigz_pow_ui(Z(r_z), Z(a_z), mpz_get_ui(Z(b_z))) == 0)
+				return r_z;
+			if (ival_mode)
+				return num_ival_two_op(op_type, a_z, b_z);
+		}
 		mpfr_pow(F(r), F(a), F(b), round_mode);
 		break;
 
@@ -658,6 +1053,13 @@ num_float_one_op(optype_t op_type, num_t a)
 {
 	num_t r;
 
+	if (op_type == OP_UMINUS && a->num_type == NUM_FIXED)
+		return num_fixed_neg(a);
+	if (op_type == OP_UMINUS && a->num_type == NUM_IVAL)
+		return num_ival_neg(a);
+	if (op_type == OP_UMINUS && a->num_type == NUM_INT && modn_active)
+		return num_modn_neg(a);
+
 	r = num_new_fp(N_TEMP, NULL);
 	mpfr_set_prec(F(r), num_prec(a));
 
@@ -686,6 +1088,12 @@ num_dtor(int bucket, void *p)
 		mpz_clear(Z(a));
 	else if (a->num_type == NUM_FP)
 		mpfr_clear(F(a));
+	else if (a->num_type == NUM_FIXED && X(a).wide)
+		mpz_clear(X(a).z);
+	else if (a->num_type == NUM_IVAL) {
+		mpfr_clear(I(a).lo);
+		mpfr_clear(I(a).hi);
+	}
 
 	a->num_type = NUM_INVALID;
 }
@@ -31,10 +31,58 @@ typedef enum NUM_TYPE
 {
 	NUM_INVALID = 0,
 	NUM_INT,
-	NUM_FP
+	NUM_FP,
+	NUM_FIXED,
+	NUM_IVAL
 } numtype_t;
 
 
+typedef enum FX_OVF
+{
+	FX_WRAP,
+	FX_SAT
+} fxovf_t;
+
+
+typedef enum FX_RND
+{
+	FX_TRUNC,	/* towards -inf */
+	FX_ZERO,	/* towards zero */
+	FX_ROUND,	/* to nearest, ties towards +inf */
+	FX_CONV		/* to nearest, ties to even (convergent) */
+} fxrnd_t;
+
+
+/*
+ * Fixed-point Qm.n value: m integer bits (including the sign bit for
+ * signed formats) and n fraction bits.  The raw two's complement word
+ * is kept in an int64_t unless the format is too wide for it.
+ */
+struct numfx
+{
+	int m;
+	int n;
+	int is_signed;
+	fxovf_t ovf;
+	fxrnd_t rnd;
+	int wide;
+
+	int64_t i;
+	mpz_t z;
+};
+
+
+/*
+ * Interval [lo, hi] known to contain the exact value, with both bounds
+ * of the same precision.
+ */
+struct numival
+{
+	mpfr_t lo;
+	mpfr_t hi;
+};
+
+
 typedef struct num
 {
 	numtype_t num_type;
@@ -43,6 +91,8 @@ typedef struct num
 	{
 		mpz_t z;
 		mpfr_t f;
+		struct numfx x;
+		struct numival i;
 	} v;
 } *num_t;
 
@@ -51,12 +101,18 @@ typedef struct num
 
 #define F(n) (n->v.f)
 #define Z(n) (n->v.z)
+#define X(n) (n->v.x)
+#define I(n) (n->v.i)
 
 num_t num_new(int flags);
 num_t num_new_z(int flags, num_t b);
 num_t num_new_fp(int flags, num_t b);
 num_t num_new_z_or_fp(int flags, num_t b);
-num_t num_new_from_str(int flags, numtype_t typehint, char *str);
+num_t num_new_from_str(int flags, numtype_t typehint, const char *str);
+numtype_t num_parse_literal(numtype_t typehint, const char *str, mpz_t z,
+    mpfr_t f);
+numtype_t num_parse_literal_ival(numtype_t typehint, const char *str, mpz_t z,
+    mpfr_t lo, mpfr_t hi);
 num_t num_new_const_pi(int flags);
 num_t num_new_const_catalan(int flags);
 num_t num_new_const_e(int flags);
@@ -64,10 +120,13 @@ num_t num_new_const_zero(int flags);
 
 void num_delete(num_t a);
 void num_delete_temp(void);
+num_t num_temp_mark(void);
+void num_temp_release(num_t mark, void **keep, int nkeep);
 
 num_t num_int_two_op(optype_t op_type, num_t a, num_t b);
 num_t num_int_one_op(optype_t op_type, num_t a);
 num_t num_int_part_sel(pseltype_t op_type, num_t hi, num_t lo, num_t a);
+num_t num_int_part_set(pseltype_t op_type, num_t hi, num_t lo, num_t a, num_t v);
 num_t num_float_two_op(optype_t op_type, num_t a, num_t b);
 num_t num_float_one_op(optype_t op_type, num_t a);
 num_t num_cmp(cmptype_t ct, num_t a, num_t b);
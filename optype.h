@@ -52,7 +52,8 @@ typedef enum OP_TYPE
 	OP_CMP,
 	OP_LISTING,
 	OP_FLOW,
-	OP_PSEL
+	OP_PSEL,
+	OP_PSELASSIGN
 } optype_t;
 
 
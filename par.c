@@ -0,0 +1,147 @@
+/*
+ * Copyright (c) 2026 Alex Hornung <alex@alexhornung.com>.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in
+ *    the documentation and/or other materials provided with the
+ *    distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE
+ * COPYRIGHT HOLDERS OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ * BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED
+ * AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT
+ * OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <pthread.h>
+
+#include "par.h"
+
+#define PAR_MAX_THREADS	256
+
+int par_threads = 1;
+
+struct par_job
+{
+	par_fn_t fn;
+	void *arg;
+	size_t n;
+	size_t next;
+	pthread_mutex_t lock;
+};
+
+
+static
+void *
+par_worker(void *p)
+{
+	struct par_job *job = p;
+	size_t i;
+
+	for (;;) {
+		pthread_mutex_lock(&job->lock);
+		i = job->next++;
+		pthread_mutex_unlock(&job->lock);
+
+		if (i >= job->n)
+			break;
+
+		job->fn(job->arg, i);
+	}
+
+	return NULL;
+}
+
+
+/*
+ * Runs fn(arg, i) for every i in [0, n), spread over up to par_threads
+ * threads.  The calling thread takes part and the call returns once all
+ * items are done.  If threads can't be created the remaining work is
+ * simply done by fewer threads.
+ */
+void
+par_run(size_t n, par_fn_t fn, void *arg)
+{
+	pthread_t tids[PAR_MAX_THREADS];
+	struct par_job job;
+	size_t i, nthreads;
+
+	if (n == 0)
+		return;
+
+	if (par_threads <= 1 || n == 1) {
+		for (i = 0; i < n; i++)
+			fn(arg, i);
+		return;
+	}
+
+	job.fn = fn;
+	job.arg = arg;
+	job.n = n;
+	job.next = 0;
+	pthread_mutex_init(&job.lock, NULL);
+
+	nthreads = ((size_t)par_threads < n) ? (size_t)par_threads : n;
+
+	for (i = 0; i < nthreads - 1; i++) {
+		if (pthread_create(&tids[i], NULL, par_worker, &job) != 0)
+			break;
+	}
+	nthreads = i;
+
+	par_worker(&job);
+
+	for (i = 0; i < nthreads; i++)
+		pthread_join(tids[i], NULL);
+
+	pthread_mutex_destroy(&job.lock);
+}
+
+
+/*
+ * Sets the number of worker threads; 0 selects the number of online
+ * CPUs.
+ */
+int
+par_set_threads(long n)
+{
+	if (n < 0)
+		return -1;
+
+	if (n == 0) {
+#ifdef _SC_NPROCESSORS_ONLN
+		n = sysconf(_SC_NPROCESSORS_ONLN);
+#endif
+		if (n < 1)
+			n = 1;
+	}
+
+	par_threads = (n > PAR_MAX_THREADS) ? PAR_MAX_THREADS : (int)n;
+	return 0;
+}
+
+
+void
+par_init(void)
+{
+	par_set_threads(0);
+}
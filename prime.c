@@ -0,0 +1,1010 @@
+/*
+ * Copyright (c) 2026 Alex Hornung <alex@alexhornung.com>.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in
+ *    the documentation and/or other materials provided with the
+ *    distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE
+ * COPYRIGHT HOLDERS OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ * BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED
+ * AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT
+ * OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <limits.h>
+#include <math.h>
+#include <time.h>
+
+#include <gmp.h>
+#include <mpfr.h>
+
+#include "hashtable.h"
+
+#include "optype.h"
+#include "num.h"
+#include "var.h"
+#include "ast.h"
+#include "calc.h"
+#include "par.h"
+#include "prime.h"
+
+/*
+ * Segments hold one bit per odd number and are sized to stay in the L1
+ * cache while all sieving primes stream over them.
+ */
+#define PRIME_SEG_WORDS		4096
+#define PRIME_SEG_BITS		(PRIME_SEG_WORDS * 64UL)
+#define PRIME_BLOCKS_PER_THREAD	8
+/* below this the table is built with a plain sieve */
+#define PRIME_TABLE_MIN		65536UL
+/* prevprime sieves windows of this many numbers below its argument */
+#define PRIME_WINDOW		65536UL
+#define PRIME_WINDOW_LIMIT	(1UL << 20)
+
+/* all primes <= small_limit, in order; kept across calls */
+static uint32_t *small_primes;
+static size_t nsmall, small_cap;
+static unsigned long small_limit;
+
+struct prime_block
+{
+	unsigned long lo;
+	unsigned long nbits;
+	unsigned long count;
+	unsigned long *list;
+	size_t nlist;
+	size_t cap;
+};
+
+struct prime_job
+{
+	struct prime_block *blocks;
+	int want_list;
+};
+
+
+static
+unsigned long
+isqrt_ul(unsigned long n)
+{
+	unsigned long r = (unsigned long)sqrt((double)n);
+
+	while (r > 0 && r > n / r)
+		--r;
+	while ((r + 1) <= n / (r + 1))
+		++r;
+
+	return r;
+}
+
+
+static
+int
+popcount64(uint64_t x)
+{
+	x = x - ((x >> 1) & 0x5555555555555555ULL);
+	x = (x & 0x3333333333333333ULL) + ((x >> 2) & 0x3333333333333333ULL);
+	x = (x + (x >> 4)) & 0x0f0f0f0f0f0f0f0fULL;
+
+	return (int)((x * 0x0101010101010101ULL) >> 56);
+}
+
+
+static
+void
+prime_push(uint32_t **v, size_t *n, size_t *cap, uint32_t p)
+{
+	if (*n == *cap) {
+		*cap = (*cap != 0) ? 2 * *cap : 1024;
+		if ((*v = realloc(*v, *cap * sizeof(**v))) == NULL) {
+			yyxerror("ENOMEM");
+			exit(1);
+		}
+	}
+	(*v)[(*n)++] = p;
+}
+
+
+static
+void
+prime_block_push(struct prime_block *b, unsigned long p)
+{
+	if (b->nlist == b->cap) {
+		b->cap = (b->cap != 0) ? 2 * b->cap : 1024;
+		if ((b->list = realloc(b->list, b->cap * sizeof(*b->list))) == NULL) {
+			yyxerror("ENOMEM");
+			exit(1);
+		}
+	}
+	b->list[b->nlist++] = p;
+}
+
+
+/*
+ * Sieves the odd numbers lo, lo + 2, ..., lo + 2 * (nbits - 1) with the
+ * cached primes; a set bit marks a composite.  lo must be odd and the
+ * table must cover the square root of the last number.  Bits past nbits
+ * in the last word are set as well.
+ */
+static
+void
+prime_sieve_segment(uint64_t *bits, unsigned long lo, unsigned long nbits)
+{
+	unsigned long hi = lo + 2 * (nbits - 1);
+	unsigned long p, m, k;
+	size_t i;
+
+	memset(bits, 0, ((nbits + 63) / 64) * sizeof(*bits));
+
+	for (i = 1; i < nsmall; i++) {
+		p = small_primes[i];
+		if (p > hi / p)
+			break;
+
+		if (p * p >= lo) {
+			k = (p * p - lo) / 2;
+		} else {
+			/* distance to the first odd multiple of p >= lo */
+			m = (lo % p == 0) ? 0 : p - lo % p;
+			if (m & 1)
+				m += p;
+			k = m / 2;
+		}
+
+		for (; k < nbits; k += p)
+			bits[k / 64] |= (uint64_t)1 << (k % 64);
+	}
+
+	if (lo == 1)
+		bits[0] |= 1;
+	if (nbits % 64)
+		bits[nbits / 64] |= ~(uint64_t)0 << (nbits % 64);
+}
+
+
+/*
+ * Extends the small-prime table to cover limit (at most 2^32).  Larger
+ * tables are built segment by segment from the smaller one.  Only called
+ * from the main thread, before any workers are started.
+ */
+static
+void
+prime_table_grow(unsigned long limit)
+{
+	uint64_t bits[PRIME_SEG_WORDS];
+	unsigned char *composite;
+	unsigned long i, j, lo, n, k;
+
+	if (limit > 0xffffffffUL)
+		limit = 0xffffffffUL;
+	if (limit <= small_limit)
+		return;
+
+	if (limit < 2 * small_limit)
+		limit = (2 * small_limit < 0xffffffffUL) ? 2 * small_limit : 0xffffffffUL;
+
+	if (limit <= PRIME_TABLE_MIN) {
+		limit = PRIME_TABLE_MIN;
+		if ((composite = calloc(limit + 1, 1)) == NULL) {
+			yyxerror("ENOMEM");
+			exit(1);
+		}
+		nsmall = 0;
+		for (i = 2; i <= limit; i++) {
+			if (composite[i])
+				continue;
+			prime_push(&small_primes, &nsmall, &small_cap, (uint32_t)i);
+			for (j = i * i; j <= limit; j += i)
+				composite[j] = 1;
+		}
+		free(composite);
+		small_limit = limit;
+		return;
+	}
+
+	prime_table_grow(isqrt_ul(limit));
+
+	lo = small_limit + 1;
+	if ((lo & 1) == 0)
+		++lo;
+
+	while (lo <= limit) {
+		n = (limit - lo) / 2 + 1;
+		if (n > PRIME_SEG_BITS)
+			n = PRIME_SEG_BITS;
+
+		prime_sieve_segment(bits, lo, n);
+		for (k = 0; k < n; k++)
+			if (!(bits[k / 64] & ((uint64_t)1 << (k % 64))))
+				prime_push(&small_primes, &nsmall, &small_cap,
+				    (uint32_t)(lo + 2 * k));
+		if (lo + 2 * (n - 1) >= limit)
+			break;
+		lo += 2 * n;
+	}
+
+	small_limit = limit;
+}
+
+
+const uint32_t *
+prime_table(unsigned long limit, size_t *n)
+{
+	prime_table_grow(limit);
+	*n = nsmall;
+
+	return small_primes;
+}
+
+
+static
+void
+prime_block_worker(void *arg, size_t i)
+{
+	struct prime_job *job = arg;
+	struct prime_block *b = &job->blocks[i];
+	unsigned long lo, left, n, k, w;
+	uint64_t *bits;
+
+	if ((bits = malloc(PRIME_SEG_WORDS * sizeof(*bits))) == NULL) {
+		yyxerror("ENOMEM");
+		exit(1);
+	}
+
+	lo = b->lo;
+	left = b->nbits;
+
+	while (left > 0) {
+		n = (left > PRIME_SEG_BITS) ? PRIME_SEG_BITS : left;
+		prime_sieve_segment(bits, lo, n);
+
+		if (job->want_list) {
+			for (w = 0; w < (n + 63) / 64; w++) {
+				uint64_t x = ~bits[w];
+
+				while (x != 0) {
+					k = w * 64 + (unsigned long)popcount64((x & -x) - 1);
+					prime_block_push(b, lo + 2 * k);
+					x &= x - 1;
+				}
+			}
+		} else {
+			b->count += n;
+			for (w = 0; w < (n + 63) / 64; w++)
+				b->count -= (unsigned long)popcount64(bits[w]);
+			/* the padding bits were counted as composites */
+			b->count += ((n + 63) / 64) * 64 - n;
+		}
+
+		left -= n;
+		if (left > 0)
+			lo += 2 * n;
+	}
+
+	free(bits);
+}
+
+
+static
+unsigned long
+prime_range_test(unsigned long olo, unsigned long nodd, unsigned long count,
+    unsigned long **list)
+{
+	unsigned long k, n = 0;
+	mpz_t c;
+
+	if (list != NULL) {
+		if ((*list = malloc((nodd + 1) * sizeof(**list))) == NULL) {
+			yyxerror("ENOMEM");
+			exit(1);
+		}
+		if (count)
+			(*list)[n++] = 2;
+	}
+
+	mpz_init(c);
+	for (k = 0; k < nodd; k++) {
+		mpz_set_ui(c, olo + 2 * k);
+		if (mpz_probab_prime_p(c, 25) == 0)
+			continue;
+		if (list != NULL)
+			(*list)[n] = olo + 2 * k;
+		++n;
+	}
+	mpz_clear(c);
+
+	return (list != NULL) ? n : count + n;
+}
+
+
+/*
+ * Sieves [lo, hi], split into blocks of whole segments that are handed
+ * to the worker threads.  Returns the number of primes and, if list is
+ * not NULL, a malloc'ed array of them in ascending order.
+ */
+static
+unsigned long
+prime_range(unsigned long lo, unsigned long hi, unsigned long **list)
+{
+	struct prime_job job;
+	unsigned long olo, ohi, nodd, nseg, q, rem, start, count;
+	size_t i, nblocks, pos;
+
+	count = (lo <= 2 && hi >= 2) ? 1 : 0;
+	olo = (lo <= 3) ? 3 : (lo | 1);
+	ohi = (hi & 1) ? hi : hi - 1;
+
+	if (hi < 3 || olo > ohi) {
+		if (list != NULL) {
+			if ((*list = malloc(sizeof(**list))) == NULL) {
+				yyxerror("ENOMEM");
+				exit(1);
+			}
+			(*list)[0] = 2;
+		}
+		/* only 2, if anything, is in range */
+		return count;
+	}
+
+	nodd = (ohi - olo) / 2 + 1;
+
+	/*
+	 * A narrow range far out would need a huge table; testing its few
+	 * candidates directly is cheaper (and exact below 2^64).
+	 */
+	if (isqrt_ul(ohi) > small_limit && nodd < isqrt_ul(ohi) / 64)
+		return prime_range_test(olo, nodd, count, list);
+
+	prime_table_grow(isqrt_ul(ohi));
+	nseg = (nodd + PRIME_SEG_BITS - 1) / PRIME_SEG_BITS;
+	nblocks = (size_t)par_threads * PRIME_BLOCKS_PER_THREAD;
+	if (par_threads <= 1 || nblocks > nseg)
+		nblocks = (par_threads <= 1) ? 1 : (size_t)nseg;
+
+	if ((job.blocks = calloc(nblocks, sizeof(*job.blocks))) == NULL) {
+		yyxerror("ENOMEM");
+		exit(1);
+	}
+	job.want_list = (list != NULL);
+
+	/* whole segments per block, the first nseg % nblocks get one more */
+	q = nseg / nblocks;
+	rem = nseg % nblocks;
+	for (i = 0, start = 0; i < nblocks; i++) {
+		unsigned long segs = q + ((i < rem) ? 1 : 0);
+
+		job.blocks[i].lo = olo + 2 * start;
+		job.blocks[i].nbits = segs * PRIME_SEG_BITS;
+		if (start + job.blocks[i].nbits > nodd)
+			job.blocks[i].nbits = nodd - start;
+		start += job.blocks[i].nbits;
+	}
+
+	par_run(nblocks, prime_block_worker, &job);
+
+	for (i = 0; i < nblocks; i++)
+		count += job.blocks[i].count + job.blocks[i].nlist;
+
+	if (list != NULL) {
+		if ((*list = malloc((count + 1) * sizeof(**list))) == NULL) {
+			yyxerror("ENOMEM");
+			exit(1);
+		}
+		pos = 0;
+		if (lo <= 2 && hi >= 2)
+			(*list)[pos++] = 2;
+		for (i = 0; i < nblocks; i++) {
+			if (job.blocks[i].nlist == 0)
+				continue;
+			memcpy(*list + pos, job.blocks[i].list,
+			    job.blocks[i].nlist * sizeof(**list));
+			pos += job.blocks[i].nlist;
+		}
+	}
+
+	for (i = 0; i < nblocks; i++)
+		free(job.blocks[i].list);
+	free(job.blocks);
+
+	return count;
+}
+
+
+unsigned long
+prime_count(unsigned long lo, unsigned long hi)
+{
+	if (lo > hi)
+		return 0;
+
+	return prime_range(lo, hi, NULL);
+}
+
+
+unsigned long *
+prime_list(unsigned long lo, unsigned long hi, size_t *n)
+{
+	unsigned long *list;
+
+	if (lo > hi) {
+		lo = 1;
+		hi = 0;
+	}
+
+	*n = (size_t)prime_range(lo, hi, &list);
+	return list;
+}
+
+
+/*
+ * r = the largest prime below a.  Windows below a are sieved with the
+ * small primes; survivors are prime outright if the sieve went up to
+ * their square root, otherwise they go through mpz_probab_prime_p.
+ * Returns -1 if there is no such prime (a <= 2).
+ */
+int
+prime_prev(mpz_t r, const mpz_t a)
+{
+	unsigned char *composite;
+	unsigned long limit, p, k, off;
+	mpz_t hi, lo, sq;
+	size_t i, w;
+	int exact, found = 0;
+
+	if (mpz_cmp_ui(a, 2) <= 0)
+		return -1;
+
+	if ((composite = malloc(PRIME_WINDOW)) == NULL) {
+		yyxerror("ENOMEM");
+		exit(1);
+	}
+
+	mpz_init(hi);
+	mpz_init(lo);
+	mpz_init(sq);
+
+	mpz_sub_ui(hi, a, 1);
+	mpz_sqrt(sq, hi);
+	limit = mpz_fits_ulong_p(sq) ? mpz_get_ui(sq) : PRIME_WINDOW_LIMIT;
+	if (limit > PRIME_WINDOW_LIMIT)
+		limit = PRIME_WINDOW_LIMIT;
+	prime_table_grow(limit);
+	exact = (mpz_cmp_ui(sq, limit) <= 0);
+
+	while (!found) {
+		/* window [lo, hi], never below 2 */
+		if (mpz_cmp_ui(hi, PRIME_WINDOW + 1) < 0)
+			mpz_set_ui(lo, 2);
+		else
+			mpz_sub_ui(lo, hi, PRIME_WINDOW - 1);
+
+		mpz_sub(sq, hi, lo);
+		w = (size_t)mpz_get_ui(sq) + 1;
+		memset(composite, 0, w);
+
+		for (i = 0; i < nsmall; i++) {
+			p = small_primes[i];
+			if (p > limit)
+				break;
+
+			off = mpz_fdiv_ui(lo, p);
+			k = (off == 0) ? 0 : p - off;
+			/* don't strike out p itself */
+			if (mpz_cmp_ui(lo, p) <= 0)
+				k = p - mpz_get_ui(lo) + p;
+			for (; k < w; k += p)
+				composite[k] = 1;
+		}
+
+		for (k = w; k-- > 0; ) {
+			if (composite[k])
+				continue;
+			mpz_add_ui(r, lo, k);
+			if (exact || mpz_probab_prime_p(r, 25) > 0) {
+				found = 1;
+				break;
+			}
+		}
+
+		mpz_sub_ui(hi, lo, 1);
+	}
+
+	mpz_clear(hi);
+	mpz_clear(lo);
+	mpz_clear(sq);
+	free(composite);
+
+	return 0;
+}
+
+
+/*
+ * Factorization: trial division by the small-prime table, then Brent's
+ * variant of Pollard rho, then stage 1 of Lenstra's elliptic curve method
+ * with Montgomery curves, several curves at a time on the worker threads.
+ * Cofactors that survive the time budget are reported as composite.
+ */
+
+#define FACTOR_TRIAL_LIMIT	65536UL
+#define FACTOR_RHO_ITERS	(1UL << 18)
+#define FACTOR_RHO_BATCH	128
+
+struct factor_ctx
+{
+	mpz_t *stack;
+	size_t nstack;
+	size_t capstack;
+	struct prime_factor *out;
+	size_t nout;
+	size_t capout;
+	time_t deadline;
+};
+
+struct ecm_job
+{
+	mpz_srcptr n;
+	unsigned long b1;
+	unsigned long sigma0;
+	time_t deadline;
+	mpz_t *found;
+	int *ok;
+};
+
+/* B1 bounds and curve counts as commonly used for 15..45 digit factors */
+static const struct
+{
+	unsigned long b1;
+	unsigned long curves;
+} ecm_levels[] = {
+	{ 2000, 25 },
+	{ 11000, 90 },
+	{ 50000, 300 },
+	{ 250000, 700 },
+	{ 1000000, 1800 },
+	{ 3000000, 5100 },
+	{ 11000000, 10600 },
+};
+
+
+static
+void
+factor_add(struct factor_ctx *ctx, const mpz_t p, unsigned long e, int composite)
+{
+	size_t i;
+
+	for (i = 0; i < ctx->nout; i++) {
+		if (mpz_cmp(ctx->out[i].p, p) == 0) {
+			ctx->out[i].e += e;
+			return;
+		}
+	}
+
+	if (ctx->nout == ctx->capout) {
+		ctx->capout = (ctx->capout != 0) ? 2 * ctx->capout : 16;
+		if ((ctx->out = realloc(ctx->out,
+		    ctx->capout * sizeof(*ctx->out))) == NULL) {
+			yyxerror("ENOMEM");
+			exit(1);
+		}
+	}
+
+	mpz_init_set(ctx->out[ctx->nout].p, p);
+	ctx->out[ctx->nout].e = e;
+	ctx->out[ctx->nout].composite = composite;
+	++ctx->nout;
+}
+
+
+static
+void
+factor_push(struct factor_ctx *ctx, const mpz_t n)
+{
+	if (ctx->nstack == ctx->capstack) {
+		ctx->capstack = (ctx->capstack != 0) ? 2 * ctx->capstack : 16;
+		if ((ctx->stack = realloc(ctx->stack,
+		    ctx->capstack * sizeof(*ctx->stack))) == NULL) {
+			yyxerror("ENOMEM");
+			exit(1);
+		}
+	}
+
+	mpz_init_set(ctx->stack[ctx->nstack++], n);
+}
+
+
+/*
+ * Brent's cycle finding on x -> x^2 + c, with the gcds batched.  Returns
+ * 1 and a proper factor in g on success.
+ */
+static
+int
+factor_rho(mpz_t g, const mpz_t n, unsigned long c, time_t deadline)
+{
+	unsigned long r, k, i, m, iters = 0;
+	mpz_t x, y, ys, q, t;
+	int found = 0;
+
+	mpz_init_set_ui(y, 2);
+	mpz_init(x);
+	mpz_init(ys);
+	mpz_init_set_ui(q, 1);
+	mpz_init(t);
+	mpz_set_ui(g, 1);
+
+	for (r = 1; mpz_cmp_ui(g, 1) == 0; r *= 2) {
+		mpz_set(x, y);
+		for (i = 0; i < r; i++) {
+			mpz_mul(y, y, y);
+			mpz_add_ui(y, y, c);
+			mpz_mod(y, y, n);
+		}
+
+		for (k = 0; k < r && mpz_cmp_ui(g, 1) == 0; k += m) {
+			mpz_set(ys, y);
+			m = (r - k < FACTOR_RHO_BATCH) ? r - k : FACTOR_RHO_BATCH;
+			for (i = 0; i < m; i++) {
+				mpz_mul(y, y, y);
+				mpz_add_ui(y, y, c);
+				mpz_mod(y, y, n);
+				mpz_sub(t, x, y);
+				mpz_mul(q, q, t);
+				mpz_mod(q, q, n);
+			}
+			mpz_gcd(g, q, n);
+		}
+
+		iters += 2 * r;
+		if (iters > FACTOR_RHO_ITERS || time(NULL) > deadline)
+			break;
+	}
+
+	if (mpz_cmp(g, n) == 0) {
+		/* the batch overshot: redo it one step at a time */
+		do {
+			mpz_mul(ys, ys, ys);
+			mpz_add_ui(ys, ys, c);
+			mpz_mod(ys, ys, n);
+			mpz_sub(t, x, ys);
+			mpz_gcd(g, t, n);
+		} while (mpz_cmp_ui(g, 1) == 0);
+	}
+
+	found = (mpz_cmp_ui(g, 1) != 0 && mpz_cmp(g, n) != 0);
+
+	mpz_clear(x);
+	mpz_clear(y);
+	mpz_clear(ys);
+	mpz_clear(q);
+	mpz_clear(t);
+
+	return found;
+}
+
+
+/* (x2:z2) = 2 * (x:z); the outputs may alias the inputs */
+static
+void
+ecm_dbl(mpz_t x2, mpz_t z2, const mpz_t x, const mpz_t z, const mpz_t a24,
+    const mpz_t n, mpz_t t1, mpz_t t2, mpz_t t3)
+{
+	mpz_add(t1, x, z);
+	mpz_mul(t1, t1, t1);
+	mpz_mod(t1, t1, n);
+	mpz_sub(t2, x, z);
+	mpz_mul(t2, t2, t2);
+	mpz_mod(t2, t2, n);
+	mpz_sub(t3, t1, t2);
+
+	mpz_mul(x2, t1, t2);
+	mpz_mod(x2, x2, n);
+	mpz_mul(z2, a24, t3);
+	mpz_add(z2, z2, t2);
+	mpz_mul(z2, z2, t3);
+	mpz_mod(z2, z2, n);
+}
+
+
+/* (xr:zr) = P + Q given the difference D = P - Q */
+static
+void
+ecm_add(mpz_t xr, mpz_t zr, const mpz_t xp, const mpz_t zp, const mpz_t xq,
+    const mpz_t zq, const mpz_t xd, const mpz_t zd, const mpz_t n, mpz_t t1,
+    mpz_t t2, mpz_t t3)
+{
+	mpz_sub(t1, xp, zp);
+	mpz_add(t3, xq, zq);
+	mpz_mul(t1, t1, t3);
+	mpz_mod(t1, t1, n);
+	mpz_add(t2, xp, zp);
+	mpz_sub(t3, xq, zq);
+	mpz_mul(t2, t2, t3);
+	mpz_mod(t2, t2, n);
+
+	mpz_add(t3, t1, t2);
+	mpz_mul(t3, t3, t3);
+	mpz_mul(t3, t3, zd);
+	mpz_mod(t3, t3, n);
+	mpz_sub(t1, t1, t2);
+	mpz_mul(t1, t1, t1);
+	mpz_mul(t1, t1, xd);
+	mpz_mod(t1, t1, n);
+
+	mpz_swap(xr, t3);
+	mpz_swap(zr, t1);
+}
+
+
+/* (x:z) = k * (x:z) with the Montgomery ladder, k >= 2 */
+static
+void
+ecm_mul(mpz_t x, mpz_t z, unsigned long k, const mpz_t a24, const mpz_t n,
+    mpz_t *t)
+{
+	unsigned long bit;
+	mpz_t x1, z1, xd, zd;
+
+	mpz_init_set(xd, x);
+	mpz_init_set(zd, z);
+	mpz_init(x1);
+	mpz_init(z1);
+
+	ecm_dbl(x1, z1, x, z, a24, n, t[0], t[1], t[2]);
+
+	for (bit = 1; bit <= k / 2; bit <<= 1)
+		;
+	for (bit >>= 1; bit != 0; bit >>= 1) {
+		if (k & bit) {
+			ecm_add(x, z, x, z, x1, z1, xd, zd, n, t[0], t[1], t[2]);
+			ecm_dbl(x1, z1, x1, z1, a24, n, t[0], t[1], t[2]);
+		} else {
+			ecm_add(x1, z1, x, z, x1, z1, xd, zd, n, t[0], t[1], t[2]);
+			ecm_dbl(x, z, x, z, a24, n, t[0], t[1], t[2]);
+		}
+	}
+
+	mpz_clear(xd);
+	mpz_clear(zd);
+	mpz_clear(x1);
+	mpz_clear(z1);
+}
+
+
+/*
+ * One curve of ECM stage 1, using Suyama's parametrization for the
+ * curve and starting point of the given sigma.
+ */
+static
+void
+ecm_curve(void *arg, size_t i)
+{
+	struct ecm_job *job = arg;
+	mpz_srcptr n = job->n;
+	unsigned long sigma = job->sigma0 + i, p, q;
+	mpz_t u, v, x, z, a24, t[3], g;
+	size_t j;
+
+	mpz_init(u); mpz_init(v); mpz_init(x); mpz_init(z);
+	mpz_init(a24); mpz_init(g);
+	for (j = 0; j < 3; j++)
+		mpz_init(t[j]);
+
+	/* u = sigma^2 - 5, v = 4 sigma, P = (u^3 : v^3) */
+	mpz_set_ui(u, sigma);
+	mpz_mul(u, u, u);
+	mpz_sub_ui(u, u, 5);
+	mpz_set_ui(v, sigma);
+	mpz_mul_ui(v, v, 4);
+	mpz_powm_ui(x, u, 3, n);
+	mpz_powm_ui(z, v, 3, n);
+
+	/* (A + 2) / 4 = (v - u)^3 (3u + v) / (16 u^3 v) */
+	mpz_sub(t[0], v, u);
+	mpz_powm_ui(t[0], t[0], 3, n);
+	mpz_mul_ui(t[1], u, 3);
+	mpz_add(t[1], t[1], v);
+	mpz_mul(a24, t[0], t[1]);
+	mpz_mul(t[0], x, v);
+	mpz_mul_ui(t[0], t[0], 16);
+	mpz_mod(t[0], t[0], n);
+	if (!mpz_invert(t[1], t[0], n)) {
+		mpz_gcd(g, t[0], n);
+		goto out;
+	}
+	mpz_mul(a24, a24, t[1]);
+	mpz_mod(a24, a24, n);
+
+	for (j = 0; j < nsmall && small_primes[j] <= job->b1; j++) {
+		p = small_primes[j];
+		for (q = p; q <= job->b1 / p; q *= p)
+			;
+		ecm_mul(x, z, q, a24, n, t);
+
+		if ((j & 255) == 0 && time(NULL) > job->deadline)
+			break;
+	}
+
+	mpz_gcd(g, z, n);
+
+out:
+	if (mpz_cmp_ui(g, 1) > 0 && mpz_cmp(g, n) < 0) {
+		mpz_set(job->found[i], g);
+		job->ok[i] = 1;
+	}
+
+	mpz_clear(u); mpz_clear(v); mpz_clear(x); mpz_clear(z);
+	mpz_clear(a24); mpz_clear(g);
+	for (j = 0; j < 3; j++)
+		mpz_clear(t[j]);
+}
+
+
+static
+int
+factor_ecm(mpz_t g, const mpz_t n, time_t deadline)
+{
+	struct ecm_job job;
+	unsigned long done, sigma = 6;
+	size_t i, level, ncurves;
+	int found = 0;
+
+	ncurves = (par_threads > 1) ? (size_t)par_threads : 1;
+
+	if ((job.found = malloc(ncurves * sizeof(*job.found))) == NULL ||
+	    (job.ok = malloc(ncurves * sizeof(*job.ok))) == NULL) {
+		yyxerror("ENOMEM");
+		exit(1);
+	}
+	for (i = 0; i < ncurves; i++)
+		mpz_init(job.found[i]);
+
+	job.n = n;
+	job.deadline = deadline;
+
+	for (level = 0; !found && level < sizeof(ecm_levels) / sizeof(ecm_levels[0]); level++) {
+		job.b1 = ecm_levels[level].b1;
+		prime_table_grow(job.b1);
+
+		for (done = 0; !found && done < ecm_levels[level].curves; done += ncurves) {
+			if (time(NULL) > deadline)
+				goto out;
+
+			job.sigma0 = sigma;
+			sigma += ncurves;
+			memset(job.ok, 0, ncurves * sizeof(*job.ok));
+
+			par_run(ncurves, ecm_curve, &job);
+
+			for (i = 0; i < ncurves; i++) {
+				if (job.ok[i]) {
+					mpz_set(g, job.found[i]);
+					found = 1;
+					break;
+				}
+			}
+		}
+	}
+
+out:
+	for (i = 0; i < ncurves; i++)
+		mpz_clear(job.found[i]);
+	free(job.found);
+	free(job.ok);
+
+	return found;
+}
+
+
+static
+int
+factor_cmp(const void *a, const void *b)
+{
+	const struct prime_factor *fa = a, *fb = b;
+
+	return mpz_cmp(fa->p, fb->p);
+}
+
+
+/*
+ * Factors a > 1 into *f, sorted by factor, spending at most about budget
+ * seconds on the hard parts.  Returns the number of distinct factors.
+ */
+size_t
+prime_factorize(struct prime_factor **f, const mpz_t a, long budget)
+{
+	struct factor_ctx ctx;
+	unsigned long p, e, k, c;
+	mpz_t n, g;
+	size_t i;
+
+	memset(&ctx, 0, sizeof(ctx));
+	ctx.deadline = time(NULL) + budget;
+
+	mpz_init_set(n, a);
+	mpz_init(g);
+
+	prime_table_grow(FACTOR_TRIAL_LIMIT);
+	for (i = 0; i < nsmall && small_primes[i] <= FACTOR_TRIAL_LIMIT; i++) {
+		p = small_primes[i];
+		if (mpz_cmp_ui(n, p) < 0)
+			break;
+		for (e = 0; mpz_divisible_ui_p(n, p); e++)
+			mpz_divexact_ui(n, n, p);
+		if (e > 0) {
+			mpz_set_ui(g, p);
+			factor_add(&ctx, g, e, 0);
+		}
+	}
+
+	if (mpz_cmp_ui(n, 1) > 0)
+		factor_push(&ctx, n);
+
+	while (ctx.nstack > 0) {
+		mpz_swap(n, ctx.stack[--ctx.nstack]);
+		mpz_clear(ctx.stack[ctx.nstack]);
+
+		if (mpz_probab_prime_p(n, 25) > 0) {
+			factor_add(&ctx, n, 1, 0);
+			continue;
+		}
+
+		if (mpz_perfect_power_p(n)) {
+			for (k = 2; !mpz_root(g, n, k); k++)
+				;
+			for (; k > 0; k--)
+				factor_push(&ctx, g);
+			continue;
+		}
+
+		for (c = 1; c <= 3; c++)
+			if (factor_rho(g, n, c, ctx.deadline))
+				break;
+
+		if (c <= 3 || factor_ecm(g, n, ctx.deadline)) {
+			factor_push(&ctx, g);
+			mpz_divexact(n, n, g);
+			factor_push(&ctx, n);
+			continue;
+		}
+
+		factor_add(&ctx, n, 1, 1);
+	}
+
+	qsort(ctx.out, ctx.nout, sizeof(*ctx.out), factor_cmp);
+
+	free(ctx.stack);
+	mpz_clear(n);
+	mpz_clear(g);
+
+	*f = ctx.out;
+	return ctx.nout;
+}
+
+
+void
+prime_factors_free(struct prime_factor *f, size_t n)
+{
+	size_t i;
+
+	for (i = 0; i < n; i++)
+		mpz_clear(f[i].p);
+	free(f);
+}
@@ -0,0 +1,209 @@
+/*
+ * Copyright (c) 2026 Alex Hornung <alex@alexhornung.com>.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in
+ *    the documentation and/or other materials provided with the
+ *    distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE
+ * COPYRIGHT HOLDERS OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ * BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED
+ * AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT
+ * OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+
+/*
+ * Purity analysis.  A call is pure if it has no side effects and its
+ * result depends only on its arguments and on global variables, which
+ * the analysis collects so that the caller can check that none of them
+ * change.
+ *
+ * Builtins are pure unless they are marked FUNC_IMPURE or take the name
+ * of a function to call, which may be any function at all.  A user
+ * function is pure if every call in its body is; assignments in it are
+ * to its own locals, which cannot be seen from outside, but any name
+ * other than a parameter may read a global.
+ */
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <assert.h>
+
+#include <gmp.h>
+#include <mpfr.h>
+
+#include "hashtable.h"
+
+#include "optype.h"
+#include "num.h"
+#include "var.h"
+#include "ast.h"
+#include "calc.h"
+#include "func.h"
+#include "pure.h"
+
+struct pure_ctx
+{
+	hashtable_t reads;	/* globals the calls read */
+	hashtable_t seen;	/* user functions analysed so far */
+};
+
+
+static int pure_call(struct pure_ctx *ctx, astcall_t ac, hashtable_t params);
+
+
+/*
+ * Whether a, part of a function body with the given parameters, is
+ * pure, adding the other names it reads to ctx->reads.
+ */
+static
+int
+pure_ast(struct pure_ctx *ctx, ast_t a, hashtable_t params)
+{
+	astpsel_t ap;
+	astpselassign_t apa;
+	astflow_t af;
+
+	if (a == NULL)
+		return 1;
+
+	switch (a->op_type) {
+	case OP_NUM:
+		return 1;
+
+	case OP_VARREF:
+		if (hashtable_lookup(params, ((astref_t)a)->name, 0) == NULL)
+			hashtable_lookup(ctx->reads, ((astref_t)a)->name, 1);
+		return 1;
+
+	case OP_CMP:
+		return pure_ast(ctx, ((astcmp_t)a)->l, params) &&
+		    pure_ast(ctx, ((astcmp_t)a)->r, params);
+
+	case OP_FLOW:
+		af = (astflow_t)a;
+		return pure_ast(ctx, af->cond, params) &&
+		    pure_ast(ctx, af->t, params) &&
+		    pure_ast(ctx, af->f, params);
+
+	case OP_CALL:
+		return pure_call(ctx, (astcall_t)a, params);
+
+	case OP_VARASSIGN:
+		return pure_ast(ctx, ((astassign_t)a)->v, params);
+
+	case OP_PSEL:
+		ap = (astpsel_t)a;
+		return pure_ast(ctx, ap->l, params) &&
+		    pure_ast(ctx, ap->hi, params) &&
+		    pure_ast(ctx, ap->lo, params);
+
+	case OP_PSELASSIGN:
+		apa = (astpselassign_t)a;
+		return pure_ast(ctx, apa->hi, params) &&
+		    pure_ast(ctx, apa->lo, params) &&
+		    pure_ast(ctx, apa->v, params);
+
+	default:
+		return pure_ast(ctx, a->l, params) &&
+		    pure_ast(ctx, a->r, params);
+	}
+}
+
+
+static
+int
+pure_fun(struct pure_ctx *ctx, func_t fn, const char *name)
+{
+	hashtable_t params;
+	namelist_t p;
+	int pure;
+
+	if (fn->builtin)
+		return !(fn->flags & (FUNC_IMPURE | FUNC_FN_ARG));
+
+	/* a recursive call is as pure as the rest of the function */
+	if (hashtable_lookup(ctx->seen, name, 0) != NULL)
+		return 1;
+	hashtable_lookup(ctx->seen, name, 1);
+
+	if (fn->ast == NULL)
+		return 0;
+
+	/*
+	 * Only the parameters are always local: a name the body assigns
+	 * to reads the global of that name until it is assigned.
+	 */
+	params = hashtable_new(61, NULL, NULL);
+	for (p = fn->namelist; p != NULL; p = p->next)
+		hashtable_lookup(params, p->name, 1);
+
+	pure = pure_ast(ctx, fn->ast, params);
+
+	hashtable_destroy(params);
+
+	return pure;
+}
+
+
+static
+int
+pure_call(struct pure_ctx *ctx, astcall_t ac, hashtable_t params)
+{
+	explist_t p;
+	func_t fn;
+
+	if ((fn = funlookup(ac->name, 0)) == NULL)
+		return 0;
+
+	if (!pure_fun(ctx, fn, ac->name))
+		return 0;
+
+	for (p = ac->l; p != NULL; p = p->next)
+		if (!pure_ast(ctx, p->ast, params))
+			return 0;
+
+	return 1;
+}
+
+
+/*
+ * Whether calling the function ac names, leaving its arguments aside,
+ * is pure.  The globals it may read are added to reads.
+ */
+int
+call_pure(astcall_t ac, hashtable_t reads)
+{
+	struct pure_ctx ctx;
+	func_t fn;
+	int pure;
+
+	if ((fn = funlookup(ac->name, 0)) == NULL)
+		return 0;
+
+	ctx.reads = reads;
+	ctx.seen = hashtable_new(61, NULL, NULL);
+
+	pure = pure_fun(&ctx, fn, ac->name);
+
+	hashtable_destroy(ctx.seen);
+
+	return pure;
+}
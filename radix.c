@@ -0,0 +1,345 @@
+/*
+ * Copyright (c) 2026 Alex Hornung <alex@alexhornung.com>.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in
+ *    the documentation and/or other materials provided with the
+ *    distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE
+ * COPYRIGHT HOLDERS OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ * BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED
+ * AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT
+ * OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <gmp.h>
+#include <mpfr.h>
+
+#include "hashtable.h"
+
+#include "optype.h"
+#include "num.h"
+#include "var.h"
+#include "ast.h"
+#include "calc.h"
+#include "bigz.h"
+#include "par.h"
+#include "radix.h"
+
+/*
+ * Decimal conversion of huge integers.
+ *
+ * The value is split by a tree of divisions by 10^(RADIX_LEAF << k),
+ * level by level, with the divisions of each level spread over the
+ * worker threads. The leaves have at most RADIX_LEAF digits each; they
+ * are converted a batch at a time, again in parallel, and handed to the
+ * sink in order, so no buffer ever holds more than one batch of digits.
+ *
+ * The powers of ten are cached across conversions, as every value of a
+ * similar size needs the same ones.
+ */
+#define RADIX_LEAF	16384
+#define RADIX_MIN_BITS	(1UL << 20)
+#define RADIX_BATCH	8		/* leaves per thread and batch */
+
+#define RADIX_ABBREV_DIGITS	10	/* digits shown at either end */
+#define RADIX_ABBREV_PREC	128	/* bits of log10 for the leading ones */
+
+static mpz_t *radix_pow;	/* radix_pow[k] = 10^(RADIX_LEAF << k) */
+static int radix_npow;
+
+struct radix_split
+{
+	mpz_t *src;
+	mpz_t *dst;
+	int k;
+};
+
+struct radix_leaves
+{
+	mpz_t *leaf;
+	char *buf;
+	size_t *len;
+	size_t first;	/* index of the most significant leaf */
+	size_t base;	/* index of the first leaf of this batch */
+};
+
+
+static
+void
+radix_pow_ensure(int k)
+{
+	while (radix_npow <= k) {
+		if ((radix_pow = realloc(radix_pow,
+		    (radix_npow + 1) * sizeof(*radix_pow))) == NULL) {
+			yyxerror("ENOMEM");
+			exit(1);
+		}
+
+		mpz_init(radix_pow[radix_npow]);
+		if (radix_npow == 0)
+			mpz_ui_pow_ui(radix_pow[0], 10UL, RADIX_LEAF);
+		else
+			bigz_mul(radix_pow[radix_npow],
+			    radix_pow[radix_npow - 1], radix_pow[radix_npow - 1]);
+		++radix_npow;
+	}
+}
+
+
+static
+void
+radix_split_one(void *arg, size_t i)
+{
+	struct radix_split *s = arg;
+
+	mpz_init(s->dst[2 * i]);
+	mpz_init(s->dst[2 * i + 1]);
+	mpz_tdiv_qr(s->dst[2 * i], s->dst[2 * i + 1], s->src[i],
+	    radix_pow[s->k]);
+	mpz_clear(s->src[i]);
+}
+
+
+/* Leaves below the most significant one are padded to RADIX_LEAF digits. */
+static
+void
+radix_leaf_one(void *arg, size_t i)
+{
+	struct radix_leaves *l = arg;
+	size_t idx = l->base + i;
+	char *buf = l->buf + i * (RADIX_LEAF + 2);
+	size_t len;
+
+	mpz_get_str(buf, 10, l->leaf[idx]);
+	len = strlen(buf);
+
+	if (idx != l->first && len < RADIX_LEAF) {
+		memmove(buf + (RADIX_LEAF - len), buf, len);
+		memset(buf, '0', RADIX_LEAF - len);
+		len = RADIX_LEAF;
+	}
+
+	l->len[i] = len;
+	mpz_clear(l->leaf[idx]);
+}
+
+
+/* Whether a value of the given bit size is worth the divide and conquer. */
+int
+radix_wants(size_t bits)
+{
+	return (bits >= RADIX_MIN_BITS);
+}
+
+
+void
+radix_put_z(const mpz_t a, radix_sink_t sink, void *priv)
+{
+	struct radix_split split;
+	struct radix_leaves leaves;
+	mpz_t *nodes, *next;
+	size_t digits, n, i, batch, nb;
+	int k, top;
+
+	if (mpz_sgn(a) < 0)
+		sink(priv, "-", 1);
+
+	/* smallest tree whose leaves can hold all the digits */
+	digits = mpz_sizeinbase(a, 10);
+	for (top = 0; ((size_t)RADIX_LEAF << (top + 1)) < digits; top++)
+		;
+	radix_pow_ensure(top);
+
+	if ((nodes = malloc(sizeof(*nodes))) == NULL) {
+		yyxerror("ENOMEM");
+		exit(1);
+	}
+	mpz_init(nodes[0]);
+	mpz_abs(nodes[0], a);
+
+	for (k = top, n = 1; k >= 0; k--, n *= 2) {
+		if ((next = malloc(2 * n * sizeof(*next))) == NULL) {
+			yyxerror("ENOMEM");
+			exit(1);
+		}
+
+		split.src = nodes;
+		split.dst = next;
+		split.k = k;
+		par_run(n, radix_split_one, &split);
+
+		free(nodes);
+		nodes = next;
+	}
+
+	/* skip leading zero leaves */
+	for (i = 0; i < n - 1 && mpz_sgn(nodes[i]) == 0; i++)
+		mpz_clear(nodes[i]);
+
+	batch = (size_t)par_threads * RADIX_BATCH;
+	leaves.leaf = nodes;
+	leaves.first = i;
+	leaves.buf = malloc(batch * (RADIX_LEAF + 2));
+	leaves.len = malloc(batch * sizeof(*leaves.len));
+	if (leaves.buf == NULL || leaves.len == NULL) {
+		yyxerror("ENOMEM");
+		exit(1);
+	}
+
+	for (; i < n; i += nb) {
+		nb = (n - i < batch) ? n - i : batch;
+		leaves.base = i;
+		par_run(nb, radix_leaf_one, &leaves);
+
+		for (k = 0; (size_t)k < nb; k++)
+			sink(priv, leaves.buf + k * (RADIX_LEAF + 2),
+			    leaves.len[k]);
+	}
+
+	free(leaves.buf);
+	free(leaves.len);
+	free(nodes);
+}
+
+
+/*
+ * Number of digits of |a| in decimal, and its leading RADIX_ABBREV_DIGITS
+ * digits, without a conversion: both come from log10(|a|), bracketed by
+ * evaluating it rounded downwards and upwards. Only when the bracket
+ * straddles a digit boundary (|a| very close to a power of ten, say) are
+ * they computed exactly, with a single division by a power of ten.
+ */
+static
+size_t
+radix_lead10(mpz_ptr lead, const mpz_t a)
+{
+	mpfr_t lo, hi;
+	mpz_t p;
+	size_t digits, hdigits, drop;
+
+	mpfr_init2(lo, RADIX_ABBREV_PREC);
+	mpfr_init2(hi, RADIX_ABBREV_PREC);
+
+	mpfr_set_z(lo, a, MPFR_RNDD);
+	mpfr_set_z(hi, a, MPFR_RNDU);
+	mpfr_abs(lo, lo, MPFR_RNDD);
+	mpfr_abs(hi, hi, MPFR_RNDU);
+	if (mpz_sgn(a) < 0)
+		mpfr_swap(lo, hi);
+	mpfr_log10(lo, lo, MPFR_RNDD);
+	mpfr_log10(hi, hi, MPFR_RNDU);
+
+	digits = mpfr_get_ui(lo, MPFR_RNDD) + 1;
+	hdigits = mpfr_get_ui(hi, MPFR_RNDD) + 1;
+	drop = digits - RADIX_ABBREV_DIGITS;
+
+	if (digits == hdigits) {
+		/* 10^(log10|a| - drop) lies in [10^(k-1), 10^k) */
+		mpfr_sub_ui(lo, lo, drop, MPFR_RNDD);
+		mpfr_sub_ui(hi, hi, drop, MPFR_RNDU);
+		mpfr_exp10(lo, lo, MPFR_RNDD);
+		mpfr_exp10(hi, hi, MPFR_RNDU);
+		if (mpfr_get_ui(lo, MPFR_RNDD) == mpfr_get_ui(hi, MPFR_RNDD)) {
+			mpz_set_ui(lead, mpfr_get_ui(lo, MPFR_RNDD));
+			goto out;
+		}
+	}
+
+	mpz_init(p);
+	mpz_ui_pow_ui(p, 10UL, digits);
+	if (mpz_cmpabs(a, p) >= 0)
+		++digits;
+	drop = digits - RADIX_ABBREV_DIGITS;
+	mpz_ui_pow_ui(p, 10UL, drop);
+	mpz_tdiv_q(lead, a, p);
+	mpz_abs(lead, lead);
+	mpz_clear(p);
+
+out:
+	mpfr_clear(lo);
+	mpfr_clear(hi);
+	return digits;
+}
+
+
+/*
+ * Formats a as its leading and trailing RADIX_ABBREV_DIGITS digits in the
+ * given base, joined by an ellipsis and followed by the total number of
+ * digits, if it has more than limit digits. Returns -1 if the value is
+ * short enough to be printed in full, and the snprintf() result otherwise.
+ *
+ * Only the ends of the number are computed, so this is cheap however
+ * large a is.
+ */
+int
+radix_abbrev(char *s, size_t sz, const mpz_t a, int base, size_t limit)
+{
+	mpz_t lead, trail;
+	size_t digits, bits, n;
+	char ls[RADIX_ABBREV_DIGITS + 1], ts[RADIX_ABBREV_DIGITS + 1];
+	int shift, r;
+
+	if (limit < 2 * RADIX_ABBREV_DIGITS)
+		limit = 2 * RADIX_ABBREV_DIGITS;
+	if (mpz_sizeinbase(a, base) <= limit)
+		return -1;
+
+	mpz_init(lead);
+	mpz_init(trail);
+
+	if (base == 10) {
+		digits = radix_lead10(lead, a);
+		if (digits <= limit) {
+			mpz_clear(lead);
+			mpz_clear(trail);
+			return -1;
+		}
+		mpz_ui_pow_ui(trail, 10UL, RADIX_ABBREV_DIGITS);
+		mpz_tdiv_r(trail, a, trail);
+	} else {
+		/* a power of two, so the digits are plain bit fields */
+		shift = (base == 2) ? 1 : (base == 8) ? 3 : 4;
+		bits = mpz_sizeinbase(a, 2);
+		digits = (bits + shift - 1) / shift;
+		mpz_tdiv_q_2exp(lead, a,
+		    (digits - RADIX_ABBREV_DIGITS) * shift);
+		mpz_tdiv_r_2exp(trail, a, RADIX_ABBREV_DIGITS * shift);
+	}
+	mpz_abs(lead, lead);
+	mpz_abs(trail, trail);
+
+	/* the trailing digits keep their leading zeros */
+	mpz_get_str(ls, base, lead);
+	mpz_get_str(ts, base, trail);
+	n = strlen(ts);
+	memmove(ts + RADIX_ABBREV_DIGITS - n, ts, n + 1);
+	memset(ts, '0', RADIX_ABBREV_DIGITS - n);
+
+	r = snprintf(s, sz, "%s%s...%s (%zu digits)",
+	    (mpz_sgn(a) < 0) ? "-" : "", ls, ts, digits);
+
+	mpz_clear(lead);
+	mpz_clear(trail);
+	return r;
+}
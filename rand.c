@@ -0,0 +1,183 @@
+/*
+ * Copyright (c) 2026 Alex Hornung <alex@alexhornung.com>.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in
+ *    the documentation and/or other materials provided with the
+ *    distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE
+ * COPYRIGHT HOLDERS OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ * BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED
+ * AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT
+ * OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <time.h>
+
+#include <gmp.h>
+#include <mpfr.h>
+
+#include "hashtable.h"
+
+#include "optype.h"
+#include "num.h"
+#include "var.h"
+#include "ast.h"
+#include "calc.h"
+#include "par.h"
+#include "rand.h"
+
+/*
+ * Random numbers, from a single Mersenne Twister state that seed()
+ * resets. Large randbits() results are generated in chunks of
+ * RAND_CHUNK_BITS, each from a stream of its own that is seeded from
+ * one draw of the main state and the chunk index, so the chunks can be
+ * filled by the worker threads and the result does not depend on how
+ * many there are.
+ */
+#define RAND_CHUNK_BITS	(1UL << 20)
+
+static gmp_randstate_t rand_state;
+
+struct rand_bulk_job
+{
+	mp_limb_t *rp;
+	unsigned long nbits;
+	mpz_t base;
+};
+
+
+void
+rand_seed(const mpz_t s)
+{
+	gmp_randseed(rand_state, s);
+}
+
+
+/* Uniform in [0, 1), with all the bits of r's precision random. */
+void
+rand_float(mpfr_t r)
+{
+	mpfr_urandomb(r, rand_state);
+}
+
+
+/* Uniform in [lo, hi]; fails if the range is empty. */
+int
+rand_int(mpz_t r, const mpz_t lo, const mpz_t hi)
+{
+	mpz_t n;
+
+	if (mpz_cmp(lo, hi) > 0)
+		return -1;
+
+	mpz_init(n);
+	mpz_sub(n, hi, lo);
+	mpz_add_ui(n, n, 1);
+	mpz_urandomm(r, rand_state, n);
+	mpz_add(r, r, lo);
+	mpz_clear(n);
+
+	return 0;
+}
+
+
+static
+void
+rand_bulk_worker(void *arg, size_t i)
+{
+	struct rand_bulk_job *job = arg;
+	gmp_randstate_t st;
+	unsigned long bits;
+	mpz_t s, c;
+	size_t n, cn;
+
+	gmp_randinit_default(st);
+	mpz_init(s);
+	mpz_init(c);
+
+	/* the stream of chunk i is seeded with base * 2^64 + i */
+	mpz_mul_2exp(s, job->base, 64);
+	mpz_add_ui(s, s, i);
+	gmp_randseed(st, s);
+
+	bits = job->nbits - i * RAND_CHUNK_BITS;
+	if (bits > RAND_CHUNK_BITS)
+		bits = RAND_CHUNK_BITS;
+	mpz_urandomb(c, st, bits);
+
+	/* copy into the chunk's limbs, zero-filling above c's top limb */
+	n = (bits + GMP_NUMB_BITS - 1) / GMP_NUMB_BITS;
+	cn = mpz_size(c);
+	memcpy(job->rp + i * (RAND_CHUNK_BITS / GMP_NUMB_BITS),
+	    mpz_limbs_read(c), cn * sizeof(mp_limb_t));
+	memset(job->rp + i * (RAND_CHUNK_BITS / GMP_NUMB_BITS) + cn, 0,
+	    (n - cn) * sizeof(mp_limb_t));
+
+	mpz_clear(c);
+	mpz_clear(s);
+	gmp_randclear(st);
+}
+
+
+/* Uniform in [0, 2^nbits). */
+void
+rand_bits(mpz_t r, unsigned long nbits)
+{
+	struct rand_bulk_job job;
+	size_t n, nchunks;
+
+	if (nbits <= RAND_CHUNK_BITS) {
+		mpz_urandomb(r, rand_state, nbits);
+		return;
+	}
+
+	nchunks = (nbits + RAND_CHUNK_BITS - 1) / RAND_CHUNK_BITS;
+	n = (nbits + GMP_NUMB_BITS - 1) / GMP_NUMB_BITS;
+
+	mpz_init(job.base);
+	mpz_urandomb(job.base, rand_state, 64);
+
+	job.rp = mpz_limbs_write(r, n);
+	job.nbits = nbits;
+
+	par_run(nchunks, rand_bulk_worker, &job);
+
+	mpz_limbs_finish(r, n);
+	mpz_clear(job.base);
+}
+
+
+void
+rand_init(void)
+{
+	mpz_t s;
+
+	gmp_randinit_default(rand_state);
+
+	mpz_init_set_ui(s, (unsigned long)time(NULL));
+	mpz_mul_2exp(s, s, 32);
+	mpz_add_ui(s, s, (unsigned long)getpid());
+	gmp_randseed(rand_state, s);
+	mpz_clear(s);
+}
@@ -66,8 +66,28 @@ struct safe_mem_bucket_md
 };
 
 static struct safe_mem_hdr *safe_mem_hdr_first[SAFEMEM_NBUCKETS];
+static struct safe_mem_hdr *safe_mem_hdr_last[SAFEMEM_NBUCKETS];
 static struct safe_mem_bucket_md safe_mem_bucket_md[SAFEMEM_NBUCKETS];
 
+/*
+ * Every allocation is mlock()ed, which takes a system call, and memory
+ * is never munlock()ed again, as other allocations may share its pages.
+ * Small freed blocks are therefore kept by size and handed out again
+ * without locking them anew, since loops allocate and free temporaries
+ * by the million.
+ */
+#define SAFEMEM_CACHE_UNIT	16
+#define SAFEMEM_CACHE_CLASSES	16	/* blocks of up to 256 bytes */
+#define SAFEMEM_CACHE_MAX	1024	/* blocks kept of each size */
+
+struct safe_mem_free
+{
+	struct safe_mem_free *next;
+};
+
+static struct safe_mem_free *safe_mem_cache[SAFEMEM_CACHE_CLASSES];
+static int safe_mem_ncached[SAFEMEM_CACHE_CLASSES];
+
 void
 init_safe_mem_bucket(int bucket, safe_mem_ctor_t ctor, safe_mem_dtor_t dtor)
 {
@@ -78,6 +98,18 @@ init_safe_mem_bucket(int bucket, safe_mem_ctor_t ctor, safe_mem_dtor_t dtor)
 	safe_mem_bucket_md[bucket].dtor = dtor;
 }
 
+/* Returns the size class of a block of alloc_sz bytes, or -1. */
+static
+int
+safe_mem_class(size_t alloc_sz)
+{
+	size_t cls;
+
+	cls = (alloc_sz + SAFEMEM_CACHE_UNIT - 1) / SAFEMEM_CACHE_UNIT;
+
+	return (cls <= SAFEMEM_CACHE_CLASSES) ? (int)cls - 1 : -1;
+}
+
 void *
 _alloc_safe_mem(int bucket, size_t req_sz, const char *file, int line)
 {
@@ -85,10 +117,21 @@ _alloc_safe_mem(int bucket, size_t req_sz, const char *file, int line)
 	struct safe_mem_tail *tail;
 	size_t alloc_sz;
 	char *mem, *user_mem;
+	int cls;
 
 	assert(bucket < SAFEMEM_NBUCKETS);
 
 	alloc_sz = req_sz + sizeof(*hdr) + sizeof(*tail);
+	if ((cls = safe_mem_class(alloc_sz)) >= 0) {
+		alloc_sz = (cls + 1) * SAFEMEM_CACHE_UNIT;
+		if (safe_mem_cache[cls] != NULL) {
+			mem = (char *)safe_mem_cache[cls];
+			safe_mem_cache[cls] = safe_mem_cache[cls]->next;
+			--safe_mem_ncached[cls];
+			goto locked;
+		}
+	}
+
 	if ((mem = malloc(alloc_sz)) == NULL) {
 #ifdef DEBUG
 		fprintf(stderr, "_alloc_safe_mem: %s:%d, malloc(%ju) == NULL: %s\n",
@@ -108,6 +151,7 @@ _alloc_safe_mem(int bucket, size_t req_sz, const char *file, int line)
 #endif
 	}
 
+locked:
 	memset(mem, 0, alloc_sz);
 
 	hdr = (struct safe_mem_hdr *) mem;
@@ -122,15 +166,18 @@ _alloc_safe_mem(int bucket, size_t req_sz, const char *file, int line)
 	hdr->line = line;
 	hdr->next = NULL;
 
+	/*
+	 * Temporaries pile up by the thousand while a loop runs, so the
+	 * tail of each list is tracked instead of being searched for.
+	 */
 	if (safe_mem_hdr_first[bucket] == NULL) {
 		safe_mem_hdr_first[bucket] = hdr;
 	} else {
-		hdrp = safe_mem_hdr_first[bucket];
-		while (hdrp->next != NULL)
-			hdrp = hdrp->next;
+		hdrp = safe_mem_hdr_last[bucket];
 		hdr->prev = hdrp;
 		hdrp->next = hdr;
 	}
+	safe_mem_hdr_last[bucket] = hdr;
 
 	if ((safe_mem_bucket_md[bucket].used) &&
 	    (safe_mem_bucket_md[bucket].ctor != NULL))
@@ -148,6 +195,7 @@ _free_safe_mem(int bucket, void *mem_ptr, const char *file, int line)
 	struct safe_mem_tail *tail;
 	size_t alloc_sz;
 	char *mem = mem_ptr;
+	int cls;
 
 	assert(bucket < SAFEMEM_NBUCKETS);
 
@@ -188,6 +236,8 @@ _free_safe_mem(int bucket, void *mem_ptr, const char *file, int line)
 		hdr->next->prev = hdr->prev;
 	if (safe_mem_hdr_first[bucket] == hdr)
 		safe_mem_hdr_first[bucket] = hdr->next;
+	if (safe_mem_hdr_last[bucket] == hdr)
+		safe_mem_hdr_last[bucket] = hdr->prev;
 
 	if ((safe_mem_bucket_md[bucket].used) &&
 	    (safe_mem_bucket_md[bucket].dtor != NULL))
@@ -202,6 +252,14 @@ _free_safe_mem(int bucket, void *mem_ptr, const char *file, int line)
 #if 0
 	munlock(mem, alloc_sz);
 #endif
+	if ((cls = safe_mem_class(alloc_sz)) >= 0 &&
+	    safe_mem_ncached[cls] < SAFEMEM_CACHE_MAX) {
+		((struct safe_mem_free *)mem)->next = safe_mem_cache[cls];
+		safe_mem_cache[cls] = (struct safe_mem_free *)mem;
+		++safe_mem_ncached[cls];
+		return;
+	}
+
 	free(mem);
 }
 
@@ -240,6 +298,51 @@ free_safe_mem_bucket(int bucket)
 	}
 }
 
+/* Returns the newest allocation in bucket, or NULL if it is empty. */
+void *
+safe_mem_last(int bucket)
+{
+	struct safe_mem_hdr *hdr;
+
+	assert(bucket < SAFEMEM_NBUCKETS);
+
+	if ((hdr = safe_mem_hdr_last[bucket]) == NULL)
+		return NULL;
+
+	return (char *)hdr + sizeof(*hdr);
+}
+
+/*
+ * Frees everything allocated from bucket after mark, as returned by
+ * safe_mem_last(), except for the nkeep allocations in keep.
+ */
+void
+free_safe_mem_since(int bucket, void *mark, void **keep, int nkeep)
+{
+	struct safe_mem_hdr *hdr, *next;
+	char *mem;
+	int i;
+
+	assert(bucket < SAFEMEM_NBUCKETS);
+
+	if (mark == NULL)
+		hdr = safe_mem_hdr_first[bucket];
+	else
+		hdr = ((struct safe_mem_hdr *)((char *)mark -
+		    sizeof(*hdr)))->next;
+
+	for (; hdr != NULL; hdr = next) {
+		next = hdr->next;
+		mem = (char *)hdr + sizeof(*hdr);
+
+		for (i = 0; i < nkeep; i++)
+			if (keep[i] == mem)
+				break;
+		if (i == nkeep)
+			_free_safe_mem(bucket, mem, "free_safe_mem_since", 0);
+	}
+}
+
 void
 check_and_purge_safe_mem(void)
 {
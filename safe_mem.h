@@ -50,5 +50,7 @@ void *_alloc_safe_mem(int bucket, size_t req_sz, const char *file, int line);
 void _free_safe_mem(int bucket, void *mem, const char *file, int line);
 void check_and_purge_safe_mem(void);
 void free_safe_mem_bucket(int bucket);
+void *safe_mem_last(int bucket);
+void free_safe_mem_since(int bucket, void *mark, void **keep, int nkeep);
 void init_safe_mem_bucket(int bucket, safe_mem_ctor_t ctor,
     safe_mem_dtor_t dtor);
@@ -0,0 +1,17 @@
+#ifndef _TESTS_HARNESS_H
+#define _TESTS_HARNESS_H
+
+struct valid_case {
+	const char *expr;
+	const char *expected;
+};
+
+extern int failures;
+
+void fatal(const char *msg);
+char *read_file(const char *path);
+char *run_expr(const char *expr);
+void expect_output(const char *expr, const char *expected);
+void expect_error(const char *expr);
+
+#endif
@@ -0,0 +1,63 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "harness.h"
+
+int
+main(void)
+{
+	static const struct valid_case valid_cases[] = {
+		{ "popcount(0xF0F0)", "8\n" },
+		{ "popcount(2**100 - 1)", "100\n" },
+		{ "hamdist(0b1010, 0b0110)", "2\n" },
+		{ "hamdist(2**70, 1)", "2\n" },
+		{ "bits(0)", "1\n" },
+		{ "bits(2**64 - 1)", "64\n" },
+		{ "bits(2**64)", "65\n" },
+		{ "msb(2**63)", "63\n" },
+		{ "ctz(-8)", "3\n" },
+		{ "ctz(2**80)", "80\n" },
+		{ "clz(1)", "63\n" },
+		{ "clz(1, 32)", "31\n" },
+		{ "clz(0, 8)", "8\n" },
+		{ "pdep(0b101, 0b11100)", "20\n" },
+		{ "pext(0b10100, 0b11100)", "5\n" },
+		{ "pext(0xFFFFFFFFFFFFFFFF, 0x8000000000000001)", "3\n" },
+		{ "pext(2**100 + 2**99, 2**100 + 2**99 + 1)", "6\n" },
+		{ "pdep(7, 2**100 + 2**70 + 1)", "1267650601408821022214114508801\n" },
+		{ "pext(pdep(12345, 2**200 - 2**90 + 0xF0F0), 2**200 - 2**90 + 0xF0F0)", "12345\n" },
+		{ "bitrev(1, 8)", "128\n" },
+		{ "bitrev(1)", "9223372036854775808\n" },
+		{ "bswap(0x1234, 16)", "13330\n" },
+		{ "bswap(0x0102030405060708)", "578437695752307201\n" },
+		{ "rotl(0x81, 1, 8)", "3\n" },
+		{ "rotr(3, 1, 8)", "129\n" },
+		{ "rotl(1, -1)", "9223372036854775808\n" },
+		{ "rotl(-1, 3, 8)", "255\n" },
+		{ "rotr(0x1234, 68, 16)", "16675\n" },
+	};
+	static const char *invalid_cases[] = {
+		"clz(1, 65)",
+		"bitrev(1, 0)",
+		"bswap(1, 12)",
+		"pdep(-1, 3)",
+		"pext(3, -1)",
+		"msb(0)",
+	};
+	size_t i;
+
+	for (i = 0; i < sizeof(valid_cases) / sizeof(valid_cases[0]); ++i)
+		expect_output(valid_cases[i].expr, valid_cases[i].expected);
+
+	for (i = 0; i < sizeof(invalid_cases) / sizeof(invalid_cases[0]); ++i)
+		expect_error(invalid_cases[i]);
+
+	if (failures != 0) {
+		fprintf(stderr, "%d test(s) failed\n", failures);
+		return 1;
+	}
+
+	printf("Bit operation tests passed\n");
+	return 0;
+}
@@ -0,0 +1,59 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "harness.h"
+
+int
+main(void)
+{
+	static const struct valid_case valid_cases[] = {
+		{ "function f(x) = x**2; endfunction\ndiff(f, 3)", "Defined function 'f'\n6\n" },
+		{ "diff(sin, 0)", "1\n" },
+		{ "diff(exp, 1)", "2.71828\n" },
+		{ "function g(x, y) = x*y + y**3; endfunction\ngrad(g, 2, 5)", "Defined function 'g'\nx | 5\ny | 77\n" },
+		{ "grad(hypot, 3, 4)", "1 | 0.600000\n2 | 0.800000\n" },
+		{ "function g(x, y) = x*y + y**3; endfunction\ndiff(g, 2, 5)", "Defined function 'g'\n5\n" },
+		{ "function p(x) = if (x < 0) then -x; else x*x*x; fi endfunction\ndiff(p, -2)\ndiff(p, 2)", "Defined function 'p'\n-1\n12\n" },
+		{ "function s(n) = t = 0; i = 1; while (i <= n) do t = t + i*n**i; i = i + 1; done t; endfunction\ndiff(s, 3)", "Defined function 's'\n94\n" },
+		{ "function r(x) = if (x < 1) then 1; else x * r(x - 1); fi endfunction\ndiff(r, 4)", "Defined function 'r'\n50\n" },
+		{ "function h(x) = atan2(x, 1) + root(x, 3) + abs(x) + max(x, 2*x); endfunction\ndiff(h, 8)", "Defined function 'h'\n3.09872\n" },
+		{ "a = 3;\nfunction k(x) = a * x**3; endfunction\ndiff(k, 2)", "3\nDefined function 'k'\n36\n" },
+		{ "function c(x) = 2**x; endfunction\ndiff(c, 3) == 8 * ln(2)", "Defined function 'c'\n1\n" },
+		{ "function m(x) = x % 3; endfunction\ndiff(m, 7.5)", "Defined function 'm'\n1\n" },
+		{ "diff(ln, 4)", "0.25\n" },
+		{ "diff(sqrt, 0)", "inf\n" },
+		{ "diff(tanh, 0)", "1\n" },
+		{ "diff(cos, pi / 2)", "-1\n" },
+		{ "diff(avg, 1, 2, 3)", "0.333333\n" },
+		{ "interval on\ndiff(sin, 1)", "0.5403023058681397174009366074429766037323104206179222276700972553811003947745\n" },
+		{ "1/0", "inf\n" },
+		{ "function c(n) = if n == 0 then 0; else 1 + c(n - 1); fi endfunction\ndiff(c, 500)", "Defined function 'c'\n0\n" },
+	};
+	static const char *invalid_cases[] = {
+		"diff(popcount, 3)",
+		"function b(x) = x & 3; endfunction\ndiff(b, 2)",
+		"diff(root, 8, 3)\ngrad(root, 8, 3)",
+		"diff(q, 1)",
+		"diff(tabulate, 1)",
+		"diff(sin, 1, 2)",
+		"diff(1, 2)",
+		"function c(n) = if n == 0 then 0; else 1 + c(n - 1); fi endfunction\ndiff(c, 200000)",
+		"vm off\nfunction c(n) = if n == 0 then 0; else 1 + c(n - 1); fi endfunction\ngrad(c, 200000)",
+	};
+	size_t i;
+
+	for (i = 0; i < sizeof(valid_cases) / sizeof(valid_cases[0]); ++i)
+		expect_output(valid_cases[i].expr, valid_cases[i].expected);
+
+	for (i = 0; i < sizeof(invalid_cases) / sizeof(invalid_cases[0]); ++i)
+		expect_error(invalid_cases[i]);
+
+	if (failures != 0) {
+		fprintf(stderr, "%d test(s) failed\n", failures);
+		return 1;
+	}
+
+	printf("Differentiation tests passed\n");
+	return 0;
+}
@@ -0,0 +1,54 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "harness.h"
+
+int
+main(void)
+{
+	static const struct valid_case valid_cases[] = {
+		{ "fixed(1.3, 4, 4)", "1.25\n" },
+		{ "fxraw(fixed(-0.5, 4, 4))", "-8\n" },
+		{ "fixed(1.3, 4, 4) * fixed(1.3, 4, 4)", "1.5625\n" },
+		{ "fixed(1, 4, 4) / 3", "0.3125\n" },
+		{ "1 + fixed(0.5, 16, 16)", "1.5\n" },
+		{ "fixed(100, 4, 4)", "7.9375\n" },
+		{ "-fixed(-8, 4, 4)", "7.9375\n" },
+		{ "ufixed(-1, 8, 0)", "0\n" },
+		{ "fxmode wrap\nfixed(9, 4, 4)", "-7\n" },
+		{ "fxmode wrap\nufixed(300, 8, 0)", "44\n" },
+		{ "fxmode round\nfixed(0.03125, 4, 4)", "0.0625\n" },
+		{ "fxmode conv\nfixed(0.03125, 4, 4)", "0\n" },
+		{ "fxmode conv\nfixed(0.09375, 4, 4)", "0.125\n" },
+		{ "fxmode zero\nfixed(-0.03, 4, 4)", "0\n" },
+		{ "fixed(-0.03, 4, 4)", "-0.0625\n" },
+		{ "fixed(2, 40, 60) ** 3", "8\n" },
+		{ "fixed(0.1, 8, 100) == fixed(0.1, 8, 100)", "1\n" },
+		{ "mode x\nfixed(-1, 4, 4)", "0xf0\n" },
+		{ "mode b\nufixed(5, 4, 0)", "0b0101\n" },
+	};
+	static const char *invalid_cases[] = {
+		"fixed(1, 0, 4)",
+		"ufixed(1, 4, -1)",
+		"fixed(1, 4, 4) / 0",
+		"fixed(1.5, 4, 4) ** 0.5",
+		"fxraw(1.5)",
+		"fxmode bogus",
+	};
+	size_t i;
+
+	for (i = 0; i < sizeof(valid_cases) / sizeof(valid_cases[0]); ++i)
+		expect_output(valid_cases[i].expr, valid_cases[i].expected);
+
+	for (i = 0; i < sizeof(invalid_cases) / sizeof(invalid_cases[0]); ++i)
+		expect_error(invalid_cases[i]);
+
+	if (failures != 0) {
+		fprintf(stderr, "%d test(s) failed\n", failures);
+		return 1;
+	}
+
+	printf("fixed-point tests passed\n");
+	return 0;
+}
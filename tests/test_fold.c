@@ -0,0 +1,49 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "harness.h"
+
+int
+main(void)
+{
+	static const struct valid_case valid_cases[] = {
+		{ "function rad(d) = d * 2 * pi / 360; endfunction\nrad(180) == pi", "Defined function 'rad'\n1\n" },
+		{ "k = 2\nfunction f(x) = x * k; endfunction\nf(3)\nk = 5\nf(3)", "2\nDefined function 'f'\n6\n5\n15\n" },
+		{ "function g(z) = 2 ** 10; endfunction\ng(0)\nmodulus 1000\ng(0)\nmodulus off\ng(0)", "Defined function 'g'\n1024\n24\n1024\n" },
+		{ "function h(x) = if x then primorial(-1); else 1; fi endfunction\nh(0)", "Defined function 'h'\n1\n" },
+		{ "function r(z) = seed(1); randint(1, 1000000); endfunction\nr(0) == r(0)", "Defined function 'r'\n1\n" },
+		{ "function d(x) = 5; 6; x; endfunction\nd(9)", "Defined function 'd'\n9\n" },
+		{ "function sh(pi) = pi * 2; endfunction\nsh(3)", "Defined function 'sh'\n6\n" },
+		{ "k = 5\nfunction a2(x) = k = k + x; k; endfunction\na2(1)\nk", "5\nDefined function 'a2'\n6\n5\n" },
+		{ "function fa(z) = ans; endfunction\n5\nfa(0)\n7\nfa(0)", "Defined function 'fa'\n5\n5\n7\n7\n" },
+		{ "function c(z) = if 1 < 2 then 10; else 20; fi endfunction\nc(0)", "Defined function 'c'\n10\n" },
+		{ "function w(z) = while 0 do 1; done endfunction\nw(0)", "Defined function 'w'\n0\n" },
+		{ "function ip(z) = pi * 1; endfunction\ninterval on\nip(0) == pi\ninterval off\nip(0)", "Defined function 'ip'\n1\n3.14159\n" },
+		{ "function sm(x) = sqrt(2) * x; endfunction\nmode x\nsm(2)", "Defined function 'sm'\n0x2\n" },
+		{ "function q(x) = x + 0x0F[3:0] + (1 << 4) + 5!; endfunction\nq(1)", "Defined function 'q'\n152\n" },
+		{ "function tp(x) = x * pi; endfunction\ntp(2) == 2 * pi\npi = 3\ntp(2)", "Defined function 'tp'\n1\n3\n6\n" },
+		{ "vm off\nfunction tp(x) = x * pi; endfunction\ntp(2) == 2 * pi\npi = 3\ntp(2)", "Defined function 'tp'\n1\n3\n6\n" },
+		{ "vm off\nfunction g(z) = 2 ** 10; endfunction\ng(0)\nmodulus 1000\ng(0)\nmodulus off\ng(0)", "Defined function 'g'\n1024\n24\n1024\n" },
+		{ "vm off\nfunction c(z) = if 1 < 2 then 10; else nosuchvar; fi endfunction\nc(0)", "Defined function 'c'\n10\n" },
+	};
+	static const char *invalid_cases[] = {
+		"function h(x) = if x then primorial(-1); else 1; fi endfunction\nh(1)",
+		"function b(z) = nosuchvar; 3; endfunction\nb(0)",
+	};
+	size_t i;
+
+	for (i = 0; i < sizeof(valid_cases) / sizeof(valid_cases[0]); ++i)
+		expect_output(valid_cases[i].expr, valid_cases[i].expected);
+
+	for (i = 0; i < sizeof(invalid_cases) / sizeof(invalid_cases[0]); ++i)
+		expect_error(invalid_cases[i]);
+
+	if (failures != 0) {
+		fprintf(stderr, "%d test(s) failed\n", failures);
+		return 1;
+	}
+
+	printf("Constant folding tests passed\n");
+	return 0;
+}
@@ -0,0 +1,48 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "harness.h"
+
+int
+main(void)
+{
+	static const struct valid_case valid_cases[] = {
+		{ "interval on\n0.1 + 0.2", "0.30000000000000000000000000000000000000000000000000000000000000000000000000000\n" },
+		{ "interval on\n1/3", "0.33333333333333333333333333333333333333333333333333333333333333333333333333333\n" },
+		{ "interval on\n7/2", "3.5\n" },
+		{ "interval on\n2**-2", "0.25\n" },
+		{ "interval on\n2 + 3", "5\n" },
+		{ "interval on\nsqrt(2)", "1.4142135623730950488016887242096980785696718753769480731766797379907324784621\n" },
+		{ "interval on\npi", "3.1415926535897932384626433832795028841971693993751058209749445923078164062862\n" },
+		{ "interval on\nx = sqrt(2);\nx * x", "1.4142135623730950488016887242096980785696718753769480731766797379907324784621\n2.0000000000000000000000000000000000000000000000000000000000000000000000000000\n" },
+		{ "interval on\n(1 + 1e-20) - 1", "1.00000000000000000000000000000000000000000000000000000000e-20\n" },
+		{ "interval on\nsin(pi)", "[-2.35755e-77, 1.09692e-77]\n" },
+		{ "interval on\n1/(0.1 - 0.1)", "[-inf, inf]\n" },
+		{ "interval on\nw = (1e80 + 0.5) - 1e80;\ncos(w)\ncos(pi + w * 1e-4)\nabs(w - 1)", "[0, 1024]\n[-1, 1]\n-1\n[0, 1023]\n" },
+		{ "interval on\nmode s\n1e-20 * 3", "3.000000000000000000000000000000000000000000000000000000000000000000000000000e-20\n" },
+		{ "interval on\nexp(1) - e", "[-3.45447e-77, 3.45447e-77]\n" },
+		{ "interval on\ninterval off\n0.1 + 0.2", "0.3\n" },
+	};
+	static const char *invalid_cases[] = {
+		"interval on\n2.5 % 1",
+		"interval on\natan2(1, 2)",
+		"interval on\n(0-1)**0.5",
+		"interval maybe",
+	};
+	size_t i;
+
+	for (i = 0; i < sizeof(valid_cases) / sizeof(valid_cases[0]); ++i)
+		expect_output(valid_cases[i].expr, valid_cases[i].expected);
+
+	for (i = 0; i < sizeof(invalid_cases) / sizeof(invalid_cases[0]); ++i)
+		expect_error(invalid_cases[i]);
+
+	if (failures != 0) {
+		fprintf(stderr, "%d test(s) failed\n", failures);
+		return 1;
+	}
+
+	printf("Interval tests passed\n");
+	return 0;
+}
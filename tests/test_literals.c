@@ -0,0 +1,40 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "harness.h"
+
+int
+main(void)
+{
+	static const struct valid_case valid_cases[] = {
+		{ "18446744073709551615", "18446744073709551615\n" },
+		{ "18446744073709551616", "18446744073709551616\n" },
+		{ "0xFFFF_FFFF_FFFF_FFFF_F", "295147905179352825855\n" },
+		{ "0b10000000000000000000000000000000000000000000000000000000000000000000000", "1180591620717411303424\n" },
+		{ "123456789_123456789_123456789_123456789_123456789_123456789_123456789_123456789_123456789_123456789_123456789_123456789_123456789_123456789_123456789_123456789_123456789_123456789_123456789_123456789", "123456789123456789123456789123456789123456789123456789123456789123456789123456789123456789123456789123456789123456789123456789123456789123456789123456789123456789123456789123456789\n" },
+		{ "123456789_123456789_123456789_123456789_123456789_123456789_123456789_123456789_123456789_123456789_123456789_123456789_123456789_123456789_123456789_123456789_123456789_123456789_123456789_123456789 % 1000", "789\n" },
+		{ "1p == 1e-12", "1\n" },
+		{ "3.3n == 3.3e-9", "1\n" },
+		{ "4.7u == 0.0000047", "1\n" },
+		{ "0.1m == 1e-4", "1\n" },
+		{ "2.5E == 25e17", "1\n" },
+		{ "1.5k", "1500\n" },
+		{ "1e-400", "1e-400\n" },
+		{ ".5", "0.5\n" },
+		{ "x = 1000\nx + 1_000 + 0x3E8 + 1k", "1000\n4000\n" },
+		{ "function f(a) = a + 7 + 7; endfunction\nf(1)\nfunction f(a) = a * 7; endfunction\nf(2)\n7", "Defined function 'f'\n15\nDefined function 'f'\n14\n7\n" },
+	};
+	size_t i;
+
+	for (i = 0; i < sizeof(valid_cases) / sizeof(valid_cases[0]); ++i)
+		expect_output(valid_cases[i].expr, valid_cases[i].expected);
+
+	if (failures != 0) {
+		fprintf(stderr, "%d test(s) failed\n", failures);
+		return 1;
+	}
+
+	printf("Literal tests passed\n");
+	return 0;
+}
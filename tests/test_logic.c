@@ -0,0 +1,58 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "harness.h"
+
+int
+main(void)
+{
+	static const struct valid_case valid_cases[] = {
+		{ "1 && 2", "1\n" },
+		{ "1 && 0", "0\n" },
+		{ "0 || 0.5", "1\n" },
+		{ "0 || 0", "0\n" },
+		{ "3 & 4", "0\n" },
+		{ "3 && 4", "1\n" },
+		{ "1 < 2 && 2 < 3", "1\n" },
+		{ "0 && 1 || 1", "1\n" },
+		{ "1 || 1 && 0", "1\n" },
+		{ "0 && primorial(-1)", "0\n" },
+		{ "1 || primorial(-1)", "1\n" },
+		{ "x = 0\n0 && (x = 5)\nx", "0\n0\n0\n" },
+		{ "x = 0\n1 && (x = 5)\nx", "0\n1\n5\n" },
+		{ "2 > 1 ? 10 : 20", "10\n" },
+		{ "0 ? 10 : 1 ? 20 : 30", "20\n" },
+		{ "1 ? 2 : 3 + 4", "2\n" },
+		{ "0 ? primorial(-1) : 7", "7\n" },
+		{ "0xFF[1 ? 3 : 2:0]", "15\n" },
+		{ "function f(n) = n > 0 && sqrt(n) > 2; endfunction\nf(-1)\nf(9)", "Defined function 'f'\n0\n1\n" },
+		{ "vm off\nfunction f(n) = n > 0 && sqrt(n) > 2; endfunction\nf(-1)\nf(9)", "Defined function 'f'\n0\n1\n" },
+		{ "function ab(x) = x < 0 ? -x : x; endfunction\nab(-3) + ab(4)", "Defined function 'ab'\n7\n" },
+		{ "vm off\nfunction ab(x) = x < 0 ? -x : x; endfunction\nab(-3) + ab(4)", "Defined function 'ab'\n7\n" },
+		{ "function c(n) = i = 0; k = 0; while i < n do k = k + (i % 2 == 0 || i % 3 == 0); i = i + 1; done k; endfunction\nc(12)", "Defined function 'c'\n8\n" },
+		{ "vm off\nfunction c(n) = i = 0; k = 0; while i < n do k = k + (i % 2 == 0 || i % 3 == 0); i = i + 1; done k; endfunction\nc(12)", "Defined function 'c'\n8\n" },
+	};
+	static const char *invalid_cases[] = {
+		"1 && primorial(-1)",
+		"0 || primorial(-1)",
+		"1 ? primorial(-1) : 7",
+		"1 ?",
+		"1 && ",
+	};
+	size_t i;
+
+	for (i = 0; i < sizeof(valid_cases) / sizeof(valid_cases[0]); ++i)
+		expect_output(valid_cases[i].expr, valid_cases[i].expected);
+
+	for (i = 0; i < sizeof(invalid_cases) / sizeof(invalid_cases[0]); ++i)
+		expect_error(invalid_cases[i]);
+
+	if (failures != 0) {
+		fprintf(stderr, "%d test(s) failed\n", failures);
+		return 1;
+	}
+
+	printf("Logical operator tests passed\n");
+	return 0;
+}
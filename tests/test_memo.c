@@ -0,0 +1,48 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "harness.h"
+
+int
+main(void)
+{
+	static const struct valid_case valid_cases[] = {
+		{ "sin(1)\nsin(1)\ncachestats", "0.841471\n0.841471\nMemo cache: 1/1024 entries, 1 hits, 1 misses\n" },
+		{ "atan2(1, 2)\natan2(1, 2)\natan2(2, 1)\ncachestats", "0.463648\n0.463648\n1.10715\nMemo cache: 2/1024 entries, 1 hits, 2 misses\n" },
+		{ "exp(1)\nln(1)\nexp(1)\ncachestats", "2.71828\n0\n2.71828\nMemo cache: 2/1024 entries, 1 hits, 2 misses\n" },
+		{ "sin(1)\nmode h\nsin(1)\ncachestats", "0.841471\n0x0\nMemo cache: 2/1024 entries, 0 hits, 2 misses\n" },
+		{ "x = 0\nwhile x < 300 do x = x + 1; y = cos(x % 4); done\ncachestats", "0\n1\nMemo cache: 4/1024 entries, 296 hits, 4 misses\n" },
+		{ "x = 0\nwhile x < 1030 do x = x + 1; y = sqrt(x); done\nsqrt(1030)\nsqrt(3)\ncachestats", "0\n32.0936\n32.0936\n1.73205\nMemo cache: 1024/1024 entries, 1 hits, 1031 misses\n" },
+		{ "exp(2**-30)\nexp(2**-30 + 2**-52)\ncachestats", "1\n1\nMemo cache: 2/1024 entries, 0 hits, 2 misses\n" },
+		{ "memo function fib(n) = if n < 2 then n; else fib(n - 1) + fib(n - 2); fi endfunction\nfib(100)\ncachestats", "Defined memo function 'fib'\n354224848179261915075\nMemo cache: 0/1024 entries, 0 hits, 0 misses\nMemo function 'fib': 101/65536 entries, 98 hits, 101 misses\n" },
+		{ "vm off\nmemo function fib(n) = if n < 2 then n; else fib(n - 1) + fib(n - 2); fi endfunction\nfib(100)\ncachestats", "Defined memo function 'fib'\n354224848179261915075\nMemo cache: 0/1024 entries, 0 hits, 0 misses\nMemo function 'fib': 101/65536 entries, 98 hits, 101 misses\n" },
+		{ "memo function fib(n) = if n < 2 then n; else fib(n - 1) + fib(n - 2); fi endfunction\nfib(20000) % 1000000", "Defined memo function 'fib'\n93125\n" },
+		{ "memo function h(x) = x * 2; endfunction\nh(3)\nh(3.0)\nh(3)\ncachestats", "Defined memo function 'h'\n6\n6\n6\nMemo cache: 0/1024 entries, 0 hits, 0 misses\nMemo function 'h': 2/65536 entries, 1 hits, 2 misses\n" },
+		{ "memo function h(x) = x * 2; endfunction\nh(3)\nmemo function h(x) = x * 3; endfunction\nh(3)\ncachestats", "Defined memo function 'h'\n6\nDefined memo function 'h'\n9\nMemo cache: 0/1024 entries, 0 hits, 0 misses\nMemo function 'h': 1/65536 entries, 0 hits, 1 misses\n" },
+		{ "memo function g(x) = x * pi; endfunction\ng(5)\npi = 3\ng(5)", "Defined memo function 'g'\n15.708\n3\n15\n" },
+		{ "memo function t(n, a) = if n == 0 then a; else t(n - 1, a + 1); fi endfunction\nt(100, 0)\nt(50, 50)", "Defined memo function 't'\n100\n100\n" },
+		{ "memory = 4\nmemory", "4\n4\n" },
+		{ "memo function p(x) = x; endfunction\np(0.5)\np(0.5)\np(fixed(0.5, 4, 4))\np(fixed(0.5, 4, 4))\np(fixed(0.5, 4, 8))\ncachestats", "Defined memo function 'p'\n0.5\n0.5\n0.5\n0.5\n0.5\nMemo cache: 0/1024 entries, 0 hits, 0 misses\nMemo function 'p': 3/65536 entries, 2 hits, 3 misses\n" },
+	};
+	static const char *invalid_cases[] = {
+		"memo function f(x) = x; endfunction\nf(nosuch)",
+		"vm off\nmemo function f(x) = x; endfunction\nf(nosuch)",
+		"vm off\nsin(nosuch)",
+	};
+	size_t i;
+
+	for (i = 0; i < sizeof(valid_cases) / sizeof(valid_cases[0]); ++i)
+		expect_output(valid_cases[i].expr, valid_cases[i].expected);
+
+	for (i = 0; i < sizeof(invalid_cases) / sizeof(invalid_cases[0]); ++i)
+		expect_error(invalid_cases[i]);
+
+	if (failures != 0) {
+		fprintf(stderr, "%d test(s) failed\n", failures);
+		return 1;
+	}
+
+	printf("Memo cache tests passed\n");
+	return 0;
+}
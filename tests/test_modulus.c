@@ -0,0 +1,50 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "harness.h"
+
+int
+main(void)
+{
+	static const struct valid_case valid_cases[] = {
+		{ "modulus 1000000007\n2**100", "976371285\n" },
+		{ "modulus 1000000007\n5 - 7", "1000000005\n" },
+		{ "modulus 1000000007\n10**18 * 10**18", "2401\n" },
+		{ "modulus 1000000007\ninv(2)", "500000004\n" },
+		{ "modulus 1000000007\n2**-1", "500000004\n" },
+		{ "modulus 1000000007\n3**-2 * 9", "1\n" },
+		{ "modulus 1000000007\n7 / 2\n7 % 4\n-3", "3.5\n3\n-3\n" },
+		{ "modulus 9223372036854775783\n(2**62) * 6", "75\n" },
+		{ "modulus 9223372036854775783\n3**1180591620717411303424", "5955126212066484025\n" },
+		{ "modulus 4611686018427387904\n3**1000 - 1", "1591621678364384032\n" },
+		{ "modulus 340282366920938463463374607431768211507\n5 - 7\n3 * inv(3)", "340282366920938463463374607431768211505\n1\n" },
+		{ "modulus 0x10000000000000000\n0 - 1", "18446744073709551615\n" },
+		{ "modulus 12\ninv(5)\n5**-1", "5\n5\n" },
+		{ "modulus 97\nmodulus off\n5 - 7", "-2\n" },
+		{ "function f(x) = x**3 + 2*x + 1; endfunction\nmodulus 101\nf(100)", "Defined function 'f'\n99\n" },
+		{ "inv(3, 11)", "4\n" },
+	};
+	static const char *invalid_cases[] = {
+		"modulus 12\ninv(6)",
+		"modulus 12\n6**-1",
+		"inv(3)",
+		"modulus 1",
+		"modulus foo",
+	};
+	size_t i;
+
+	for (i = 0; i < sizeof(valid_cases) / sizeof(valid_cases[0]); ++i)
+		expect_output(valid_cases[i].expr, valid_cases[i].expected);
+
+	for (i = 0; i < sizeof(invalid_cases) / sizeof(invalid_cases[0]); ++i)
+		expect_error(invalid_cases[i]);
+
+	if (failures != 0) {
+		fprintf(stderr, "%d test(s) failed\n", failures);
+		return 1;
+	}
+
+	printf("Modulus tests passed\n");
+	return 0;
+}
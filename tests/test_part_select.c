@@ -0,0 +1,51 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "harness.h"
+
+int
+main(void)
+{
+	static const struct valid_case valid_cases[] = {
+		{ "0xABCD[7:4]", "12\n" },
+		{ "0xABCD[15-:4]", "10\n" },
+		{ "0xABCD[3]", "1\n" },
+		{ "(-1)[70:60]", "2047\n" },
+		{ "(-256)[9:4]", "48\n" },
+		{ "(2**200 + 5)[200:198]", "4\n" },
+		{ "(2**200 + 5)[2:0]", "5\n" },
+		{ "(2**200)[400:300]", "0\n" },
+		{ "0xABCD[3-:0]", "0\n" },
+		{ "x = 0xABCD\nx[7:4] = 5\nx", "43981\n5\n43869\n" },
+		{ "x = 0\nx[31-:8] = 0x1FF\nx", "0\n255\n4278190080\n" },
+		{ "x = 1\nx[130:128] = 7\nx", "1\n7\n2381976568446569244243622252022377480193\n" },
+		{ "x = 2**200 + 3\nx[200] = 0\nx", "1606938044258990275541962092341162602522202993782792835301379\n0\n3\n" },
+		{ "x = -1\nx[7:0] = 0\nx", "-1\n0\n-256\n" },
+		{ "x = -1\nx[3:0] = -2\nx[3:0]", "-1\n14\n14\n" },
+		{ "y[70:63] = 255\ny", "255\n2351959869397967831040\n" },
+		{ "x = 2.75\nx[0] = 0\nx", "2.75\n0\n2\n" },
+		{ "function f(a) = a[3:0] = 9; a; endfunction\nx = 0xF0\nf(x)\nx", "Defined function 'f'\n240\n249\n240\n" },
+	};
+	static const char *invalid_cases[] = {
+		"3[1:0] = 1",
+		"0xFF[0:3]",
+		"x = 1\nx[-1:0] = 1",
+		"x = 1\nx[2-:4] = 1",
+	};
+	size_t i;
+
+	for (i = 0; i < sizeof(valid_cases) / sizeof(valid_cases[0]); ++i)
+		expect_output(valid_cases[i].expr, valid_cases[i].expected);
+
+	for (i = 0; i < sizeof(invalid_cases) / sizeof(invalid_cases[0]); ++i)
+		expect_error(invalid_cases[i]);
+
+	if (failures != 0) {
+		fprintf(stderr, "%d test(s) failed\n", failures);
+		return 1;
+	}
+
+	printf("Part select tests passed\n");
+	return 0;
+}
@@ -0,0 +1,61 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "harness.h"
+
+int
+main(void)
+{
+	static const struct valid_case valid_cases[] = {
+		{ "primepi(100)", "25\n" },
+		{ "primepi(1)", "0\n" },
+		{ "primepi(2)", "1\n" },
+		{ "threads 1\nprimepi(10**8)", "5761455\n" },
+		{ "threads 4\nprimepi(10**8)", "5761455\n" },
+		{ "countprimes(10, 20)", "4\n" },
+		{ "countprimes(-5, 2)", "1\n" },
+		{ "countprimes(20, 10)", "0\n" },
+		{ "threads 3\ncountprimes(10**12, 10**12 + 10**7)", "361726\n" },
+		{ "countprimes(2**64 - 1000, 2**64 - 1)", "21\n" },
+		{ "primes(90, 110)", "97\n101\n103\n107\n109\n5\n" },
+		{ "prevprime(100)", "97\n" },
+		{ "prevprime(3)", "2\n" },
+		{ "prevprime(2**89)", "618970019642690137449562111\n" },
+		{ "prevprime(2**64)", "18446744073709551557\n" },
+		{ "isprime(2**61 - 1)", "1\n" },
+		{ "isprime(561)", "0\n" },
+		{ "isprime(-7)", "0\n" },
+		{ "threads 4\npopcount(primorial(1000000))", "720253\n" },
+		{ "factor(360)", "2^3 * 3^2 * 5\n6\n" },
+		{ "factor(-12)", "-1 * 2^2 * 3\n3\n" },
+		{ "factor(1)", "1\n0\n" },
+		{ "factor(97)", "97\n1\n" },
+		{ "factor(3**40)", "3^40\n40\n" },
+		{ "factor(2**64 + 1)", "274177 * 67280421310721\n2\n" },
+		{ "factor((2**61 - 1) * (2**31 - 1))", "2147483647 * 2305843009213693951\n2\n" },
+		{ "factor(nextprime(10**15) * nextprime(10**17))", "1000000000000037 * 100000000000000003\n2\n" },
+		{ "threads 4\nfactor(2**128 + 1)", "59649589127497217 * 5704689200685129054721\n2\n" },
+	};
+	static const char *invalid_cases[] = {
+		"prevprime(2)",
+		"countprimes(0, 2**64)",
+		"factor(0)",
+		"factor(10, 0)",
+	};
+	size_t i;
+
+	for (i = 0; i < sizeof(valid_cases) / sizeof(valid_cases[0]); ++i)
+		expect_output(valid_cases[i].expr, valid_cases[i].expected);
+
+	for (i = 0; i < sizeof(invalid_cases) / sizeof(invalid_cases[0]); ++i)
+		expect_error(invalid_cases[i]);
+
+	if (failures != 0) {
+		fprintf(stderr, "%d test(s) failed\n", failures);
+		return 1;
+	}
+
+	printf("prime tests passed\n");
+	return 0;
+}
@@ -0,0 +1,82 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "harness.h"
+
+/*
+ * Checks that expr prints head, then count copies of fill, then tail.
+ */
+static void
+expect_pattern(const char *expr, const char *head, char fill, size_t count,
+    const char *tail)
+{
+	char *output, *p;
+	size_t i, hl, tl;
+
+	output = run_expr(expr);
+	hl = strlen(head);
+	tl = strlen(tail);
+
+	if (strlen(output) != hl + count + tl + 1 ||
+	    strncmp(output, head, hl) != 0) {
+		goto fail;
+	}
+	for (i = 0, p = output + hl; i < count; i++, p++) {
+		if (*p != fill)
+			goto fail;
+	}
+	if (strncmp(p, tail, tl) != 0 || strcmp(p + tl, "\n") != 0)
+		goto fail;
+
+	free(output);
+	return;
+
+fail:
+	fprintf(stderr, "FAIL: %s\nexpected: %s, %zu x '%c', %s\n",
+	    expr, head, count, fill, tail);
+	failures++;
+	free(output);
+}
+
+int
+main(void)
+{
+	expect_pattern("10**400000 - 1", "", '9', 400000, "");
+	expect_pattern("10**400000", "1", '0', 400000, "");
+	expect_pattern("0 - 10**400000", "-1", '0', 400000, "");
+	expect_pattern("10**400000 + 7", "1", '0', 399999, "7");
+	expect_pattern("7 * 10**(16384 * 40) + 5", "7", '0', 16384 * 40 - 1, "5");
+	expect_pattern("threads 3\n10**400000 - 1", "", '9', 400000, "");
+	expect_pattern("abbrev 0\n10**400000 - 1", "", '9', 400000, "");
+
+	expect_output("abbrev 100\n100000!",
+	    "2824229407...0000000000 (456574 digits)\n");
+	expect_output("abbrev 100\n0 - 7**300",
+	    "-3383857020...1584180001 (254 digits)\n");
+	expect_output("abbrev 100\n10**400 - 1",
+	    "9999999999...9999999999 (400 digits)\n");
+	expect_output("abbrev 100\n10**400",
+	    "1000000000...0000000000 (401 digits)\n");
+	expect_output("abbrev 100\n10**100 - 1",
+	    "9999999999999999999999999999999999999999999999999999999999999999999999999999999999999999999999999999\n");
+	expect_output("abbrev 100\n2**5000 + 0.0",
+	    "1412467032...7191909376 (1506 digits)\n");
+	expect_output("abbrev 100\nmode x\n2**1000 - 1",
+	    "0xffffffffff...ffffffffff (250 digits)\n");
+	expect_output("abbrev 100\nx = 3**500;\nls",
+	    "3636029179...5377610001 (239 digits)\n"
+	    "Variables:\nG = 0.915966\nans = 3636029179...5377610001 (239 digits)\n"
+	    "e = 2.71828\npi = 3.14159\nx = 3636029179...5377610001 (239 digits)\n");
+	expect_output("abbrev 10\n2**64", "18446744073709551616\n");
+	expect_output("ln(1)", "0\n");
+	expect_output("abbrev 10\nln(1)", "0\n");
+
+	if (failures != 0) {
+		fprintf(stderr, "%d test(s) failed\n", failures);
+		return 1;
+	}
+
+	printf("printing tests passed\n");
+	return 0;
+}
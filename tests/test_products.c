@@ -0,0 +1,53 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "harness.h"
+
+int
+main(void)
+{
+	static const struct valid_case valid_cases[] = {
+		{ "5!", "120\n" },
+		{ "primorial(10)", "210\n" },
+		{ "prod(5, 8)", "1680\n" },
+		{ "prod(-8, -5)", "1680\n" },
+		{ "prod(-7, -5)", "-210\n" },
+		{ "prod(-3, 4)", "0\n" },
+		{ "prod(9, 2)", "1\n" },
+		{ "threads 1\npopcount(200000!)", "1516114\n" },
+		{ "threads 4\npopcount(200000!)", "1516114\n" },
+		{ "threads 1\npopcount(primorial(1000000))", "720253\n" },
+		{ "threads 4\npopcount(primorial(1000000))", "720253\n" },
+		{ "threads 3\npopcount(prod(3, 70000))", "477338\n" },
+		{ "threads 4\nprod(1, 100000) == 100000!", "1\n" },
+		{ "(2**3000 + 1) % 7", "2\n" },
+		{ "(-3)**3", "-27\n" },
+		{ "2**-1", "0.5\n" },
+		{ "threads 1\npopcount((3**2000000) * (7**1500000))", "3692089\n" },
+		{ "threads 4\npopcount((3**2000000) * (7**1500000))", "3692089\n" },
+		{ "threads 9\npopcount((3**2000000) * (7**1500000))", "3692089\n" },
+		{ "threads 4\npopcount((3**9000000) * (5**500000))", "7711813\n" },
+		{ "threads 4\npopcount(3**5000000)", "3961583\n" },
+		{ "threads 4\n(5**3000000) * (5**3000000) == 5**6000000", "1\n" },
+	};
+	static const char *invalid_cases[] = {
+		"prod(2**70, 2**71)",
+		"primorial(-1)",
+	};
+	size_t i;
+
+	for (i = 0; i < sizeof(valid_cases) / sizeof(valid_cases[0]); ++i)
+		expect_output(valid_cases[i].expr, valid_cases[i].expected);
+
+	for (i = 0; i < sizeof(invalid_cases) / sizeof(invalid_cases[0]); ++i)
+		expect_error(invalid_cases[i]);
+
+	if (failures != 0) {
+		fprintf(stderr, "%d test(s) failed\n", failures);
+		return 1;
+	}
+
+	printf("product tests passed\n");
+	return 0;
+}
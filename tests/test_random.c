@@ -0,0 +1,65 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "harness.h"
+
+/* expr must print the same in a and b, whatever it prints */
+static void
+expect_same(const char *a, const char *b)
+{
+	char *out_a, *out_b;
+
+	out_a = run_expr(a);
+	out_b = run_expr(b);
+	if (strcmp(out_a, out_b) != 0) {
+		fprintf(stderr, "FAIL: %s\nand: %s\ndiffer: %s vs %s\n",
+		    a, b, out_a, out_b);
+		failures++;
+	}
+	free(out_a);
+	free(out_b);
+}
+
+int
+main(void)
+{
+	static const struct valid_case valid_cases[] = {
+		{ "function f(s) = seed(s); randint(1, 6); endfunction\nf(5) == f(5)", "Defined function 'f'\n1\n" },
+		{ "function f(s) = seed(s); rand(); endfunction\nf(5) == f(5)\nf(5) == f(6)", "Defined function 'f'\n1\n0\n" },
+		{ "function g(s) = seed(s); i = 0; ok = 1; while (i < 300) do r = randint(-3, 3); ok = ok * (r >= -3) * (r <= 3) * (r == int(r)); i = i + 1; done ok; endfunction\ng(1)", "Defined function 'g'\n1\n" },
+		{ "function g(s) = seed(s); i = 0; ok = 1; while (i < 300) do r = rand(); ok = ok * (r >= 0) * (r < 1); i = i + 1; done ok; endfunction\ng(1)", "Defined function 'g'\n1\n" },
+		{ "function g(s) = seed(s); i = 0; n = 0; while (i < 300) do n = n + randint(0, 1); i = i + 1; done (n > 100) * (n < 200); endfunction\ng(3)", "Defined function 'g'\n1\n" },
+		{ "randint(4, 4)", "4\n" },
+		{ "randbits(0)", "0\n" },
+		{ "bits(randbits(64)) <= 64", "1\n" },
+		{ "seed(2)\nbits(randbits(3000000)) > 2999900", "1\n" },
+		{ "function h(s) = seed(s); randbits(3000000); endfunction\nh(9) == h(9)", "Defined function 'h'\n1\n" },
+		{ "seed(1)", "" },
+	};
+	static const char *invalid_cases[] = {
+		"randint(6, 1)",
+		"randbits(-1)",
+		"rand(1)",
+		"seed()",
+	};
+	size_t i;
+
+	for (i = 0; i < sizeof(valid_cases) / sizeof(valid_cases[0]); ++i)
+		expect_output(valid_cases[i].expr, valid_cases[i].expected);
+
+	for (i = 0; i < sizeof(invalid_cases) / sizeof(invalid_cases[0]); ++i)
+		expect_error(invalid_cases[i]);
+
+	/* the streams of large randbits() do not depend on the thread count */
+	expect_same("threads 1\nseed(7)\nrandbits(5000000) % 1000000007",
+	    "threads 4\nseed(7)\nrandbits(5000000) % 1000000007");
+
+	if (failures != 0) {
+		fprintf(stderr, "%d test(s) failed\n", failures);
+		return 1;
+	}
+
+	printf("Random number tests passed\n");
+	return 0;
+}
@@ -0,0 +1,120 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "harness.h"
+
+int
+main(void)
+{
+	static const struct valid_case valid_cases[] = {
+		{ "vm on\nfunction fb(n) = if n < 2 then n; else fb(n-1) + fb(n-2); fi endfunction\nfb(18)", "Defined function 'fb'\n2584\n" },
+		{ "vm off\nfunction fb(n) = if n < 2 then n; else fb(n-1) + fb(n-2); fi endfunction\nfb(18)", "Defined function 'fb'\n2584\n" },
+		{ "vm on\nfunction s(n) = i = 0; t = 0; while i < n do t = t + i*i; i = i + 1; done t; endfunction\ns(1000)", "Defined function 's'\n332833500\n" },
+		{ "vm off\nfunction s(n) = i = 0; t = 0; while i < n do t = t + i*i; i = i + 1; done t; endfunction\ns(1000)", "Defined function 's'\n332833500\n" },
+		{ "vm on\nfunction g(x) = y = x; y[3] = 1; y[7:4] = 5; y; endfunction\ng(1)", "Defined function 'g'\n89\n" },
+		{ "vm off\nfunction g(x) = y = x; y[3] = 1; y[7:4] = 5; y; endfunction\ng(1)", "Defined function 'g'\n89\n" },
+		{ "vm on\nfunction h(a, b) = if a > b then a - b; elsif a == b then 0; else b - a; fi endfunction\nh(3, 5) + h(5, 5) * 10 + h(9, 2) * 100", "Defined function 'h'\n702\n" },
+		{ "vm off\nfunction h(a, b) = if a > b then a - b; elsif a == b then 0; else b - a; fi endfunction\nh(3, 5) + h(5, 5) * 10 + h(9, 2) * 100", "Defined function 'h'\n702\n" },
+		{ "vm on\nx = 10\nwhile x > 0 do x = x - 3; done", "10\n-2\n" },
+		{ "vm off\nx = 10\nwhile x > 0 do x = x - 3; done", "10\n-2\n" },
+		{ "vm on\nif 0 then 1; fi", "0\n" },
+		{ "vm off\nif 0 then 1; fi", "0\n" },
+		{ "vm on\nfunction m(x) = x % 3 ^ 5 << 2 >> 1 & 255 | 16; endfunction\nm(100)", "Defined function 'm'\n27\n" },
+		{ "vm off\nfunction m(x) = x % 3 ^ 5 << 2 >> 1 & 255 | 16; endfunction\nm(100)", "Defined function 'm'\n27\n" },
+		{ "vm on\nfunction u(x) = -x + ~x + x!; endfunction\nu(5)", "Defined function 'u'\n109\n" },
+		{ "vm off\nfunction u(x) = -x + ~x + x!; endfunction\nu(5)", "Defined function 'u'\n109\n" },
+		{ "vm on\nfunction p(x) = x[3:0] + x[7]; endfunction\np(255)", "Defined function 'p'\n16\n" },
+		{ "vm off\nfunction p(x) = x[3:0] + x[7]; endfunction\np(255)", "Defined function 'p'\n16\n" },
+		{ "vm on\nfunction w(n) = i = 0; while i < n do i = i + 1; done endfunction\nw(4)", "Defined function 'w'\n4\n" },
+		{ "vm off\nfunction w(n) = i = 0; while i < n do i = i + 1; done endfunction\nw(4)", "Defined function 'w'\n4\n" },
+		{ "vm on\nfunction nn(x) = seed(x); randint(1, 1000000); endfunction\nnn(5) == nn(5)", "Defined function 'nn'\n1\n" },
+		{ "vm off\nfunction nn(x) = seed(x); randint(1, 1000000); endfunction\nnn(5) == nn(5)", "Defined function 'nn'\n1\n" },
+		{ "vm on\nfunction sq(x) = x * x; endfunction\ntabulate(sq, 1, 3)", "Defined function 'sq'\n1 | 1\n3 | 9\n" },
+		{ "vm off\nfunction sq(x) = x * x; endfunction\ntabulate(sq, 1, 3)", "Defined function 'sq'\n1 | 1\n3 | 9\n" },
+		{ "vm on\nfunction c(n) = if n == 0 then 0; else 1 + c(n - 1); fi endfunction\nc(500)", "Defined function 'c'\n500\n" },
+		{ "vm off\nfunction c(n) = if n == 0 then 0; else 1 + c(n - 1); fi endfunction\nc(500)", "Defined function 'c'\n500\n" },
+		{ "vm on\nfunction f(x) = sin(x) ** 2 + cos(x) ** 2; endfunction\nf(0.3)", "Defined function 'f'\n1\n" },
+		{ "vm off\nfunction f(x) = sin(x) ** 2 + cos(x) ** 2; endfunction\nf(0.3)", "Defined function 'f'\n1\n" },
+		{ "vm on\ng = 5\nfunction f(x) = y = g + x; g = 1; y; endfunction\nf(2)\ng", "5\nDefined function 'f'\n7\n5\n" },
+		{ "vm off\ng = 5\nfunction f(x) = y = g + x; g = 1; y; endfunction\nf(2)\ng", "5\nDefined function 'f'\n7\n5\n" },
+		{ "vm on\nz = 10\nfunction h(x) = z = z + x; z; endfunction\nh(1)\nz", "10\nDefined function 'h'\n11\n10\n" },
+		{ "vm off\nz = 10\nfunction h(x) = z = z + x; z; endfunction\nh(1)\nz", "10\nDefined function 'h'\n11\n10\n" },
+		{ "vm on\nz = 10\nfunction h(x) = z = z + x; z; endfunction\ni = 0\nwhile i < 3 do z = z + 1; w = h(0); i = i + 1; done\nw", "10\nDefined function 'h'\n0\n3\n13\n" },
+		{ "vm off\nz = 10\nfunction h(x) = z = z + x; z; endfunction\ni = 0\nwhile i < 3 do z = z + 1; w = h(0); i = i + 1; done\nw", "10\nDefined function 'h'\n0\n3\n13\n" },
+		{ "vm on\nfunction d(x, x) = x; endfunction\nd(1, 2)", "Defined function 'd'\n2\n" },
+		{ "vm off\nfunction d(x, x) = x; endfunction\nd(1, 2)", "Defined function 'd'\n2\n" },
+		{ "vm on\nfunction q(a) = a[1] = 0; a; endfunction\nq(7)\nq(6)", "Defined function 'q'\n5\n4\n" },
+		{ "vm off\nfunction q(a) = a[1] = 0; a; endfunction\nq(7)\nq(6)", "Defined function 'q'\n5\n4\n" },
+		{ "vm on\nfunction sq(x) = x * x; endfunction\nfunction tb(a) = b = a; tabulate(sq, b, a + 1); endfunction\ntb(2)", "Defined function 'sq'\nDefined function 'tb'\n2 | 4\n3 | 9\n" },
+		{ "vm off\nfunction sq(x) = x * x; endfunction\nfunction tb(a) = b = a; tabulate(sq, b, a + 1); endfunction\ntb(2)", "Defined function 'sq'\nDefined function 'tb'\n2 | 4\n3 | 9\n" },
+		{ "vm on\nfunction sq(x) = x * x; endfunction\nfunction t(a) = diff(sq, a) + a; endfunction\nt(3)", "Defined function 'sq'\nDefined function 't'\n9\n" },
+		{ "vm off\nfunction sq(x) = x * x; endfunction\nfunction t(a) = diff(sq, a) + a; endfunction\nt(3)", "Defined function 'sq'\nDefined function 't'\n9\n" },
+		{ "vm on\nfunction sq(x) = x * x; endfunction\nfunction lp(n) = i = 0; s = 0; while i < n do s = s + diff(sq, i + 1) * diff(sq, n); i = i + 1; done s; endfunction\nlp(3)", "Defined function 'sq'\nDefined function 'lp'\n72\n" },
+		{ "vm off\nfunction sq(x) = x * x; endfunction\nfunction lp(n) = i = 0; s = 0; while i < n do s = s + diff(sq, i + 1) * diff(sq, n); i = i + 1; done s; endfunction\nlp(3)", "Defined function 'sq'\nDefined function 'lp'\n72\n" },
+		{ "vm on\nfunction nl(n) = i = 0; s = 0; while i < n do j = 0; while j < i do s = s + (i * 2 + 1) * (j + 2 ** n); j = j + 1; done i = i + 1; done s; endfunction\nnl(20)", "Defined function 'nl'\n5379229650\n" },
+		{ "vm off\nfunction nl(n) = i = 0; s = 0; while i < n do j = 0; while j < i do s = s + (i * 2 + 1) * (j + 2 ** n); j = j + 1; done i = i + 1; done s; endfunction\nnl(20)", "Defined function 'nl'\n5379229650\n" },
+		{ "function ts(n) = i = 0; t = 0; while i < n do t = t + i * 2; i = i + 1; done t; endfunction\nts(100000)", "Defined function 'ts'\n9999900000\n" },
+		{ "vm on\nfunction f(x) = g(x) + 1; endfunction\nfunction g(x) = x * 10; endfunction\nf(1)\nfunction g(x) = x * 100; endfunction\nf(1)", "Defined function 'f'\nDefined function 'g'\n11\nDefined function 'g'\n101\n" },
+		{ "vm off\nfunction f(x) = g(x) + 1; endfunction\nfunction g(x) = x * 10; endfunction\nf(1)\nfunction g(x) = x * 100; endfunction\nf(1)", "Defined function 'f'\nDefined function 'g'\n11\nDefined function 'g'\n101\n" },
+		{ "vm on\nfunction f(x) = sq(x); endfunction\nfunction sq(x) = x * x; endfunction\nf(3)", "Defined function 'f'\nDefined function 'sq'\n9\n" },
+		{ "vm off\nfunction f(x) = sq(x); endfunction\nfunction sq(x) = x * x; endfunction\nf(3)", "Defined function 'f'\nDefined function 'sq'\n9\n" },
+		{ "function c(n) = if n == 0 then 0; else 1 + c(n - 1); fi endfunction\nc(50000)", "Defined function 'c'\n50000\n" },
+		{ "function t(n, acc) = if n == 0 then acc; else t(n - 1, acc + n); fi endfunction\nt(100000, 0)", "Defined function 't'\n5000050000\n" },
+		{ "function ev(n) = if n == 0 then 1; else od(n - 1); fi endfunction\nfunction od(n) = if n == 0 then 0; else ev(n - 1); fi endfunction\nev(20001)", "Defined function 'ev'\nDefined function 'od'\n0\n" },
+		{ "function tl(n, x) = z = x + 1; if n == 0 then z; else tl(n - 1, z); fi endfunction\ntl(100, 0)", "Defined function 'tl'\n101\n" },
+		{ "vm off\nfunction tl(n, x) = z = x + 1; if n == 0 then z; else tl(n - 1, z); fi endfunction\ntl(100, 0)", "Defined function 'tl'\n101\n" },
+		{ "vm on\nk = 3\nfunction sq(x) = x * x; endfunction\nfunction f(n) = i = 0; a = 0; while i < n do a = a + sq(k + 1) + n; i = i + 1; done a; endfunction\nf(4)", "3\nDefined function 'sq'\nDefined function 'f'\n80\n" },
+		{ "vm off\nk = 3\nfunction sq(x) = x * x; endfunction\nfunction f(n) = i = 0; a = 0; while i < n do a = a + sq(k + 1) + n; i = i + 1; done a; endfunction\nf(4)", "3\nDefined function 'sq'\nDefined function 'f'\n80\n" },
+		{ "vm on\nz = 0\nfunction g(n) = i = 0; while i < n do if i > n then i = 1 / z; fi i = i + 1; done i; endfunction\ng(5)", "0\nDefined function 'g'\n5\n" },
+		{ "vm off\nz = 0\nfunction g(n) = i = 0; while i < n do if i > n then i = 1 / z; fi i = i + 1; done i; endfunction\ng(5)", "0\nDefined function 'g'\n5\n" },
+		{ "vm on\nfunction r(n) = i = 0; c = 0; while i < n do seed(i); c = c + randint(1, 1000000); i = i + 1; done c; endfunction\nr(3) == r(3)", "Defined function 'r'\n1\n" },
+		{ "vm off\nfunction r(n) = i = 0; c = 0; while i < n do seed(i); c = c + randint(1, 1000000); i = i + 1; done c; endfunction\nr(3) == r(3)", "Defined function 'r'\n1\n" },
+		{ "vm on\nfunction sq(x) = x * x; endfunction\nfunction f(n) = i = 0; a = 0; while i < n do a = a + sq(n); i = i + 1; done a; endfunction\nf(2)\nfunction sq(x) = x; endfunction\nf(2)", "Defined function 'sq'\nDefined function 'f'\n8\nDefined function 'sq'\n4\n" },
+		{ "vm off\nfunction sq(x) = x * x; endfunction\nfunction f(n) = i = 0; a = 0; while i < n do a = a + sq(n); i = i + 1; done a; endfunction\nf(2)\nfunction sq(x) = x; endfunction\nf(2)", "Defined function 'sq'\nDefined function 'f'\n8\nDefined function 'sq'\n4\n" },
+		{ "vm on\nfunction f(n) = i = 0; a = 0; while i < n do k = n * 2; a = a + k * i; i = i + 1; done a; endfunction\nf(4)", "Defined function 'f'\n48\n" },
+		{ "vm off\nfunction f(n) = i = 0; a = 0; while i < n do k = n * 2; a = a + k * i; i = i + 1; done a; endfunction\nf(4)", "Defined function 'f'\n48\n" },
+		{ "vm on\na = 3\nb = 4\n(a * b + 1) * (a * b + 1) - (a * b)", "3\n4\n157\n" },
+		{ "vm off\na = 3\nb = 4\n(a * b + 1) * (a * b + 1) - (a * b)", "3\n4\n157\n" },
+		{ "vm on\nfunction f(x) = (x * x + 1) / (x * x + 1) + (x * x + 1); endfunction\nf(2)", "Defined function 'f'\n6\n" },
+		{ "vm off\nfunction f(x) = (x * x + 1) / (x * x + 1) + (x * x + 1); endfunction\nf(2)", "Defined function 'f'\n6\n" },
+		{ "vm on\nfunction g(x) = if x > 0 then sqrt(x * x); else -sqrt(x * x); fi endfunction\ng(-4)", "Defined function 'g'\n-4\n" },
+		{ "vm off\nfunction g(x) = if x > 0 then sqrt(x * x); else -sqrt(x * x); fi endfunction\ng(-4)", "Defined function 'g'\n-4\n" },
+		{ "vm on\nfunction r(x) = seed(x); randint(1, 1000000) == randint(1, 1000000); endfunction\nr(1)", "Defined function 'r'\n0\n" },
+		{ "vm off\nfunction r(x) = seed(x); randint(1, 1000000) == randint(1, 1000000); endfunction\nr(1)", "Defined function 'r'\n0\n" },
+		{ "vm on\nfunction s(x) = y = x + 1; z = x + 1; y = y * 2; (x + 1) + y + z; endfunction\ns(1)", "Defined function 's'\n8\n" },
+		{ "vm off\nfunction s(x) = y = x + 1; z = x + 1; y = y * 2; (x + 1) + y + z; endfunction\ns(1)", "Defined function 's'\n8\n" },
+		{ "depth 10\nfunction c(n) = if n == 0 then 0; else 1 + c(n - 1); fi endfunction\nc(9)", "Defined function 'c'\n9\n" },
+		{ "depth 3\nfunction t(n) = if n == 0 then 7; else t(n - 1); fi endfunction\nt(100)", "Defined function 't'\n7\n" },
+	};
+	static const char *invalid_cases[] = {
+		"vm on\nfunction e(x) = q + x; endfunction\ne(2)",
+		"vm off\nfunction e(x) = q + x; endfunction\ne(2)",
+		"vm on\nfunction e(x) = x; endfunction\ne(1, 2)",
+		"vm off\nfunction e(x) = x; endfunction\ne(1, 2)",
+		"vm on\nfunction e(x) = nosuch(x); endfunction\ne(1)",
+		"vm off\nfunction e(x) = nosuch(x); endfunction\ne(1)",
+		"vm on\nfunction g(x) = x; endfunction\nfunction f(x) = g(x); endfunction\nfunction g(x, y) = x; endfunction\nf(1)",
+		"vm off\nfunction g(x) = x; endfunction\nfunction f(x) = g(x); endfunction\nfunction g(x, y) = x; endfunction\nf(1)",
+		"depth 10\nfunction c(n) = if n == 0 then 0; else 1 + c(n - 1); fi endfunction\nc(10)",
+		"vm maybe",
+		"depth 0",
+		"vm off\ndepth 10\nfunction c(n) = if n == 0 then 0; else 1 + c(n - 1); fi endfunction\nc(10)",
+		"vm off\nfunction c(n) = if n == 0 then 0; else 1 + c(n - 1); fi endfunction\nc(200000)",
+	};
+	size_t i;
+
+	for (i = 0; i < sizeof(valid_cases) / sizeof(valid_cases[0]); ++i)
+		expect_output(valid_cases[i].expr, valid_cases[i].expected);
+
+	for (i = 0; i < sizeof(invalid_cases) / sizeof(invalid_cases[0]); ++i)
+		expect_error(invalid_cases[i]);
+
+	if (failures != 0) {
+		fprintf(stderr, "%d test(s) failed\n", failures);
+		return 1;
+	}
+
+	printf("VM tests passed\n");
+	return 0;
+}
@@ -27,6 +27,7 @@
  * SUCH DAMAGE.
  */
 
+#include <stdint.h>
 #include <stdlib.h>
 #include <stdio.h>
 #include <string.h>
@@ -44,24 +45,40 @@
 #include "ast.h"
 #include "calc.h"
 #include "safe_mem.h"
+#include "ival.h"
 
 static hashtable_t vartbl;
 
 
 static
 void
-_initconstants(void)
+_setconstant(const char *name, num_t v)
 {
 	var_t var;
 
-	var = varlookup("pi", 1);
-	var->v = num_new_const_pi(0);
+	var = varlookup(name, 1);
+	if (var->v != NULL && !var->no_numfree)
+		num_delete(var->v);
+
+	var->v = v;
+	var->no_numfree = 0;
+	var->constant = 1;
+}
 
-	var = varlookup("G", 1);
-	var->v = num_new_const_catalan(0);
 
-	var = varlookup("e", 1);
-	var->v = num_new_const_e(0);
+/* (Re)defines the constants, as enclosing intervals in interval mode. */
+void
+varinit_constants(void)
+{
+	if (ival_mode) {
+		_setconstant("pi", num_new_ival_const_pi(0));
+		_setconstant("G", num_new_ival_const_catalan(0));
+		_setconstant("e", num_new_ival_const_e(0));
+	} else {
+		_setconstant("pi", num_new_const_pi(0));
+		_setconstant("G", num_new_const_catalan(0));
+		_setconstant("e", num_new_const_e(0));
+	}
 }
 
 
@@ -106,6 +123,7 @@ ext_varlookup(hashtable_t vtbl, const char *s, int alloc)
 	}
 
 	var->no_numfree = 0;
+	var->constant = 0;
 	obj->data = var;
 
 	return var;
@@ -116,7 +134,7 @@ int
 varinit(void)
 {
 	vartbl = ext_varinit(9901);
-	_initconstants();
+	varinit_constants();
 
 	return 0;
 }
@@ -30,6 +30,7 @@
 typedef struct var
 {
 	int no_numfree;
+	int constant;		/* predefined, and folded until assigned to */
 	num_t v;
 } *var_t;
 
@@ -38,6 +39,7 @@ typedef void (*var_it_fn)(void *, const char *);
 hashtable_t ext_varinit(unsigned int size);
 var_t ext_varlookup(hashtable_t vtbl, const char *s, int alloc);
 int varinit(void);
+void varinit_constants(void);
 var_t varlookup(const char *s, int alloc);
 void varlist(void);
 void var_iterate(void *priv, var_it_fn fn);
@@ -0,0 +1,1874 @@
+/*
+ * Copyright (c) 2026 Alex Hornung <alex@alexhornung.com>.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in
+ *    the documentation and/or other materials provided with the
+ *    distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE
+ * COPYRIGHT HOLDERS OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ * BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED
+ * AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT
+ * OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+
+/*
+ * Statements and user function bodies are compiled into a flat array of
+ * register instructions and run by a single dispatch loop, instead of
+ * walking the AST recursively.  Every instruction names its result and
+ * operand registers explicitly; registers hold num_t pointers, which
+ * may be NULL for an expression whose evaluation failed or produced no
+ * result, exactly as eval() would have returned it.
+ *
+ * The tree evaluator is kept as the reference implementation and can be
+ * switched back to with "vm off".
+ */
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <assert.h>
+
+#include <gmp.h>
+#include <mpfr.h>
+
+#include "hashtable.h"
+
+#include "optype.h"
+#include "num.h"
+#include "var.h"
+#include "ast.h"
+#include "calc.h"
+#include "func.h"
+#include "fold.h"
+#include "pure.h"
+#include "vm.h"
+
+#if defined(__GNUC__)
+#define VM_THREADED
+#endif
+
+typedef enum vm_opcode
+{
+	VM_NUM,		/* r = u.num */
+	VM_ZERO,	/* r = 0 */
+	VM_NULL,	/* r = no result */
+	VM_LOADG,	/* r = global u.name */
+	VM_LOADL,	/* r = local s, or global u.name if it has no value */
+	VM_STOREG,	/* r = global u.name = a */
+	VM_STOREL,	/* r = local s = a */
+	VM_PSEL,	/* r = a[b:c] */
+	VM_PSETG,	/* r = global u.name[b:c] = a */
+	VM_PSETL,	/* r = local s[b:c] = a */
+	VM_FOP,		/* r = a sub b */
+	VM_IOP,		/* r = a sub b, integers only */
+	VM_FOP1,	/* r = sub a */
+	VM_IOP1,	/* r = sub a, integers only */
+	VM_CMP,		/* r = a sub b */
+	VM_CALL,	/* r = u.call->name(a, ..., a + b - 1) */
+	VM_TAILCALL,	/* VM_CALL that may replace the running function */
+	VM_CALLFN,	/* r = u.call->name(its function name, a, ..., a + b - 1) */
+	VM_JMP,		/* goto b */
+	VM_MARK,	/* r = where the temporaries of a loop start */
+	VM_LOOP,	/* free temporaries since a, not keep[c..c + s), goto b */
+	VM_JZ,		/* if a is NULL goto c, if a is zero goto b */
+	VM_UNSET,	/* r = not computed yet */
+	VM_ONCE,	/* if a has been computed, r = a and goto b */
+	VM_KEEP,	/* r = a, unless a has no value */
+	VM_RET		/* return a */
+} vm_opcode_t;
+
+struct vm_insn
+{
+	vm_opcode_t op;
+	int sub;		/* optype_t, cmptype_t or pseltype_t */
+	int r, a, b, c;
+	int s;			/* frame slot */
+
+	union {
+		num_t num;
+		const char *name;
+		astcall_t call;
+	} u;
+
+	var_t var;		/* global u.name, once it exists */
+};
+
+struct vm_code
+{
+	struct vm_insn *insns;
+	int ninsns;
+	int size;
+
+	int nregs;
+	int top;		/* first free register while compiling */
+
+	ast_t src;		/* the source, which the caller owns */
+	namelist_t params;
+	ast_t ast;		/* the folded copy the code refers to */
+	unsigned long gen;	/* fold_gen when folded */
+
+	/*
+	 * A function's arguments and the variables it assigns to live in
+	 * the slots of its frame; every other name is a global.
+	 */
+	hashtable_t slots;	/* name -> slot + 1 */
+	const char **slotname;
+	int nslots;
+	int *argslot;
+	int nargs;
+
+	int running;		/* activations on the stack */
+
+	/* loop invariants being generated, and the registers keeping them */
+	struct vm_hoist *hoist;
+	int nhoist;
+	int hoistsize;
+	int fundep;		/* hoisting relied on user functions ... */
+	unsigned long fun_gen;	/* ... as they were at fun_gen */
+
+	/* the region common subexpressions are shared in, if any */
+	int cse;
+	int cse_top;
+	int cse_nhoist;
+
+	/* registers whose values outlive an iteration, for VM_LOOP */
+	int *keep;
+	int nkeep;
+	int keepsize;
+};
+
+struct vm_hoist
+{
+	ast_t a;
+	int reg;
+};
+
+/* loops keeping more values than this keep all their temporaries */
+#define VM_KEEP_MAX	16
+
+static struct num vm_unset;
+
+int vm_enabled = 1;
+
+
+static
+int
+vm_emit(struct vm_code *c, vm_opcode_t op, int sub, int r, int a, int b)
+{
+	struct vm_insn *insn;
+
+	if (c->ninsns == c->size) {
+		c->size = (c->size == 0) ? 32 : 2 * c->size;
+		if ((c->insns = realloc(c->insns,
+			    c->size * sizeof(*c->insns))) == NULL) {
+			yyxerror("ENOMEM");
+			exit(1);
+		}
+	}
+
+	insn = &c->insns[c->ninsns];
+	memset(insn, 0, sizeof(*insn));
+	insn->op = op;
+	insn->sub = sub;
+	insn->r = r;
+	insn->a = a;
+	insn->b = b;
+	insn->c = -1;
+
+	return c->ninsns++;
+}
+
+
+static
+int
+vm_reg(struct vm_code *c)
+{
+	if (++c->top > c->nregs)
+		c->nregs = c->top;
+
+	return c->top - 1;
+}
+
+
+/* Returns the frame slot of name, or -1 for a global. */
+static
+int
+vm_slot(struct vm_code *c, const char *name)
+{
+	hashobj_t obj;
+
+	if (c->slots == NULL ||
+	    (obj = hashtable_lookup(c->slots, name, 0)) == NULL)
+		return -1;
+
+	return (int)(intptr_t)obj->data - 1;
+}
+
+
+static void vm_gen(struct vm_code *c, ast_t a, int dst);
+static void vm_gen_tail(struct vm_code *c, ast_t a, int dst);
+
+
+/*
+ * Generates a and b into dst and a fresh register, for two operand
+ * instructions.
+ */
+static
+int
+vm_gen_two(struct vm_code *c, ast_t a, ast_t b, int dst)
+{
+	int t;
+
+	vm_gen(c, a, dst);
+	t = vm_reg(c);
+	vm_gen(c, b, t);
+
+	return t;
+}
+
+
+/*
+ * Generates the bit range of a part select or part assignment, returning
+ * the register holding hi; lo, if any, lands in the register after it.
+ */
+static
+int
+vm_gen_range(struct vm_code *c, ast_t hi, ast_t lo)
+{
+	int t;
+
+	t = vm_reg(c);
+	vm_gen(c, hi, t);
+	if (lo != NULL)
+		vm_gen(c, lo, vm_reg(c));
+
+	return t;
+}
+
+
+/*
+ * The first argument of builtins like diff() is the name of a function,
+ * which the VM must not evaluate.
+ */
+static
+int
+vm_is_fnarg(astcall_t ac)
+{
+	func_t fn;
+
+	fn = funlookup(ac->name, 0);
+	return (fn != NULL && fn->builtin && (fn->flags & FUNC_FN_ARG) &&
+	    ac->l != NULL);
+}
+
+
+static
+int
+vm_gen_call(struct vm_code *c, astcall_t ac, int dst)
+{
+	explist_t p;
+	int fnarg, base, n, i;
+
+	fnarg = vm_is_fnarg(ac);
+
+	n = 0;
+	for (p = fnarg ? ac->l->next : ac->l; p != NULL; p = p->next)
+		++n;
+
+	base = c->top;
+	for (p = fnarg ? ac->l->next : ac->l; p != NULL; p = p->next)
+		vm_gen(c, p->ast, vm_reg(c));
+
+	i = vm_emit(c, fnarg ? VM_CALLFN : VM_CALL, 0, dst, base, n);
+	c->insns[i].u.call = ac;
+
+	return i;
+}
+
+
+/*
+ * Stores the operands of a, which is not a call, in kids and returns
+ * how many there are.
+ */
+static
+int
+vm_kids(ast_t a, ast_t kids[3])
+{
+	switch (a->op_type) {
+	case OP_NUM:
+	case OP_VARREF:
+		return 0;
+
+	case OP_CMP:
+		kids[0] = ((astcmp_t)a)->l;
+		kids[1] = ((astcmp_t)a)->r;
+		return 2;
+
+	case OP_FLOW:
+		kids[0] = ((astflow_t)a)->cond;
+		kids[1] = ((astflow_t)a)->t;
+		kids[2] = ((astflow_t)a)->f;
+		return 3;
+
+	case OP_VARASSIGN:
+		kids[0] = ((astassign_t)a)->v;
+		return 1;
+
+	case OP_PSEL:
+		kids[0] = ((astpsel_t)a)->l;
+		kids[1] = ((astpsel_t)a)->hi;
+		kids[2] = ((astpsel_t)a)->lo;
+		return 3;
+
+	case OP_PSELASSIGN:
+		kids[0] = ((astpselassign_t)a)->v;
+		kids[1] = ((astpselassign_t)a)->hi;
+		kids[2] = ((astpselassign_t)a)->lo;
+		return 3;
+
+	default:
+		kids[0] = a->l;
+		kids[1] = a->r;
+		return 2;
+	}
+}
+
+
+/*
+ * Whether calling ac has no side effects, adding the globals it reads
+ * to reads.  The answer may change when a user function is defined, so
+ * code relying on it is compiled again then.
+ */
+static
+int
+vm_pure(struct vm_code *c, astcall_t ac, hashtable_t reads)
+{
+	func_t fn;
+
+	fn = funlookup(ac->name, 0);
+	if (fn == NULL || !fn->builtin)
+		c->fundep = 1;
+
+	return call_pure(ac, reads);
+}
+
+
+static
+int
+vm_hoisted(struct vm_code *c, ast_t a)
+{
+	int i;
+
+	for (i = c->nhoist - 1; i >= 0; i--)
+		if (c->hoist[i].a == a)
+			return c->hoist[i].reg;
+
+	return -1;
+}
+
+
+/*
+ * Loop-invariant code motion.  The largest subtrees of a while loop
+ * that compute the same value in every iteration, because they read no
+ * variable the loop assigns to and call only pure functions, each get
+ * a register of their own.  The first iteration to get to one computes
+ * it as usual and keeps its value there, and later iterations reuse
+ * it.  Nothing is computed before it would have been, so errors and
+ * branches that are never taken are not affected.
+ */
+static
+void
+vm_hoist_reg(struct vm_code *c, ast_t a, int reg)
+{
+	if (c->nhoist == c->hoistsize) {
+		c->hoistsize = (c->hoistsize == 0) ? 8 : 2 * c->hoistsize;
+		if ((c->hoist = realloc(c->hoist,
+			    c->hoistsize * sizeof(*c->hoist))) == NULL) {
+			yyxerror("ENOMEM");
+			exit(1);
+		}
+	}
+
+	c->hoist[c->nhoist].a = a;
+	c->hoist[c->nhoist].reg = reg;
+	++c->nhoist;
+}
+
+
+static
+void
+vm_hoist(struct vm_code *c, ast_t a)
+{
+	int reg;
+
+	if (a == NULL || a->op_type == OP_NUM || a->op_type == OP_VARREF ||
+	    vm_hoisted(c, a) >= 0)
+		return;
+
+	reg = vm_reg(c);
+	vm_emit(c, VM_UNSET, 0, reg, 0, 0);
+	vm_hoist_reg(c, a, reg);
+}
+
+
+struct vm_reads
+{
+	hashtable_t written;
+	int clash;
+};
+
+
+static
+void
+vm_read_check(void *priv, hashobj_t obj)
+{
+	struct vm_reads *r = priv;
+
+	if (hashtable_lookup(r->written, obj->str, 0) != NULL)
+		r->clash = 1;
+}
+
+
+/* Whether calling ac gives the same result in every iteration. */
+static
+int
+vm_call_invariant(struct vm_code *c, astcall_t ac, hashtable_t written)
+{
+	struct vm_reads r;
+	hashtable_t reads;
+
+	r.written = written;
+	r.clash = 0;
+
+	/* user functions read globals, which the loop must leave alone */
+	reads = hashtable_new(61, NULL, NULL);
+	if (!vm_pure(c, ac, reads))
+		r.clash = 1;
+	else
+		hashtable_iterate(reads, vm_read_check, &r);
+	hashtable_destroy(reads);
+
+	return !r.clash;
+}
+
+
+/*
+ * Returns whether a is invariant in a loop assigning to written,
+ * hoisting the invariant parts of it otherwise.
+ */
+static
+int
+vm_invariant(struct vm_code *c, ast_t a, hashtable_t written)
+{
+	ast_t kids[3];
+	explist_t p;
+	int inv, n, i;
+
+	if (a == NULL || a->op_type == OP_NUM || vm_hoisted(c, a) >= 0)
+		return 1;
+
+	switch (a->op_type) {
+	case OP_VARREF:
+		return hashtable_lookup(written, ((astref_t)a)->name, 0) == NULL;
+
+	case OP_CALL:
+		/* a function called by name may do anything */
+		if (vm_is_fnarg((astcall_t)a)) {
+			for (p = ((astcall_t)a)->l->next; p != NULL;
+			    p = p->next)
+				if (vm_invariant(c, p->ast, written))
+					vm_hoist(c, p->ast);
+			return 0;
+		}
+
+		inv = 1;
+		for (p = ((astcall_t)a)->l; p != NULL; p = p->next)
+			if (!vm_invariant(c, p->ast, written))
+				inv = 0;
+		if (inv && vm_call_invariant(c, (astcall_t)a, written))
+			return 1;
+		for (p = ((astcall_t)a)->l; p != NULL; p = p->next)
+			if (vm_invariant(c, p->ast, written))
+				vm_hoist(c, p->ast);
+		return 0;
+
+	case OP_FLOW:
+	case OP_LISTING:
+	case OP_VARASSIGN:
+	case OP_PSELASSIGN:
+		inv = 0;
+		break;
+
+	default:
+		inv = 1;
+	}
+
+	n = vm_kids(a, kids);
+	for (i = 0; i < n; i++)
+		if (!vm_invariant(c, kids[i], written))
+			inv = 0;
+	if (inv)
+		return 1;
+
+	for (i = 0; i < n; i++)
+		if (vm_invariant(c, kids[i], written))
+			vm_hoist(c, kids[i]);
+
+	return 0;
+}
+
+
+static
+void
+vm_hoist_loop(struct vm_code *c, astflow_t af)
+{
+	hashtable_t written;
+
+	written = hashtable_new(61, NULL, NULL);
+	ast_assigned((ast_t)af, written);
+
+	if (vm_invariant(c, af->cond, written))
+		vm_hoist(c, af->cond);
+	if (vm_invariant(c, af->t, written))
+		vm_hoist(c, af->t);
+
+	hashtable_destroy(written);
+}
+
+
+/*
+ * Common subexpression elimination.  Within a region of code that
+ * assigns to nothing, alike subtrees that call only pure functions all
+ * compute the same value.  They are found by hashing every subtree of
+ * the region, and each set of them shares a register the way loop
+ * invariants do, so that only the first to be reached is computed.
+ *
+ * The parser does not hash-cons alike subtrees into one node instead:
+ * ast_fold() rewrites trees in place, and ast_delete() and the caches on
+ * call nodes expect each node to have a single parent.  So the syntax
+ * tree, and eval() with the VM off, keep a copy of every occurrence.
+ */
+struct vm_cse
+{
+	ast_t a;
+	unsigned long hash;
+	int reg;
+};
+
+struct vm_cses
+{
+	struct vm_code *c;
+	struct vm_cse *v;
+	int n;
+	int size;
+};
+
+
+static
+int
+vm_assigns(ast_t a)
+{
+	ast_t kids[3];
+	explist_t p;
+	int n, i;
+
+	if (a == NULL)
+		return 0;
+
+	switch (a->op_type) {
+	case OP_VARASSIGN:
+	case OP_PSELASSIGN:
+		return 1;
+
+	case OP_CALL:
+		for (p = ((astcall_t)a)->l; p != NULL; p = p->next)
+			if (vm_assigns(p->ast))
+				return 1;
+		return 0;
+
+	default:
+		n = vm_kids(a, kids);
+		for (i = 0; i < n; i++)
+			if (vm_assigns(kids[i]))
+				return 1;
+		return 0;
+	}
+}
+
+
+static
+unsigned long
+vm_str_hash(const char *s)
+{
+	unsigned long h = 5381;
+
+	while (*s != '\0')
+		h = h * 33 + (unsigned char)*s++;
+
+	return h;
+}
+
+
+static
+int
+vm_alike(ast_t a, ast_t b)
+{
+	ast_t ka[3], kb[3];
+	explist_t p, q;
+	int n, i;
+
+	if (a == b)
+		return 1;
+	if (a == NULL || b == NULL || a->op_type != b->op_type)
+		return 0;
+
+	switch (a->op_type) {
+	case OP_NUM:
+		/* literals are interned by the constant pool */
+		return ((astnum_t)a)->num == ((astnum_t)b)->num;
+
+	case OP_VARREF:
+		return !strcmp(((astref_t)a)->name, ((astref_t)b)->name);
+
+	case OP_CALL:
+		if (strcmp(((astcall_t)a)->name, ((astcall_t)b)->name))
+			return 0;
+		for (p = ((astcall_t)a)->l, q = ((astcall_t)b)->l;
+		    p != NULL && q != NULL; p = p->next, q = q->next)
+			if (!vm_alike(p->ast, q->ast))
+				return 0;
+		return p == NULL && q == NULL;
+
+	case OP_CMP:
+		if (((astcmp_t)a)->cmp_type != ((astcmp_t)b)->cmp_type)
+			return 0;
+		break;
+
+	case OP_PSEL:
+		if (((astpsel_t)a)->psel_type != ((astpsel_t)b)->psel_type)
+			return 0;
+		break;
+
+	default:
+		break;
+	}
+
+	n = vm_kids(a, ka);
+	vm_kids(b, kb);
+	for (i = 0; i < n; i++)
+		if (!vm_alike(ka[i], kb[i]))
+			return 0;
+
+	return 1;
+}
+
+
+/*
+ * Hashes a into hash and, if it is a subtree that could be shared,
+ * adds it to cs.  Returns whether a has no side effects.
+ */
+static
+int
+vm_cse_scan(struct vm_cses *cs, ast_t a, unsigned long *hash)
+{
+	ast_t kids[3];
+	explist_t p;
+	hashtable_t reads;
+	unsigned long h, kh;
+	int clean, n, i;
+
+	if (a == NULL) {
+		*hash = 0;
+		return 1;
+	}
+
+	h = a->op_type + 1;
+	clean = 1;
+
+	switch (a->op_type) {
+	case OP_NUM:
+		*hash = h * 31 + (unsigned long)(uintptr_t)((astnum_t)a)->num;
+		return 1;
+
+	case OP_VARREF:
+		*hash = h * 31 + vm_str_hash(((astref_t)a)->name);
+		return 1;
+
+	case OP_CALL:
+		h = h * 31 + vm_str_hash(((astcall_t)a)->name);
+		if (vm_is_fnarg((astcall_t)a)) {
+			for (p = ((astcall_t)a)->l->next; p != NULL;
+			    p = p->next)
+				vm_cse_scan(cs, p->ast, &kh);
+			*hash = h;
+			return 0;
+		}
+
+		for (p = ((astcall_t)a)->l; p != NULL; p = p->next) {
+			if (!vm_cse_scan(cs, p->ast, &kh))
+				clean = 0;
+			h = h * 31 + kh;
+		}
+
+		reads = hashtable_new(61, NULL, NULL);
+		if (!vm_pure(cs->c, (astcall_t)a, reads))
+			clean = 0;
+		hashtable_destroy(reads);
+		break;
+
+	case OP_FLOW:
+	case OP_LISTING:
+		clean = 0;
+		/* FALLTHROUGH */
+	default:
+		if (a->op_type == OP_CMP)
+			h = h * 31 + ((astcmp_t)a)->cmp_type;
+		else if (a->op_type == OP_PSEL)
+			h = h * 31 + ((astpsel_t)a)->psel_type;
+
+		n = vm_kids(a, kids);
+		for (i = 0; i < n; i++) {
+			if (!vm_cse_scan(cs, kids[i], &kh))
+				clean = 0;
+			h = h * 31 + kh;
+		}
+	}
+
+	*hash = h;
+	if (!clean)
+		return 0;
+
+	if (cs->n == cs->size) {
+		cs->size = (cs->size == 0) ? 32 : 2 * cs->size;
+		if ((cs->v = realloc(cs->v, cs->size * sizeof(*cs->v))) ==
+		    NULL) {
+			yyxerror("ENOMEM");
+			exit(1);
+		}
+	}
+
+	cs->v[cs->n].a = a;
+	cs->v[cs->n].hash = h;
+	cs->v[cs->n].reg = -1;
+	++cs->n;
+
+	return 1;
+}
+
+
+static
+int
+vm_cse_cmp(const void *pa, const void *pb)
+{
+	const struct vm_cse *a = pa, *b = pb;
+
+	return (a->hash > b->hash) - (a->hash < b->hash);
+}
+
+
+/*
+ * Gives the subtrees in cs->v[i..j) that are alike to cs->v[i] a
+ * register of their own, if there is more than one of them.
+ */
+static
+void
+vm_cse_share(struct vm_cses *cs, int i, int j)
+{
+	struct vm_code *c = cs->c;
+	int k, n, reg;
+
+	n = 0;
+	reg = -1;
+	for (k = i; k < j; k++) {
+		if (cs->v[k].reg != -1 || !vm_alike(cs->v[i].a, cs->v[k].a))
+			continue;
+		cs->v[k].reg = -2;
+		++n;
+		/* a loop invariant has a register already */
+		if (reg < 0)
+			reg = vm_hoisted(c, cs->v[k].a);
+	}
+
+	if (n > 1 && reg < 0) {
+		reg = vm_reg(c);
+		vm_emit(c, VM_UNSET, 0, reg, 0, 0);
+	}
+
+	for (k = i; k < j; k++) {
+		if (cs->v[k].reg != -2)
+			continue;
+		cs->v[k].reg = reg;
+		if (n > 1 && vm_hoisted(c, cs->v[k].a) < 0)
+			vm_hoist_reg(c, cs->v[k].a, reg);
+	}
+}
+
+
+/*
+ * Starts sharing common subexpressions in a, unless it assigns to
+ * something or is part of a region already.  Returns whether it did,
+ * in which case vm_cse_end() must follow generating a.
+ */
+static
+int
+vm_cse_begin(struct vm_code *c, ast_t a)
+{
+	struct vm_cses cs;
+	unsigned long h;
+	int i, j, k;
+
+	if (c->cse || a == NULL || a->op_type == OP_NUM ||
+	    a->op_type == OP_VARREF || vm_assigns(a))
+		return 0;
+
+	c->cse = 1;
+	c->cse_top = c->top;
+	c->cse_nhoist = c->nhoist;
+
+	memset(&cs, 0, sizeof(cs));
+	cs.c = c;
+	vm_cse_scan(&cs, a, &h);
+	qsort(cs.v, cs.n, sizeof(*cs.v), vm_cse_cmp);
+
+	for (i = 0; i < cs.n; i = j) {
+		for (j = i; j < cs.n && cs.v[j].hash == cs.v[i].hash; j++)
+			;
+		for (k = i; k < j; k++)
+			if (cs.v[k].reg == -1)
+				vm_cse_share(&cs, k, j);
+	}
+
+	free(cs.v);
+	return 1;
+}
+
+
+static
+void
+vm_cse_end(struct vm_code *c)
+{
+	c->nhoist = c->cse_nhoist;
+	c->top = c->cse_top;
+	c->cse = 0;
+}
+
+
+/*
+ * Jumps back to target at the end of an iteration of a loop whose value
+ * is in dst, freeing the temporaries made since the loop took its mark.
+ * The value of the loop and those of the invariants and common
+ * subexpressions computed so far are all a later iteration can use.
+ */
+static
+void
+vm_gen_backedge(struct vm_code *c, int mark, int target, int dst)
+{
+	int i;
+
+	if (c->nhoist + 1 > VM_KEEP_MAX) {
+		vm_emit(c, VM_JMP, 0, -1, 0, target);
+		return;
+	}
+
+	if (c->nkeep + c->nhoist + 1 > c->keepsize) {
+		c->keepsize = 2 * c->keepsize + c->nhoist + 1;
+		if ((c->keep = realloc(c->keep,
+			    c->keepsize * sizeof(*c->keep))) == NULL) {
+			yyxerror("ENOMEM");
+			exit(1);
+		}
+	}
+
+	i = vm_emit(c, VM_LOOP, 0, -1, mark, target);
+	c->insns[i].c = c->nkeep;
+	c->insns[i].s = c->nhoist + 1;
+
+	c->keep[c->nkeep++] = dst;
+	for (i = 0; i < c->nhoist; i++)
+		c->keep[c->nkeep++] = c->hoist[i].reg;
+}
+
+
+static
+void
+vm_gen_flow(struct vm_code *c, astflow_t af, int dst, int tail)
+{
+	void (*gen)(struct vm_code *, ast_t, int);
+	int top, nhoist, t, mark, jz, jmp, jend;
+
+	/* the branches of an if in tail position are in tail position */
+	gen = tail ? vm_gen_tail : vm_gen;
+
+	switch (af->flow_type) {
+	case FLOW_IF:
+		vm_gen(c, af->cond, dst);
+		jz = vm_emit(c, VM_JZ, 0, -1, dst, 0);
+
+		if (af->t != NULL)
+			gen(c, af->t, dst);
+		else
+			vm_emit(c, VM_ZERO, 0, dst, 0, 0);
+		jmp = vm_emit(c, VM_JMP, 0, -1, 0, 0);
+
+		c->insns[jz].b = c->ninsns;
+		if (af->f != NULL)
+			gen(c, af->f, dst);
+		else
+			vm_emit(c, VM_ZERO, 0, dst, 0, 0);
+		jend = vm_emit(c, VM_JMP, 0, -1, 0, 0);
+
+		c->insns[jz].c = c->ninsns;
+		vm_emit(c, VM_NULL, 0, dst, 0, 0);
+
+		c->insns[jmp].b = c->insns[jend].b = c->ninsns;
+		break;
+
+	case FLOW_WHILE:
+		top = c->top;
+		nhoist = c->nhoist;
+		vm_hoist_loop(c, af);
+		t = vm_reg(c);
+		mark = vm_reg(c);
+
+		vm_emit(c, VM_MARK, 0, mark, 0, 0);
+		vm_emit(c, VM_ZERO, 0, dst, 0, 0);
+		jmp = c->ninsns;
+		vm_gen(c, af->cond, t);
+		jz = vm_emit(c, VM_JZ, 0, -1, t, 0);
+		if (af->t != NULL)
+			vm_gen(c, af->t, dst);
+		vm_gen_backedge(c, mark, jmp, dst);
+
+		/* a condition without a value ends the loop without one */
+		c->insns[jz].c = c->ninsns;
+		vm_emit(c, VM_NULL, 0, dst, 0, 0);
+		c->insns[jz].b = c->ninsns;
+
+		c->nhoist = nhoist;
+		c->top = top;
+		break;
+	}
+}
+
+
+/*
+ * Generates code leaving the value of a in register dst.  Registers
+ * above dst are free for temporaries and are released again on return.
+ */
+static
+void
+vm_gen_node(struct vm_code *c, ast_t a, int dst)
+{
+	astpsel_t ap;
+	astpselassign_t apa;
+	int top, t, s, i;
+
+	assert(a != NULL);
+
+	top = c->top;
+
+	switch (a->op_type) {
+	case OP_CMP:
+		t = vm_gen_two(c, ((astcmp_t)a)->l, ((astcmp_t)a)->r, dst);
+		vm_emit(c, VM_CMP, ((astcmp_t)a)->cmp_type, dst, dst, t);
+		break;
+
+	case OP_LISTING:
+		vm_gen(c, a->l, dst);
+		vm_gen(c, a->r, dst);
+		break;
+
+	case OP_FLOW:
+		vm_gen_flow(c, (astflow_t)a, dst, 0);
+		break;
+
+	case OP_ADD:
+	case OP_SUB:
+	case OP_MUL:
+	case OP_DIV:
+	case OP_MOD:
+	case OP_POW:
+		t = vm_gen_two(c, a->l, a->r, dst);
+		vm_emit(c, VM_FOP, a->op_type, dst, dst, t);
+		break;
+
+	case OP_AND:
+	case OP_OR:
+	case OP_XOR:
+	case OP_SHR:
+	case OP_SHL:
+		t = vm_gen_two(c, a->l, a->r, dst);
+		vm_emit(c, VM_IOP, a->op_type, dst, dst, t);
+		break;
+
+	case OP_UMINUS:
+		vm_gen(c, a->l, dst);
+		vm_emit(c, VM_FOP1, a->op_type, dst, dst, 0);
+		break;
+
+	case OP_UINV:
+	case OP_FAC:
+		vm_gen(c, a->l, dst);
+		vm_emit(c, VM_IOP1, a->op_type, dst, dst, 0);
+		break;
+
+	case OP_PSEL:
+		ap = (astpsel_t)a;
+		vm_gen(c, ap->l, dst);
+		t = vm_gen_range(c, ap->hi, ap->lo);
+		i = vm_emit(c, VM_PSEL, ap->psel_type, dst, dst, t);
+		if (ap->lo != NULL)
+			c->insns[i].c = t + 1;
+		break;
+
+	case OP_NUM:
+		i = vm_emit(c, VM_NUM, 0, dst, 0, 0);
+		c->insns[i].u.num = ((astnum_t)a)->num;
+		break;
+
+	case OP_VARREF:
+		s = vm_slot(c, ((astref_t)a)->name);
+		i = vm_emit(c, (s < 0) ? VM_LOADG : VM_LOADL, 0, dst, 0, 0);
+		c->insns[i].s = s;
+		c->insns[i].u.name = ((astref_t)a)->name;
+		break;
+
+	case OP_VARASSIGN:
+		vm_gen(c, ((astassign_t)a)->v, dst);
+		s = vm_slot(c, ((astassign_t)a)->name);
+		i = vm_emit(c, (s < 0) ? VM_STOREG : VM_STOREL, 0, dst, dst, 0);
+		c->insns[i].s = s;
+		c->insns[i].u.name = ((astassign_t)a)->name;
+		break;
+
+	case OP_PSELASSIGN:
+		apa = (astpselassign_t)a;
+		vm_gen(c, apa->v, dst);
+		t = vm_gen_range(c, apa->hi, apa->lo);
+		s = vm_slot(c, apa->name);
+		i = vm_emit(c, (s < 0) ? VM_PSETG : VM_PSETL, apa->psel_type,
+		    dst, dst, t);
+		if (apa->lo != NULL)
+			c->insns[i].c = t + 1;
+		c->insns[i].s = s;
+		c->insns[i].u.name = apa->name;
+		break;
+
+	case OP_CALL:
+		vm_gen_call(c, (astcall_t)a, dst);
+		break;
+
+	default:
+		yyxerror("Unknown op type %d", a->op_type);
+		vm_emit(c, VM_NULL, 0, dst, 0, 0);
+	}
+
+	c->top = top;
+}
+
+
+static
+void
+vm_gen(struct vm_code *c, ast_t a, int dst)
+{
+	int h, once, cse;
+
+	h = vm_hoisted(c, a);
+	once = (h < 0) ? -1 : vm_emit(c, VM_ONCE, 0, dst, h, 0);
+
+	cse = vm_cse_begin(c, a);
+	vm_gen_node(c, a, dst);
+	if (cse)
+		vm_cse_end(c);
+
+	if (h >= 0) {
+		vm_emit(c, VM_KEEP, 0, h, dst, 0);
+		c->insns[once].b = c->ninsns;
+	}
+}
+
+
+/*
+ * Generates a function body, or the part of one a is, whose value is
+ * the function's result: a call to a compiled function there does not
+ * need to return to the caller.
+ */
+static
+void
+vm_gen_tail(struct vm_code *c, ast_t a, int dst)
+{
+	int top, cse, i;
+
+	top = c->top;
+	cse = vm_cse_begin(c, a);
+
+	switch (a->op_type) {
+	case OP_LISTING:
+		vm_gen(c, a->l, dst);
+		vm_gen_tail(c, a->r, dst);
+		break;
+
+	case OP_FLOW:
+		vm_gen_flow(c, (astflow_t)a, dst, 1);
+		break;
+
+	case OP_CALL:
+		i = vm_gen_call(c, (astcall_t)a, dst);
+		if (c->insns[i].op == VM_CALL)
+			c->insns[i].op = VM_TAILCALL;
+		break;
+
+	default:
+		vm_gen(c, a, dst);
+	}
+
+	if (cse)
+		vm_cse_end(c);
+	c->top = top;
+}
+
+
+static
+void
+vm_gen_code(struct vm_code *c)
+{
+	c->ast = ast_fold(ast_copy(c->src), c->params);
+	c->gen = fold_gen;
+	c->fun_gen = fun_gen;
+	c->fundep = 0;
+
+	if (c->params != NULL)
+		vm_gen_tail(c, c->ast, vm_reg(c));
+	else
+		vm_gen(c, c->ast, vm_reg(c));
+	vm_emit(c, VM_RET, 0, -1, 0, 0);
+}
+
+
+static
+void
+vm_slot_count(void *priv, hashobj_t obj)
+{
+	++*(int *)priv;
+}
+
+
+static
+void
+vm_slot_alloc(void *priv, hashobj_t obj)
+{
+	struct vm_code *c = priv;
+
+	if (obj->data != NULL)
+		return;
+
+	c->slotname[c->nslots] = obj->str;
+	obj->data = (void *)(intptr_t)++c->nslots;
+}
+
+
+/*
+ * Lays out the frame of a function: the arguments come first, followed
+ * by the variables the body assigns to.
+ */
+static
+void
+vm_frame_layout(struct vm_code *c)
+{
+	namelist_t p;
+	hashobj_t obj;
+	int n, i;
+
+	c->slots = hashtable_new(61, NULL, NULL);
+	for (p = c->params; p != NULL; p = p->next) {
+		hashtable_lookup(c->slots, p->name, 1);
+		++c->nargs;
+	}
+	ast_assigned(c->src, c->slots);
+
+	n = 0;
+	hashtable_iterate(c->slots, vm_slot_count, &n);
+
+	if ((c->slotname = malloc(n * sizeof(*c->slotname))) == NULL ||
+	    (c->argslot = malloc(c->nargs * sizeof(int))) == NULL) {
+		yyxerror("ENOMEM");
+		exit(1);
+	}
+
+	for (p = c->params, i = 0; p != NULL; p = p->next, i++) {
+		obj = hashtable_lookup(c->slots, p->name, 0);
+		vm_slot_alloc(c, obj);
+		c->argslot[i] = (int)(intptr_t)obj->data - 1;
+	}
+	hashtable_iterate(c->slots, vm_slot_alloc, c);
+}
+
+
+/*
+ * Compiles a, the body of a function taking params or a statement if
+ * params is NULL, into bytecode.  Both must outlive the code.
+ */
+struct vm_code *
+vm_compile(ast_t a, namelist_t params)
+{
+	struct vm_code *c;
+
+	if ((c = malloc(sizeof(*c))) == NULL) {
+		yyxerror("ENOMEM");
+		exit(1);
+	}
+	memset(c, 0, sizeof(*c));
+
+	c->src = a;
+	c->params = params;
+	if (params != NULL)
+		vm_frame_layout(c);
+	vm_gen_code(c);
+
+	return c;
+}
+
+
+void
+vm_code_delete(struct vm_code *c)
+{
+	if (c->slots != NULL)
+		hashtable_destroy(c->slots);
+	free(c->slotname);
+	free(c->argslot);
+	ast_delete(c->ast);
+	free(c->insns);
+	free(c->hoist);
+	free(c->keep);
+	free(c);
+}
+
+
+/*
+ * Compiles c again when what it folded, or the functions it hoisted calls
+ * to out of loops, have changed since.  Code that is running keeps its
+ * old instructions until it is entered afresh.
+ */
+static
+void
+vm_refresh(struct vm_code *c)
+{
+	if ((c->gen == fold_gen && (!c->fundep || c->fun_gen == fun_gen)) ||
+	    c->running > 0)
+		return;
+
+	ast_delete(c->ast);
+	c->ninsns = c->nregs = c->top = c->nkeep = 0;
+	vm_gen_code(c);
+}
+
+
+/*
+ * Calls between compiled functions do not recurse in C.  A call pushes
+ * an activation, followed by the callee's frame and registers, onto a
+ * stack made of heap chunks that never move, and the VM carries on with
+ * the callee in the same loop.
+ */
+struct vm_act
+{
+	struct vm_code *code;
+	struct vm_act *caller;
+	struct vm_insn *ip;	/* the call this activation is waiting on */
+	int base;		/* returning from it returns from vm_exec() */
+	struct var *frame;
+	num_t *regs;
+
+	func_t fn;		/* a memo function, whose result goes ... */
+	struct fmemo_ent *key;	/* ... into its cache under key */
+};
+
+union vm_align
+{
+	struct vm_act act;
+	struct var var;
+	num_t num;
+	long double ld;
+};
+
+struct vm_chunk
+{
+	struct vm_chunk *prev;
+	struct vm_chunk *next;
+	char *top;
+	char *end;
+	union vm_align data[];
+};
+
+#define VM_CHUNK_SIZE	(64 * 1024)
+
+static struct vm_chunk *vm_stack;
+static unsigned long vm_depth;		/* function activations */
+unsigned long vm_max_depth = VM_MAX_DEPTH;
+
+
+static
+void *
+vm_stack_alloc(size_t sz)
+{
+	struct vm_chunk *k, *next, *t;
+	size_t n;
+	void *p;
+
+	sz = (sz + sizeof(union vm_align) - 1) / sizeof(union vm_align) *
+	    sizeof(union vm_align);
+
+	if ((k = vm_stack) == NULL || (size_t)(k->end - k->top) < sz) {
+		next = (k != NULL) ? k->next : NULL;
+
+		/* chunks above the top are kept for reuse, if large enough */
+		if (next != NULL && (size_t)(next->end - (char *)next->data) < sz) {
+			for (; next != NULL; next = t) {
+				t = next->next;
+				free(next);
+			}
+			k->next = NULL;
+		}
+
+		if (next == NULL) {
+			n = (sz > VM_CHUNK_SIZE) ? sz : VM_CHUNK_SIZE;
+			if ((next = malloc(sizeof(*next) + n)) == NULL) {
+				yyxerror("ENOMEM");
+				exit(1);
+			}
+			next->prev = k;
+			next->next = NULL;
+			next->end = (char *)next->data + n;
+			if (k != NULL)
+				k->next = next;
+		}
+
+		next->top = (char *)next->data;
+		vm_stack = k = next;
+	}
+
+	p = k->top;
+	k->top += sz;
+
+	return p;
+}
+
+
+/* Pops p, which must be the block allocated last. */
+static
+void
+vm_stack_free(void *p)
+{
+	vm_stack->top = p;
+	if (vm_stack->top == (char *)vm_stack->data && vm_stack->prev != NULL)
+		vm_stack = vm_stack->prev;
+}
+
+
+static
+int
+vm_too_deep(void)
+{
+	if (vm_depth < vm_max_depth)
+		return 0;
+
+	yyxerror("Function calls nested more than %lu deep", vm_max_depth);
+	return 1;
+}
+
+
+static
+struct vm_act *
+vm_enter(struct vm_code *c, int nargs, num_t *args)
+{
+	struct vm_act *act;
+	int i;
+
+	vm_refresh(c);
+
+	act = vm_stack_alloc(sizeof(*act) + c->nslots * sizeof(struct var) +
+	    c->nregs * sizeof(num_t));
+	act->code = c;
+	act->caller = NULL;
+	act->ip = NULL;
+	act->base = 0;
+	act->fn = NULL;
+	act->key = NULL;
+	act->frame = (struct var *)(act + 1);
+	act->regs = (num_t *)(act->frame + c->nslots);
+
+	/* the arguments are shared with the caller */
+	memset(act->frame, 0, c->nslots * sizeof(struct var));
+	for (i = 0; i < nargs; i++) {
+		act->frame[c->argslot[i]].v = args[i];
+		act->frame[c->argslot[i]].no_numfree = 1;
+	}
+
+	++c->running;
+	if (c->params != NULL)
+		++vm_depth;
+
+	return act;
+}
+
+
+static
+void
+vm_leave(struct vm_act *act)
+{
+	struct vm_code *c = act->code;
+	int i;
+
+	for (i = 0; i < c->nslots; i++)
+		if (act->frame[i].v != NULL && !act->frame[i].no_numfree)
+			num_delete(act->frame[i].v);
+
+	--c->running;
+	if (c->params != NULL)
+		--vm_depth;
+
+	vm_stack_free(act);
+}
+
+
+/* Whether n is the value of a local variable of act. */
+static
+int
+vm_owns(struct vm_act *act, num_t n)
+{
+	int i;
+
+	for (i = 0; i < act->code->nslots; i++)
+		if (act->frame[i].v == n && !act->frame[i].no_numfree)
+			return 1;
+
+	return 0;
+}
+
+
+/*
+ * Replaces act with an activation of c, which it calls in tail position,
+ * so that the stack does not grow.
+ */
+static
+struct vm_act *
+vm_tailcall(struct vm_act *act, struct vm_code *c, int nargs, num_t *args)
+{
+	struct vm_act *caller = act->caller;
+	int base = act->base;
+	num_t targs[nargs + 1];
+	int i;
+
+	/* args live in act's registers, and may be its locals */
+	for (i = 0; i < nargs; i++) {
+		targs[i] = args[i];
+		if (vm_owns(act, targs[i]))
+			targs[i] = num_new_z_or_fp(N_TEMP, targs[i]);
+	}
+
+	vm_leave(act);
+
+	act = vm_enter(c, nargs, targs);
+	act->caller = caller;
+	act->base = base;
+
+	return act;
+}
+
+
+/*
+ * Resolves the function ac calls, returning NULL if the call has no
+ * result because it is invalid or an argument has no value.
+ */
+static
+func_t
+vm_callee(astcall_t ac, int nargs, num_t *args)
+{
+	func_t fn;
+	int i;
+
+	fn = fun_resolve(ac);
+	if (fun_check_args(fn, ac->name, nargs) < 0)
+		return NULL;
+
+	/* builtins do not expect missing values among their arguments */
+	for (i = 0; i < nargs; i++)
+		if (args[i] == NULL)
+			return NULL;
+
+	return fn;
+}
+
+
+/* Returns the global variable an instruction refers to, if it exists. */
+static
+var_t
+vm_global(struct vm_insn *ip, int alloc)
+{
+	if (ip->var == NULL)
+		ip->var = varlookup(ip->u.name, alloc);
+
+	return ip->var;
+}
+
+
+static
+num_t
+vm_load_global(struct vm_insn *ip)
+{
+	var_t var;
+
+	if ((var = vm_global(ip, 0)) == NULL) {
+		yyxerror("Variable '%s' not defined", ip->u.name);
+		return NULL;
+	}
+
+	return var->v;
+}
+
+
+#ifdef VM_THREADED
+#define VM_CASE(op)	L_##op
+#define VM_DISPATCH()	goto *vm_labels[ip->op]
+#else
+#define VM_CASE(op)	case op
+#define VM_DISPATCH()	continue
+#endif
+
+/* no do { } while (0) here: VM_DISPATCH() may be a continue */
+#define VM_NEXT()	{ ++ip; VM_DISPATCH(); }
+#define VM_JUMP(t)	{ ip = c->insns + (t); VM_DISPATCH(); }
+
+#define VM_PSEL_ARGS(ip)	(regs[(ip)->a] != NULL && \
+				 regs[(ip)->b] != NULL && \
+				 ((ip)->c < 0 || regs[(ip)->c] != NULL))
+#define VM_LO(ip)		(((ip)->c < 0) ? NULL : regs[(ip)->c])
+
+
+#define VM_ACT(x)	(act = (x), c = act->code, frame = act->frame, \
+			 regs = act->regs)
+
+
+/*
+ * Runs act until it returns, along with everything it calls.
+ */
+static
+num_t
+vm_exec(struct vm_act *act)
+{
+	struct vm_code *c;
+	struct vm_insn *ip;
+	struct var *frame;
+	num_t *regs;
+	struct vm_act *callee;
+	func_t fn;
+	struct fmemo_ent *key;
+	num_t a, b;
+	void *keep[VM_KEEP_MAX];
+	int base, i;
+
+#ifdef VM_THREADED
+	static const void *vm_labels[] = {
+		[VM_NUM] = &&L_VM_NUM,
+		[VM_ZERO] = &&L_VM_ZERO,
+		[VM_NULL] = &&L_VM_NULL,
+		[VM_LOADG] = &&L_VM_LOADG,
+		[VM_LOADL] = &&L_VM_LOADL,
+		[VM_STOREG] = &&L_VM_STOREG,
+		[VM_STOREL] = &&L_VM_STOREL,
+		[VM_PSEL] = &&L_VM_PSEL,
+		[VM_PSETG] = &&L_VM_PSETG,
+		[VM_PSETL] = &&L_VM_PSETL,
+		[VM_FOP] = &&L_VM_FOP,
+		[VM_IOP] = &&L_VM_IOP,
+		[VM_FOP1] = &&L_VM_FOP1,
+		[VM_IOP1] = &&L_VM_IOP1,
+		[VM_CMP] = &&L_VM_CMP,
+		[VM_CALL] = &&L_VM_CALL,
+		[VM_TAILCALL] = &&L_VM_TAILCALL,
+		[VM_CALLFN] = &&L_VM_CALLFN,
+		[VM_JMP] = &&L_VM_JMP,
+		[VM_MARK] = &&L_VM_MARK,
+		[VM_LOOP] = &&L_VM_LOOP,
+		[VM_JZ] = &&L_VM_JZ,
+		[VM_UNSET] = &&L_VM_UNSET,
+		[VM_ONCE] = &&L_VM_ONCE,
+		[VM_KEEP] = &&L_VM_KEEP,
+		[VM_RET] = &&L_VM_RET
+	};
+#endif
+
+	act->base = 1;
+	VM_ACT(act);
+	ip = c->insns;
+
+#ifdef VM_THREADED
+	VM_DISPATCH();
+#else
+	for (;;) {
+		switch (ip->op) {
+#endif
+
+	VM_CASE(VM_NUM):
+		regs[ip->r] = ip->u.num;
+		VM_NEXT();
+
+	VM_CASE(VM_ZERO):
+		regs[ip->r] = num_new_const_zero(N_TEMP);
+		VM_NEXT();
+
+	VM_CASE(VM_NULL):
+		regs[ip->r] = NULL;
+		VM_NEXT();
+
+	VM_CASE(VM_LOADG):
+		regs[ip->r] = vm_load_global(ip);
+		VM_NEXT();
+
+	VM_CASE(VM_LOADL):
+		/* a local that is read before it is assigned is a global */
+		if ((regs[ip->r] = frame[ip->s].v) == NULL)
+			regs[ip->r] = vm_load_global(ip);
+		VM_NEXT();
+
+	VM_CASE(VM_STOREG):
+		if ((a = regs[ip->a]) != NULL)
+			a = var_assign(vm_global(ip, 1), a);
+		regs[ip->r] = a;
+		VM_NEXT();
+
+	VM_CASE(VM_STOREL):
+		if ((a = regs[ip->a]) != NULL)
+			a = var_assign(&frame[ip->s], a);
+		regs[ip->r] = a;
+		VM_NEXT();
+
+	VM_CASE(VM_PSEL):
+		regs[ip->r] = !VM_PSEL_ARGS(ip) ? NULL :
+		    num_int_part_sel(ip->sub, regs[ip->b], VM_LO(ip),
+		    regs[ip->a]);
+		VM_NEXT();
+
+	VM_CASE(VM_PSETG):
+		regs[ip->r] = !VM_PSEL_ARGS(ip) ? NULL :
+		    var_pselassign(vm_global(ip, 1), ip->sub, regs[ip->a],
+		    regs[ip->b], VM_LO(ip));
+		VM_NEXT();
+
+	VM_CASE(VM_PSETL):
+		regs[ip->r] = !VM_PSEL_ARGS(ip) ? NULL :
+		    var_pselassign(&frame[ip->s], ip->sub, regs[ip->a],
+		    regs[ip->b], VM_LO(ip));
+		VM_NEXT();
+
+	VM_CASE(VM_FOP):
+		a = regs[ip->a];
+		b = regs[ip->b];
+		regs[ip->r] = (a == NULL || b == NULL) ? NULL :
+		    num_float_two_op(ip->sub, a, b);
+		VM_NEXT();
+
+	VM_CASE(VM_IOP):
+		a = regs[ip->a];
+		b = regs[ip->b];
+		regs[ip->r] = (a == NULL || b == NULL) ? NULL :
+		    num_int_two_op(ip->sub, a, b);
+		VM_NEXT();
+
+	VM_CASE(VM_FOP1):
+		a = regs[ip->a];
+		regs[ip->r] = (a == NULL) ? NULL : num_float_one_op(ip->sub, a);
+		VM_NEXT();
+
+	VM_CASE(VM_IOP1):
+		a = regs[ip->a];
+		regs[ip->r] = (a == NULL) ? NULL : num_int_one_op(ip->sub, a);
+		VM_NEXT();
+
+	VM_CASE(VM_CMP):
+		a = regs[ip->a];
+		b = regs[ip->b];
+		regs[ip->r] = (a == NULL || b == NULL) ? NULL :
+		    num_cmp(ip->sub, a, b);
+		VM_NEXT();
+
+	VM_CASE(VM_CALL):
+	vm_call:
+		if ((fn = vm_callee(ip->u.call, ip->b, &regs[ip->a])) == NULL)
+			regs[ip->r] = NULL;
+		else if (fn->code == NULL)
+			regs[ip->r] = fun_apply(fn, ip->u.call->name, ip->b,
+			    &regs[ip->a]);
+		else if ((regs[ip->r] = fun_memo_get(fn, ip->b, &regs[ip->a],
+		    &key)) != NULL)
+			VM_NEXT()
+		else if (vm_too_deep())
+			fun_memo_put(fn, key, NULL);
+		else {
+			callee = vm_enter(fn->code, ip->b, &regs[ip->a]);
+			callee->caller = act;
+			callee->fn = fn;
+			callee->key = key;
+			act->ip = ip;
+			VM_ACT(callee);
+			VM_JUMP(0);
+		}
+		VM_NEXT();
+
+	VM_CASE(VM_TAILCALL):
+		/* the result of a pending memo call must still be stored */
+		if (act->key != NULL)
+			goto vm_call;
+
+		if ((fn = vm_callee(ip->u.call, ip->b, &regs[ip->a])) == NULL)
+			regs[ip->r] = NULL;
+		else if (fn->code == NULL)
+			regs[ip->r] = fun_apply(fn, ip->u.call->name, ip->b,
+			    &regs[ip->a]);
+		else if ((regs[ip->r] = fun_memo_get(fn, ip->b, &regs[ip->a],
+		    &key)) == NULL) {
+			VM_ACT(vm_tailcall(act, fn->code, ip->b, &regs[ip->a]));
+			act->fn = fn;
+			act->key = key;
+			VM_JUMP(0);
+		}
+		VM_NEXT();
+
+	VM_CASE(VM_CALLFN):
+		fn = fun_resolve(ip->u.call);
+		if (fun_check_args(fn, ip->u.call->name, ip->b + 1) < 0)
+			regs[ip->r] = NULL;
+		else
+			regs[ip->r] = fun_apply_fnarg(fn, ip->u.call->name,
+			    ip->u.call->l->ast, ip->b, &regs[ip->a]);
+		VM_NEXT();
+
+	VM_CASE(VM_JMP):
+		VM_JUMP(ip->b);
+
+	VM_CASE(VM_MARK):
+		regs[ip->r] = num_temp_mark();
+		VM_NEXT();
+
+	VM_CASE(VM_LOOP):
+		for (i = 0; i < ip->s; i++)
+			keep[i] = regs[c->keep[ip->c + i]];
+		num_temp_release(regs[ip->a], keep, ip->s);
+		VM_JUMP(ip->b);
+
+	VM_CASE(VM_JZ):
+		if ((a = regs[ip->a]) == NULL)
+			VM_JUMP(ip->c);
+		if (num_is_zero(a))
+			VM_JUMP(ip->b);
+		VM_NEXT();
+
+	VM_CASE(VM_UNSET):
+		regs[ip->r] = &vm_unset;
+		VM_NEXT();
+
+	VM_CASE(VM_ONCE):
+		if ((a = regs[ip->a]) != &vm_unset) {
+			regs[ip->r] = a;
+			VM_JUMP(ip->b);
+		}
+		VM_NEXT();
+
+	VM_CASE(VM_KEEP):
+		if ((a = regs[ip->a]) != NULL)
+			regs[ip->r] = a;
+		VM_NEXT();
+
+	VM_CASE(VM_RET):
+		a = regs[ip->a];
+		/* the result may be a local variable, which dies with act */
+		if (a != NULL && vm_owns(act, a))
+			a = num_new_z_or_fp(N_TEMP, a);
+		fun_memo_put(act->fn, act->key, a);
+
+		callee = act;
+		base = act->base;
+		act = act->caller;
+		vm_leave(callee);
+		if (base)
+			return a;
+
+		VM_ACT(act);
+		ip = act->ip;
+		regs[ip->r] = a;
+		VM_NEXT();
+
+#ifndef VM_THREADED
+		}
+	}
+#endif
+}
+
+
+/* Runs the code of a statement. */
+num_t
+vm_run(struct vm_code *c)
+{
+	return vm_exec(vm_enter(c, 0, NULL));
+}
+
+
+/*
+ * Calls the function compiled into c from outside the VM, as builtins
+ * like tabulate do.
+ */
+num_t
+vm_apply(struct vm_code *c, int nargs, num_t *args)
+{
+	if (vm_too_deep())
+		return NULL;
+
+	return vm_exec(vm_enter(c, nargs, args));
+}
+
+
+int
+vm_mode_switch(const char *mode)
+{
+	if (strcmp(mode, "on") == 0)
+		vm_enabled = 1;
+	else if (strcmp(mode, "off") == 0)
+		vm_enabled = 0;
+	else {
+		yyxerror("Unknown vm mode '%s' (expected on or off)", mode);
+		return -1;
+	}
+
+	return 0;
+}
+
+
+int
+vm_depth_switch(const char *depth)
+{
+	unsigned long n;
+
+	if ((n = strtoul(depth, NULL, 10)) == 0) {
+		yyxerror("Function calls must be allowed to nest at least 1 deep");
+		return -1;
+	}
+
+	vm_max_depth = n;
+	return 0;
+}